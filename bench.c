@@ -0,0 +1,551 @@
+#pragma region _DEFINICIONES_Y_MACROS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "render.h"
+#include "sprites.h"
+#include "rng.h"
+
+#define DEFAULT_SAMPLES 21     // Muestras por caso si no se indica --samples
+#define MIN_SAMPLE_NS 2000000L // Cada muestra dura al menos 2 ms
+#define MAX_ITERS (1L << 21)   // Tope de operaciones por muestra
+#define TALL_ROWS (1 << 22)    // Tablero alto: nada sale de pantalla dentro de una muestra
+#define SWARM_ROWS 250         // Tablero de los casos con muchas entidades
+#define SWARM_COLS 500
+#define GAME_ROWS 40           // Tablero de los casos con la capacidad del juego
+#define GAME_COLS 120
+#define SCREEN_ROWS 60         // Terminal virtual de los casos de dibujo
+#define SCREEN_COLS 200
+#define MAX_COUNTS 4
+
+// Un caso de benchmark. setup prepara el estado sin medir; run corre iters operaciones y
+// devuelve los nanosegundos medidos, asi cada caso decide que parte queda fuera del reloj
+typedef struct
+{
+    const char *name;
+    int (*setup)(int n);     // Prepara el estado para n entidades, -1 si falla
+    long (*run)(long iters); // Corre iters operaciones y devuelve los ns medidos
+    void (*teardown)();      // Libera lo que reservo setup
+    int counts[MAX_COUNTS];  // Cantidades de entidades a medir (0 termina la lista)
+    int needs_screen;        // 1 si usa ncurses
+} Benchmark;
+
+// Resultado de un caso con una cantidad de entidades
+typedef struct
+{
+    double median_ns; // Mediana de ns por operacion
+    double mad_ns;    // Desviacion absoluta mediana de ns por operacion
+    double min_ns;
+    int samples;
+    long iters; // Operaciones por muestra
+} BenchResult;
+#pragma endregion
+
+#pragma region VARIABLES_GLOBALES
+static World world;             // Mundo de los casos de simulacion
+static unsigned char *snapshot; // Estado inicial que se restaura antes de cada muestra
+static size_t snapshot_size;
+static Position *parts;         // Celdas de los casos check_collision*
+static Position *others;
+static int count;               // Entidades del caso actual
+static long timer_overhead_ns;  // Costo de un par de clock_gettime, se descuenta por operacion
+static volatile long sink;      // Evita que el compilador descarte resultados
+#pragma endregion
+
+#pragma region FUNCIONES_AUXILIARES
+static long now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *values, int n)
+{
+    qsort(values, n, sizeof(double), compare_double);
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Crea el mundo, lo llena y guarda una instantanea para restaurarlo antes de cada muestra
+static int world_setup(int max_enemies, int max_projectiles, int rows, int cols)
+{
+    if (sim_create(&world, max_enemies, max_projectiles) != 0)
+    {
+        return -1;
+    }
+    sim_seed(&world, 12345);
+    sim_init(&world, rows, cols);
+    return 0;
+}
+
+static int world_save()
+{
+    snapshot_size = sim_snapshot_size(&world);
+    snapshot = malloc(snapshot_size);
+    if (snapshot == NULL)
+    {
+        return -1;
+    }
+    sim_snapshot(&world, snapshot);
+    return 0;
+}
+
+static void world_teardown()
+{
+    free(snapshot);
+    snapshot = NULL;
+    sim_destroy(&world);
+}
+
+// Celdas al azar que nunca coinciden con (0, 0), el punto que se busca: peor caso, se recorren todas
+static int parts_setup(int n)
+{
+    Rng r;
+    rng_seed(&r, 12345, 0);
+    count = n;
+    parts = malloc(n * sizeof(Position));
+    others = malloc(n * sizeof(Position));
+    if (parts == NULL || others == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        parts[i] = (Position){1 + rng_below(&r, 1000), 1 + rng_below(&r, 1000)};
+        others[i] = (Position){1001 + rng_below(&r, 1000), 1 + rng_below(&r, 1000)};
+    }
+    return 0;
+}
+
+static void parts_teardown()
+{
+    free(parts);
+    free(others);
+    parts = others = NULL;
+}
+
+// Llena el mundo con n enemigos o proyectiles en posiciones al azar
+static void fill_pool(EntityColumns *c, int n, int min_y, int max_y)
+{
+    Rng r;
+    rng_seed(&r, 777, 0);
+    for (int k = 0; k < n; k++)
+    {
+        int i = pool_spawn(c);
+        c->x[i] = 2 + rng_below(&r, world.cols - 4);
+        c->y[i] = min_y + rng_below(&r, max_y - min_y);
+        if (c->type != NULL)
+        {
+            c->type[i] = rng_below(&r, 3);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region CASOS_DE_COLISION
+static long run_check_collision(long iters)
+{
+    Position pos = {0, 0};
+    long hits = 0, start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        hits += check_collision(pos, parts, count);
+    }
+    long elapsed = now_ns() - start;
+    sink += hits;
+    return elapsed;
+}
+
+static long run_check_collision_boss(long iters)
+{
+    Position pos = {0, 0};
+    long hits = 0, start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        hits += check_collision_boss(pos, parts, count);
+    }
+    long elapsed = now_ns() - start;
+    sink += hits;
+    return elapsed;
+}
+
+static long run_check_collision_enemies(long iters)
+{
+    long hits = 0, start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        hits += check_collision_enemies(others, parts, count);
+    }
+    long elapsed = now_ns() - start;
+    sink += hits;
+    return elapsed;
+}
+
+// Pasada completa de colisiones con n enemigos y n proyectiles en el tablero del enjambre
+static int setup_check_collisions(int n)
+{
+    if (world_setup(n, n, SWARM_ROWS, SWARM_COLS) != 0)
+    {
+        return -1;
+    }
+    fill_pool(&world.enemies, n, 3, SWARM_ROWS - 20);
+    fill_pool(&world.projectiles, n, 3, SWARM_ROWS - 20);
+    return world_save();
+}
+
+static long run_check_collisions(long iters)
+{
+    sim_restore(&world, snapshot, snapshot_size);
+    long start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        check_collisions(&world);
+    }
+    return now_ns() - start;
+}
+#pragma endregion
+
+#pragma region CASOS_DE_ACTUALIZACION
+// El tablero es tan alto que ninguna entidad sale de pantalla durante una muestra
+static int setup_update_projectiles(int n)
+{
+    if (world_setup(MAX_ENEMIES, n, TALL_ROWS, SWARM_COLS) != 0)
+    {
+        return -1;
+    }
+    fill_pool(&world.projectiles, n, TALL_ROWS - 100, TALL_ROWS - 10);
+    return world_save();
+}
+
+static long run_update_projectiles(long iters)
+{
+    sim_restore(&world, snapshot, snapshot_size);
+    long start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        update_projectiles(&world);
+    }
+    return now_ns() - start;
+}
+
+static int setup_update_enemies(int n)
+{
+    if (world_setup(n, MAX_PROJECTILES, TALL_ROWS, SWARM_COLS) != 0)
+    {
+        return -1;
+    }
+    fill_pool(&world.enemies, n, 3, 100);
+    return world_save();
+}
+
+static long run_update_enemies(long iters)
+{
+    sim_restore(&world, snapshot, snapshot_size);
+    long start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        update_enemies(&world);
+    }
+    return now_ns() - start;
+}
+
+// Tick completo sin terminal: con 10 enemigos es la configuracion del juego; con mas, el
+// enjambre entra en una oleada y la nave dispara en cada tick sin morir
+static int setup_sim_tick(int n)
+{
+    int game = n <= MAX_ENEMIES;
+    if (world_setup(n, game ? MAX_PROJECTILES : n, game ? GAME_ROWS : SWARM_ROWS, game ? GAME_COLS : SWARM_COLS) != 0)
+    {
+        return -1;
+    }
+    if (!game)
+    {
+        schedule_wave(&world, 0, n);
+    }
+    for (int t = 0; t < 200; t++)
+    {
+        shoot(&world);
+        sim_tick(&world);
+    }
+    return world_save();
+}
+
+static long run_sim_tick(long iters)
+{
+    sim_restore(&world, snapshot, snapshot_size);
+    long start = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        shoot(&world);
+        sim_tick(&world);
+        world.hp = 3;
+    }
+    return now_ns() - start;
+}
+#pragma endregion
+
+#pragma region CASOS_DE_DIBUJO
+// Cada operacion compone un cuadro con n sprites. El envio a ncurses se hace fuera del reloj
+// (se mide aparte en render_end_frame), asi cada cuadro empieza con los tramos vacios
+static Position *sprite_pos;
+
+static int setup_sprites(int n)
+{
+    Rng r;
+    rng_seed(&r, 12345, 0);
+    count = n;
+    sprite_pos = malloc(n * sizeof(Position));
+    if (sprite_pos == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        sprite_pos[i] = (Position){5 + rng_below(&r, SCREEN_COLS - 10), 5 + rng_below(&r, SCREEN_ROWS - 10)};
+    }
+    render_reset();
+    return 0;
+}
+
+static void teardown_sprites()
+{
+    free(sprite_pos);
+    sprite_pos = NULL;
+}
+
+static void compose(int which)
+{
+    render_begin_frame();
+    for (int i = 0; i < count; i++)
+    {
+        switch (which)
+        {
+        case 0:
+            draw_ship(sprite_pos[i].x, sprite_pos[i].y);
+            break;
+        case 1:
+            draw_boss(sprite_pos[i].x, sprite_pos[i].y);
+            break;
+        default:
+            draw_enemy(sprite_pos[i].x, sprite_pos[i].y, i % 3);
+            break;
+        }
+    }
+}
+
+static long run_compose(long iters, int which)
+{
+    long total = 0;
+    for (long i = 0; i < iters; i++)
+    {
+        long start = now_ns();
+        compose(which);
+        total += now_ns() - start - timer_overhead_ns;
+        render_end_frame();
+    }
+    return total;
+}
+
+static long run_draw_ship(long iters)
+{
+    return run_compose(iters, 0);
+}
+
+static long run_draw_boss(long iters)
+{
+    return run_compose(iters, 1);
+}
+
+static long run_draw_enemy(long iters)
+{
+    return run_compose(iters, 2);
+}
+
+// Los sprites se mueven una columna por cuadro para que siempre haya celdas que enviar
+static long run_render_end_frame(long iters)
+{
+    static long frame;
+    long total = 0;
+    for (long i = 0; i < iters; i++)
+    {
+        frame++;
+        render_begin_frame();
+        for (int k = 0; k < count; k++)
+        {
+            draw_enemy(sprite_pos[k].x + (frame & 1), sprite_pos[k].y, k % 3);
+        }
+        long start = now_ns();
+        render_end_frame();
+        total += now_ns() - start - timer_overhead_ns;
+    }
+    return total;
+}
+#pragma endregion
+
+#pragma region EJECUCION
+static const Benchmark benchmarks[] = {
+    {"check_collision", parts_setup, run_check_collision, parts_teardown, {5, 64, 1024}, 0},
+    {"check_collision_boss", parts_setup, run_check_collision_boss, parts_teardown, {5, 64, 1024}, 0},
+    {"check_collision_enemies", parts_setup, run_check_collision_enemies, parts_teardown, {5, 32, 256}, 0},
+    {"check_collisions", setup_check_collisions, run_check_collisions, world_teardown, {10, 1000, 20000}, 0},
+    {"update_projectiles", setup_update_projectiles, run_update_projectiles, world_teardown, {5, 1000, 20000}, 0},
+    {"update_enemies", setup_update_enemies, run_update_enemies, world_teardown, {10, 1000, 20000}, 0},
+    {"sim_tick", setup_sim_tick, run_sim_tick, world_teardown, {10, 1000, 20000}, 0},
+    {"draw_ship", setup_sprites, run_draw_ship, teardown_sprites, {1, 100}, 1},
+    {"draw_boss", setup_sprites, run_draw_boss, teardown_sprites, {1, 100}, 1},
+    {"draw_enemy", setup_sprites, run_draw_enemy, teardown_sprites, {10, 100, 1000}, 1},
+    {"render_end_frame", setup_sprites, run_render_end_frame, teardown_sprites, {10, 100, 1000}, 1},
+};
+
+// Duplica las operaciones por muestra hasta que una muestra dura MIN_SAMPLE_NS y despues
+// toma samples muestras. La mediana y la MAD son robustas a las muestras interrumpidas
+static BenchResult measure(const Benchmark *b, int samples)
+{
+    BenchResult r = {0, 0, 0, samples, 1};
+    while (r.iters < MAX_ITERS && b->run(r.iters) < MIN_SAMPLE_NS)
+    {
+        r.iters *= 2;
+    }
+
+    double *ns = malloc(samples * sizeof(double));
+    for (int s = 0; s < samples; s++)
+    {
+        ns[s] = (double)b->run(r.iters) / r.iters;
+    }
+    r.median_ns = median(ns, samples);
+    r.min_ns = ns[0];
+    for (int s = 0; s < samples; s++)
+    {
+        ns[s] = ns[s] > r.median_ns ? ns[s] - r.median_ns : r.median_ns - ns[s];
+    }
+    r.mad_ns = median(ns, samples);
+    free(ns);
+    return r;
+}
+
+// La terminal de los casos de dibujo escribe en /dev/null con un tamaño fijo
+static int open_screen()
+{
+    FILE *out = fopen("/dev/null", "w");
+    char lines[16], columns[16];
+    snprintf(lines, sizeof(lines), "%d", SCREEN_ROWS);
+    snprintf(columns, sizeof(columns), "%d", SCREEN_COLS);
+    setenv("LINES", lines, 1);
+    setenv("COLUMNS", columns, 1);
+    if (out == NULL || newterm("xterm", out, stdin) == NULL)
+    {
+        return -1;
+    }
+    start_color();
+    for (int i = 1; i <= 5; i++)
+    {
+        init_pair(i, i, COLOR_BLACK);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int samples = DEFAULT_SAMPLES, csv = 0, screen = -1;
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv = 1; // Salida para comparar entre commits
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            samples = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i]; // Solo los casos cuyo nombre contiene este texto
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--csv] [--samples N] [--filter NAME]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    long start = now_ns();
+    for (int i = 0; i < 1000; i++)
+    {
+        now_ns();
+    }
+    timer_overhead_ns = (now_ns() - start) / 1000;
+
+    if (csv)
+    {
+        printf("name,n,median_ns,mad_ns,min_ns,samples,iters\n");
+    }
+    else
+    {
+        printf("%-24s %6s %14s %10s %10s %9s\n", "benchmark", "n", "median ns/op", "mad", "min", "iters");
+    }
+
+    int failed = 0;
+    for (size_t k = 0; k < sizeof(benchmarks) / sizeof(benchmarks[0]); k++)
+    {
+        const Benchmark *b = &benchmarks[k];
+        if (filter != NULL && strstr(b->name, filter) == NULL)
+        {
+            continue;
+        }
+        if (b->needs_screen && screen == -1)
+        {
+            screen = open_screen();
+            if (screen != 0)
+            {
+                fprintf(stderr, "%s: no terminal for the draw benchmarks, skipped\n", b->name);
+            }
+        }
+        if (b->needs_screen && screen != 0)
+        {
+            continue;
+        }
+
+        for (int c = 0; c < MAX_COUNTS && b->counts[c] > 0; c++)
+        {
+            if (b->setup(b->counts[c]) != 0)
+            {
+                fprintf(stderr, "%s n=%d: not enough memory\n", b->name, b->counts[c]);
+                b->teardown();
+                failed = 1;
+                continue;
+            }
+            BenchResult r = measure(b, samples);
+            b->teardown();
+
+            if (csv)
+            {
+                printf("%s,%d,%.2f,%.2f,%.2f,%d,%ld\n", b->name, b->counts[c], r.median_ns, r.mad_ns, r.min_ns,
+                       r.samples, r.iters);
+            }
+            else
+            {
+                printf("%-24s %6d %14.1f %10.1f %10.1f %9ld\n", b->name, b->counts[c], r.median_ns, r.mad_ns,
+                       r.min_ns, r.iters);
+            }
+            fflush(stdout);
+        }
+    }
+
+    if (screen == 0)
+    {
+        endwin();
+        render_free();
+    }
+    return failed;
+}
+#pragma endregion
@@ -0,0 +1,52 @@
+#include "boss_patterns.h"
+
+#pragma region GUIONES
+const BossScript boss_scripts[BOSS_SCRIPT_COUNT] = {
+    // En la terminal el jefe queda a pocas filas de la nave: pocos proyectiles y lentos
+    [BOSS_SCRIPT_GAME] = {3, {
+        {PATTERN_SPREAD, 36, 3, 32, 0, 96, 144},   // Abanico de 3 cada 36 ticks
+        {PATTERN_AIMED, 48, 1, 0, 0, 128, 120},    // Uno apuntado a la nave
+        {PATTERN_SPIRAL, 24, 4, 0, 11, 96, 144},   // Cruz que gira
+    }},
+    // Tablero grande y el jefe sin tregua: mantiene miles de proyectiles vivos
+    [BOSS_SCRIPT_BULLET_HELL] = {3, {
+        {PATTERN_SPIRAL, 1, 32, 0, 5, 128, 300},   // 32 rayos por tick
+        {PATTERN_SPREAD, 2, 48, 128, 0, 160, 300}, // Abanico de 180 grados
+        {PATTERN_AIMED, 1, 16, 24, 0, 192, 300},   // Chorro apuntado
+    }},
+};
+#pragma endregion
+
+#pragma region ANGULOS
+// Primer cuarto de vuelta del seno en punto fijo, redondeado una vez. Con sin() de libm el
+// resultado podria cambiar de una maquina a otra y las repeticiones divergirian
+static const short quarter_sine[ANGLE_TURN / 4 + 1] = {
+    0, 6, 13, 19, 25, 31, 38, 44, 50, 56, 62, 68, 74, 80, 86, 92, 98,
+    104, 109, 115, 121, 126, 132, 137, 142, 147, 152, 157, 162, 167, 172, 177,
+    181, 185, 190, 194, 198, 202, 206, 209, 213, 216, 220, 223, 226, 229, 231, 234,
+    237, 239, 241, 243, 245, 247, 248, 250, 251, 252, 253, 254, 255, 255, 256, 256, 256,
+};
+
+int angle_sin(int angle)
+{
+    int a = angle & (ANGLE_TURN - 1), q = ANGLE_TURN / 4;
+    if (a <= q)
+    {
+        return quarter_sine[a];
+    }
+    if (a <= 2 * q)
+    {
+        return quarter_sine[2 * q - a];
+    }
+    if (a <= 3 * q)
+    {
+        return -quarter_sine[a - 2 * q];
+    }
+    return -quarter_sine[4 * q - a];
+}
+
+int angle_cos(int angle)
+{
+    return angle_sin(angle + ANGLE_TURN / 4);
+}
+#pragma endregion
@@ -0,0 +1,45 @@
+#ifndef BOSS_PATTERNS_H
+#define BOSS_PATTERNS_H
+
+#define PATTERN_SPREAD 0 // Abanico de count proyectiles centrado hacia abajo
+#define PATTERN_SPIRAL 1 // count rayos repartidos en circulo que giran turn en cada disparo
+#define PATTERN_AIMED 2  // Abanico de count proyectiles centrado en la nave
+
+#define BULLET_SHIFT 8                  // Bits fraccionarios de la posicion y la velocidad
+#define BULLET_ONE (1 << BULLET_SHIFT)  // Una celda en punto fijo
+#define BULLET_ASPECT 2                 // Las celdas son el doble de altas que de anchas
+#define ANGLE_TURN 256                  // Unidades de angulo por vuelta
+#define ANGLE_DOWN (ANGLE_TURN / 4)     // Hacia abajo (las filas crecen hacia abajo)
+
+#define BOSS_SCRIPT_MAX 8         // Patrones de un guion como maximo
+#define BOSS_SCRIPT_GAME 0        // Guion del juego
+#define BOSS_SCRIPT_BULLET_HELL 1 // Guion del benchmark de proyectiles: miles en pantalla
+#define BOSS_SCRIPT_COUNT 2
+
+// Un patron de disparo del jefe. Los angulos van en unidades de ANGLE_TURN por vuelta y la
+// velocidad en celdas por tick en punto fijo (BULLET_ONE es una celda por tick)
+typedef struct
+{
+    int kind;   // PATTERN_*
+    int period; // Ticks entre disparos
+    int count;  // Proyectiles por disparo
+    int arc;    // Apertura del abanico
+    int turn;   // Giro de la espiral en cada disparo
+    int speed;  // Velocidad de los proyectiles
+    int ticks;  // Duracion del patron antes de pasar al siguiente
+} BossPattern;
+
+// Guion del jefe: repite sus patrones en orden mientras esta en combate. Es la unica
+// definicion de cada ataque; la simulacion solo sabe disparar los tres tipos de patron
+typedef struct
+{
+    int count;
+    BossPattern pattern[BOSS_SCRIPT_MAX];
+} BossScript;
+
+extern const BossScript boss_scripts[BOSS_SCRIPT_COUNT]; // Guiones indexados por BOSS_SCRIPT_*
+
+int angle_sin(int angle); // Seno en punto fijo (BULLET_ONE = 1), con una tabla para que sea identico en todas partes
+int angle_cos(int angle); // Coseno en punto fijo
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "frame_buffer.h"
+
+#define FRAME_FALLBACK_SLEEP_US 1000 // Sin eventfd el consumidor revisa cada tanto si hay un cuadro
+
+void frame_buffer_init(FrameBuffer *b)
+{
+    b->write = 0;
+    atomic_store(&b->spare, 1);
+    b->read = 2;
+    b->published = 0;
+    b->consumed = 0;
+    b->waits = 0;
+    b->wake_fd = eventfd(0, EFD_CLOEXEC);
+}
+
+void frame_buffer_free(FrameBuffer *b)
+{
+    if (b->wake_fd != -1)
+    {
+        close(b->wake_fd);
+        b->wake_fd = -1;
+    }
+}
+
+int frame_buffer_write_slot(FrameBuffer *b)
+{
+    return b->write;
+}
+
+// El intercambio con acq_rel publica lo escrito en el cuadro (release) y a la vez trae lo
+// que el consumidor termino de leer en el cuadro que se recibe (acquire). Publicar nunca
+// espera: la escritura en el eventfd solo suma al contador
+void frame_buffer_publish(FrameBuffer *b)
+{
+    unsigned int old = atomic_exchange_explicit(&b->spare, b->write | FRAME_FRESH, memory_order_acq_rel);
+    b->write = old & (FRAME_FRESH - 1);
+    b->published++;
+    frame_buffer_wake(b);
+}
+
+// Solo el productor pone FRAME_FRESH y solo el consumidor lo quita, asi que si el bit esta
+// puesto al leerlo sigue puesto al intercambiar, aunque el productor publique en el medio
+int frame_buffer_acquire(FrameBuffer *b)
+{
+    if (!(atomic_load_explicit(&b->spare, memory_order_relaxed) & FRAME_FRESH))
+    {
+        return -1;
+    }
+    unsigned int old = atomic_exchange_explicit(&b->spare, b->read, memory_order_acq_rel);
+    b->read = old & (FRAME_FRESH - 1);
+    b->consumed++;
+    return b->read;
+}
+
+// El eventfd puede tener cuentas de cuadros que ya se tomaron sin dormir, asi que despues
+// de despertar puede no haber nada nuevo: en ese caso se devuelve -1 y el llamador vuelve a
+// esperar (lo mismo que cuando lo despierta frame_buffer_wake)
+int frame_buffer_wait(FrameBuffer *b)
+{
+    int slot = frame_buffer_acquire(b);
+    if (slot != -1)
+    {
+        return slot;
+    }
+
+    uint64_t count;
+    b->waits++;
+    if (b->wake_fd == -1)
+    {
+        usleep(FRAME_FALLBACK_SLEEP_US);
+    }
+    else if (read(b->wake_fd, &count, sizeof(count)) < 0)
+    {
+        // Interrumpido por una señal: se revisa igual si hay un cuadro
+    }
+    return frame_buffer_acquire(b);
+}
+
+void frame_buffer_wake(FrameBuffer *b)
+{
+    uint64_t one = 1;
+    if (b->wake_fd != -1 && write(b->wake_fd, &one, sizeof(one)) < 0)
+    {
+        // El contador esta saturado: el consumidor ya tiene un despertar pendiente
+    }
+}
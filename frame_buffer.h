@@ -0,0 +1,33 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <stdatomic.h>
+
+#define FRAME_SLOTS 3 // Cuadros: uno del productor, uno del consumidor y uno de intercambio
+#define FRAME_FRESH 4 // Bit de spare que indica que el cuadro de intercambio no se leyo
+
+// Triple buffer sin bloqueos de un solo productor (hilo del juego) y un solo consumidor
+// (hilo de dibujo). Cada uno es dueño de un cuadro y los intercambia con el de spare en un
+// solo atomic_exchange, asi que ninguno espera al otro: si el consumidor se atrasa, el
+// productor pisa el cuadro de intercambio y el consumidor siempre toma el mas reciente.
+// Los cuadros viven fuera de esta estructura; aqui solo se llevan sus indices
+typedef struct
+{
+    _Alignas(64) atomic_uint spare; // Cuadro de intercambio | FRAME_FRESH
+    _Alignas(64) int write;         // Cuadro que esta llenando el productor
+    long published;                 // Cuadros publicados (solo el productor)
+    _Alignas(64) int read;          // Cuadro que esta dibujando el consumidor
+    long consumed;                  // Cuadros tomados (solo el consumidor)
+    long waits;                     // Veces que el consumidor durmio esperando un cuadro
+    int wake_fd;                    // eventfd que el productor incrementa al publicar (-1 si no hay)
+} FrameBuffer;
+
+void frame_buffer_init(FrameBuffer *b);    // Reparte los cuadros 0, 1 y 2 y deja los contadores en cero
+void frame_buffer_free(FrameBuffer *b);    // Cierra el descriptor de despertar
+int frame_buffer_write_slot(FrameBuffer *b); // Productor: cuadro que puede llenar
+void frame_buffer_publish(FrameBuffer *b); // Productor: publica el cuadro lleno y toma el de intercambio
+int frame_buffer_acquire(FrameBuffer *b);  // Consumidor: toma el cuadro mas reciente, -1 si no hay uno nuevo
+int frame_buffer_wait(FrameBuffer *b);     // Consumidor: duerme hasta que hay un cuadro nuevo, -1 si lo desperto frame_buffer_wake
+void frame_buffer_wake(FrameBuffer *b);    // Despierta al consumidor bloqueado en frame_buffer_wait
+
+#endif
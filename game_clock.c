@@ -0,0 +1,117 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "game_clock.h"
+
+#pragma region FUNCIONES_AUXILIARES
+static long diff_ns(struct timespec a, struct timespec b) // a - b en nanosegundos
+{
+    return (a.tv_sec - b.tv_sec) * 1000000000L + (a.tv_nsec - b.tv_nsec);
+}
+
+static void add_ns(struct timespec *t, long ns)
+{
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= 1000000000L)
+    {
+        t->tv_nsec -= 1000000000L;
+        t->tv_sec++;
+    }
+}
+
+static void hist_record(FrameHistogram *h, long ns)
+{
+    long bucket = ns / (HIST_BUCKET_US * 1000L);
+    if (bucket >= HIST_BUCKETS)
+    {
+        bucket = HIST_BUCKETS - 1;
+    }
+    if (bucket < 0)
+    {
+        bucket = 0;
+    }
+    h->counts[bucket]++;
+    h->total++;
+    if (ns > h->max_ns)
+    {
+        h->max_ns = ns;
+    }
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_RELOJ
+void game_clock_init(GameClock *c, long tick_ns, int max_catchup)
+{
+    memset(c, 0, sizeof(*c));
+    c->tick_ns = tick_ns;
+    c->max_catchup = max_catchup;
+    clock_gettime(CLOCK_MONOTONIC, &c->next);
+    c->last_wake = c->next;
+    add_ns(&c->next, tick_ns);
+}
+
+// Duerme hasta el deadline absoluto del proximo tick. Si el cuadro anterior se atraso mas
+// de un tick, devuelve los ticks vencidos para que la simulacion se ponga al dia; si el
+// atraso supera max_catchup, descarta el resto y realinea el reloj con el tiempo actual
+int game_clock_wait(GameClock *c)
+{
+    struct timespec now;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &c->next, NULL) == EINTR)
+    {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int due = 1 + diff_ns(now, c->next) / c->tick_ns;
+    if (due > c->max_catchup)
+    {
+        c->dropped += due - c->max_catchup;
+        due = c->max_catchup;
+        c->next = now;
+        add_ns(&c->next, c->tick_ns);
+    }
+    else
+    {
+        add_ns(&c->next, due * c->tick_ns);
+    }
+
+    hist_record(&c->frame_hist, diff_ns(now, c->last_wake));
+    c->last_wake = now;
+    c->ticks += due;
+    c->caught_up += due - 1;
+    return due;
+}
+
+long hist_percentile(const FrameHistogram *h, double p)
+{
+    if (h->total == 0)
+    {
+        return 0;
+    }
+
+    long target = (long)(h->total * p / 100.0);
+    long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += h->counts[i];
+        if (seen > target)
+        {
+            long upper = (i + 1) * HIST_BUCKET_US * 1000L; // Limite superior del bucket
+            return upper < h->max_ns ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+void game_clock_print_stats(const GameClock *c)
+{
+    const FrameHistogram *h = &c->frame_hist;
+    if (h->total == 0)
+    {
+        return;
+    }
+    printf("frame time: p50 %.2f ms, p99 %.2f ms, max %.2f ms (%ld frames, tick %.2f ms)\n",
+           hist_percentile(h, 50) / 1e6, hist_percentile(h, 99) / 1e6, h->max_ns / 1e6,
+           h->total, c->tick_ns / 1e6);
+    printf("ticks: %ld, caught up: %ld, dropped: %ld\n", c->ticks, c->caught_up, c->dropped);
+}
+#pragma endregion
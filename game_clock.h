@@ -0,0 +1,37 @@
+#ifndef GAME_CLOCK_H
+#define GAME_CLOCK_H
+
+#include <time.h>
+
+#define MAX_CATCHUP_TICKS 5 // Maximo de ticks atrasados que se simulan de una vez
+#define HIST_BUCKET_US 50   // Resolucion del histograma en microsegundos
+#define HIST_BUCKETS 2048   // Cubre hasta ~100 ms, lo demas cae en el ultimo bucket
+
+// Histograma de tiempos de cuadro con buckets lineales
+typedef struct
+{
+    long counts[HIST_BUCKETS];
+    long total;  // Cantidad de muestras
+    long max_ns; // Muestra mas grande (exacta)
+} FrameHistogram;
+
+// Reloj de paso fijo sobre CLOCK_MONOTONIC. Duerme hasta deadlines absolutos, de modo que
+// el tiempo que tarda cada cuadro no se acumula como deriva
+typedef struct
+{
+    struct timespec next;      // Deadline del proximo tick
+    struct timespec last_wake; // Momento en que empezo el cuadro anterior
+    long tick_ns;              // Duracion de un tick
+    int max_catchup;           // Tope de ticks que se devuelven de una vez
+    long ticks;                // Ticks entregados en total
+    long caught_up;            // Ticks simulados de mas para recuperar atraso
+    long dropped;              // Ticks descartados por superar el tope
+    FrameHistogram frame_hist; // Intervalo entre cuadros consecutivos
+} GameClock;
+
+void game_clock_init(GameClock *c, long tick_ns, int max_catchup); // Arranca el reloj, el primer deadline es ahora + tick
+int game_clock_wait(GameClock *c);                                  // Duerme hasta el proximo deadline y devuelve cuantos ticks hay que simular
+long hist_percentile(const FrameHistogram *h, double p);           // Percentil p (0..100) del histograma en nanosegundos
+void game_clock_print_stats(const GameClock *c);                    // Imprime p50/p99/max del tiempo de cuadro
+
+#endif
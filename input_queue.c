@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "input_queue.h"
+
+#define INPUT_FALLBACK_POLL_MS 50 // Sin eventfd se revisa cada tanto si hay que terminar
+
+void input_queue_init(InputQueue *q)
+{
+    atomic_store(&q->head, 0);
+    atomic_store(&q->tail, 0);
+    atomic_store(&q->pushed, 0);
+    atomic_store(&q->dropped, 0);
+    q->popped = 0;
+    q->max_depth = 0;
+    q->latency_ns = 0;
+    q->wakeups = 0;
+    q->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+void input_queue_free(InputQueue *q)
+{
+    if (q->wake_fd != -1)
+    {
+        close(q->wake_fd);
+        q->wake_fd = -1;
+    }
+}
+
+// El hilo de entrada duerme en poll hasta que hay bytes en la terminal o hasta que otro
+// hilo escribe en el eventfd. Una señal (p. ej. SIGWINCH) tambien lo despierta: devuelve 1
+// para que el llamador lea la tecla que la libreria de la terminal haya generado
+int input_wait(InputQueue *q, int fd)
+{
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {q->wake_fd, POLLIN, 0}};
+    int n = poll(fds, q->wake_fd != -1 ? 2 : 1, q->wake_fd != -1 ? -1 : INPUT_FALLBACK_POLL_MS);
+    q->wakeups++;
+    if (n < 0)
+    {
+        return errno == EINTR;
+    }
+    if (fds[1].revents & POLLIN)
+    {
+        uint64_t count;
+        if (read(q->wake_fd, &count, sizeof(count)) < 0)
+        {
+            // El contador ya estaba en cero: otro input_wait lo consumio
+        }
+        return 0;
+    }
+    return (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+}
+
+void input_wake(InputQueue *q)
+{
+    uint64_t one = 1;
+    if (q->wake_fd != -1 && write(q->wake_fd, &one, sizeof(one)) < 0)
+    {
+        // El contador esta saturado: el productor ya tiene un despertar pendiente
+    }
+}
+
+long input_now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+// El productor escribe el evento y luego publica head con release, asi el consumidor
+// que lea head con acquire ve el evento completo
+int input_queue_push(InputQueue *q, int key)
+{
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head - tail == INPUT_QUEUE_SIZE)
+    {
+        atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    InputEvent *ev = &q->events[head & (INPUT_QUEUE_SIZE - 1)];
+    ev->key = key;
+    ev->time_ns = input_now_ns();
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&q->pushed, 1, memory_order_relaxed);
+    return 1;
+}
+
+int input_queue_pop(InputQueue *q, InputEvent *ev)
+{
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail == head)
+    {
+        return 0;
+    }
+
+    if ((long)(head - tail) > q->max_depth)
+    {
+        q->max_depth = head - tail;
+    }
+
+    *ev = q->events[tail & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    q->popped++;
+    q->latency_ns += input_now_ns() - ev->time_ns;
+    return 1;
+}
+
+long input_queue_depth(InputQueue *q)
+{
+    return atomic_load(&q->head) - atomic_load(&q->tail);
+}
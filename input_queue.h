@@ -0,0 +1,41 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdatomic.h>
+
+#define INPUT_QUEUE_SIZE 256 // Capacidad de la cola (potencia de 2)
+
+// Tecla leida por el hilo de entrada junto con el instante en que se leyo
+typedef struct
+{
+    int key;
+    long time_ns; // CLOCK_MONOTONIC al momento de leer la tecla
+} InputEvent;
+
+// Cola circular sin bloqueos de un solo productor (hilo de entrada) y un solo consumidor
+// (bucle del juego). head solo lo escribe el productor y tail solo el consumidor; cada uno
+// vive en su propia linea de cache para que los hilos no se estorben
+typedef struct
+{
+    InputEvent events[INPUT_QUEUE_SIZE];
+    _Alignas(64) atomic_ulong head;  // Proxima posicion a escribir
+    _Alignas(64) atomic_ulong tail;  // Proxima posicion a leer
+    _Alignas(64) atomic_long pushed; // Eventos encolados
+    atomic_long dropped;             // Eventos descartados por cola llena
+    long popped;                     // Eventos consumidos (solo el consumidor)
+    long max_depth;                  // Mayor profundidad vista al vaciar (solo el consumidor)
+    long latency_ns;                 // Suma de latencias lectura -> consumo (solo el consumidor)
+    int wake_fd;                     // eventfd para despertar al productor bloqueado en input_wait (-1 si no hay)
+    long wakeups;                    // Veces que input_wait volvio (solo el productor)
+} InputQueue;
+
+void input_queue_init(InputQueue *q);               // Deja la cola vacia y los contadores en cero
+void input_queue_free(InputQueue *q);               // Cierra el descriptor de despertar
+int input_wait(InputQueue *q, int fd);              // Productor: espera sin consumir CPU a que fd tenga datos (1) o a input_wake (0)
+void input_wake(InputQueue *q);                     // Despierta al productor bloqueado en input_wait
+int input_queue_push(InputQueue *q, int key);       // Productor: encola una tecla, devuelve 0 si la cola esta llena
+int input_queue_pop(InputQueue *q, InputEvent *ev); // Consumidor: saca un evento, devuelve 0 si la cola esta vacia
+long input_queue_depth(InputQueue *q);              // Eventos pendientes en este momento
+long input_now_ns();                                // Tiempo CLOCK_MONOTONIC en nanosegundos
+
+#endif
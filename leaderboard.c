@@ -0,0 +1,668 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "leaderboard.h"
+#include "save_file.h"
+#include "profiler.h"
+
+#define LEADERBOARD_CHUNK 4096 // Entradas que se leen o escriben por llamada al sistema
+
+#pragma region FUNCIONES_AUXILIARES
+// Orden de la tabla: mayor puntuacion primero y, entre iguales, la partida mas antigua
+static int compare_entries(const void *a, const void *b)
+{
+    const LeaderboardEntry *x = a, *y = b;
+    if (x->score != y->score)
+    {
+        return x->score > y->score ? -1 : 1;
+    }
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+// Entradas de un arreglo ordenado con puntuacion mayor que score (below = 0) o mayor o
+// igual (below = 1). Es la posicion donde empiezan las demas, por busqueda binaria
+static size_t count_above(const LeaderboardEntry *e, size_t n, int score, int below)
+{
+    size_t lo = 0, hi = n;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (e[mid].score > score || (below && e[mid].score == score))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static uint32_t header_checksum(const LeaderboardHeader *h)
+{
+    return save_crc32(h, offsetof(LeaderboardHeader, checksum), 0);
+}
+
+// Cola que se tolera antes de compactar: una fraccion del indice, asi reescribirlo cuesta
+// O(1) amortizado por partida
+static size_t tail_limit(const Leaderboard *b)
+{
+    size_t limit = b->indexed / LEADERBOARD_TAIL_RATIO;
+    return limit < LEADERBOARD_TAIL_MIN ? LEADERBOARD_TAIL_MIN : limit;
+}
+
+// La cola y el buffer de mezcla crecen juntos: despues de mezclar se intercambian
+static int tail_reserve(Leaderboard *b, size_t count)
+{
+    if (count <= b->tail_capacity)
+    {
+        return 0;
+    }
+    size_t capacity = b->tail_capacity ? b->tail_capacity * 2 : LEADERBOARD_RECENT;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    LeaderboardEntry *tail = realloc(b->tail, capacity * sizeof(LeaderboardEntry));
+    if (tail == NULL)
+    {
+        return -1;
+    }
+    b->tail = tail;
+    LeaderboardEntry *merged = realloc(b->merged, capacity * sizeof(LeaderboardEntry));
+    if (merged == NULL)
+    {
+        return -1;
+    }
+    b->merged = merged;
+    b->tail_capacity = capacity;
+    return 0;
+}
+
+// Recorre en orden varios niveles a la vez, como una mezcla de k vias
+typedef struct
+{
+    const LeaderboardEntry *e[4];
+    size_t n[4], i[4];
+    int levels;
+} Cursor;
+
+static void cursor_add(Cursor *c, const LeaderboardEntry *e, size_t n)
+{
+    c->e[c->levels] = e;
+    c->n[c->levels] = n;
+    c->i[c->levels] = 0;
+    c->levels++;
+}
+
+// Los cuatro niveles de la tabla: indice, cola congelada, cola y recientes
+static void cursor_init(Cursor *c, const Leaderboard *b)
+{
+    c->levels = 0;
+    cursor_add(c, b->index, b->indexed);
+    cursor_add(c, b->frozen, b->frozen_count);
+    cursor_add(c, b->tail, b->tail_count);
+    cursor_add(c, b->recent, b->recent_count);
+}
+
+// Proxima entrada en el orden de la tabla, NULL al terminar
+static const LeaderboardEntry *cursor_next(Cursor *c)
+{
+    int best = -1;
+    for (int k = 0; k < c->levels; k++)
+    {
+        if (c->i[k] < c->n[k] &&
+            (best == -1 || compare_entries(&c->e[k][c->i[k]], &c->e[best][c->i[best]]) < 0))
+        {
+            best = k;
+        }
+    }
+    return best == -1 ? NULL : &c->e[best][c->i[best]++];
+}
+
+static long rank_locked(const Leaderboard *b, int score)
+{
+    return 1 + count_above(b->index, b->indexed, score, 0) + count_above(b->frozen, b->frozen_count, score, 0) +
+           count_above(b->tail, b->tail_count, score, 0) + count_above(b->recent, b->recent_count, score, 0);
+}
+
+// Mezcla dos arreglos ordenados en out
+static void merge_sorted(LeaderboardEntry *out, const LeaderboardEntry *a, size_t na, const LeaderboardEntry *b,
+                         size_t nb)
+{
+    size_t i = 0, j = 0, n = 0;
+    while (i < na || j < nb)
+    {
+        if (j == nb || (i < na && compare_entries(&a[i], &b[j]) < 0))
+        {
+            out[n++] = a[i++];
+        }
+        else
+        {
+            out[n++] = b[j++];
+        }
+    }
+}
+
+// Mezcla las recientes con la cola en el buffer de mezcla, que pasa a ser la cola
+static int merge_recent(Leaderboard *b)
+{
+    if (tail_reserve(b, b->tail_count + b->recent_count) != 0)
+    {
+        return -1;
+    }
+    merge_sorted(b->merged, b->tail, b->tail_count, b->recent, b->recent_count);
+    LeaderboardEntry *tail = b->tail;
+    b->tail = b->merged;
+    b->merged = tail;
+    b->tail_count += b->recent_count;
+    b->recent_count = 0;
+    return 0;
+}
+
+static void unmap_index(Leaderboard *b)
+{
+    if (b->map != NULL)
+    {
+        munmap(b->map, b->map_size);
+    }
+    b->map = NULL;
+    b->map_size = 0;
+    b->index = NULL;
+    b->indexed = 0;
+    b->indexed_records = 0;
+}
+
+// Mapea el indice sin leer sus entradas: las paginas se cargan a medida que las tocan las
+// busquedas. Se rechaza si falta, es de otra version, tiene la cabecera dañada o esta truncado.
+// No toca la tabla: el mapeo queda en *map_out hasta que use_index lo instala
+static int map_index(const char *path, void **map_out, size_t *size_out)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LeaderboardHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    const LeaderboardHeader *h = map;
+    if (h->magic != LEADERBOARD_MAGIC || h->version != LEADERBOARD_VERSION || h->checksum != header_checksum(h) ||
+        h->entry_size != sizeof(LeaderboardEntry) ||
+        (size_t)st.st_size < sizeof(LeaderboardHeader) + (size_t)h->count * sizeof(LeaderboardEntry))
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    *map_out = map;
+    *size_out = st.st_size;
+    return 0;
+}
+
+// Reemplaza el indice de la tabla por un mapeo de map_index
+static void use_index(Leaderboard *b, void *map, size_t size)
+{
+    const LeaderboardHeader *h = map;
+    unmap_index(b);
+    b->map = map;
+    b->map_size = size;
+    b->index = (const LeaderboardEntry *)(h + 1);
+    b->indexed = h->count;
+    b->indexed_records = h->log_records;
+}
+
+// Lee los registros del log que no cubre el indice y los deja en la cola. El primer
+// registro incompleto o dañado corta el log ahi: lo que sigue no se puede ubicar
+static int read_log(Leaderboard *b, uint64_t records, off_t size)
+{
+    LeaderboardRecord *chunk = malloc(LEADERBOARD_CHUNK * sizeof(LeaderboardRecord));
+    if (chunk == NULL)
+    {
+        return -1;
+    }
+
+    uint64_t seq = b->indexed_records;
+    while (seq < records)
+    {
+        size_t n = records - seq < LEADERBOARD_CHUNK ? records - seq : LEADERBOARD_CHUNK;
+        ssize_t got = pread(b->log_fd, chunk, n * sizeof(LeaderboardRecord), seq * sizeof(LeaderboardRecord));
+        if (got < 0 || tail_reserve(b, b->tail_count + n) != 0)
+        {
+            free(chunk);
+            return -1;
+        }
+        size_t valid = 0;
+        n = got / sizeof(LeaderboardRecord);
+        while (valid < n && chunk[valid].entry.seq == seq + valid &&
+               chunk[valid].checksum == save_crc32(&chunk[valid].entry, sizeof(LeaderboardEntry), 0))
+        {
+            b->tail[b->tail_count++] = chunk[valid++].entry;
+        }
+        seq += valid;
+        if (valid < n || n == 0)
+        {
+            break;
+        }
+    }
+    free(chunk);
+
+    b->loaded = seq - b->indexed_records;
+    b->log_records = seq;
+    if ((off_t)(seq * sizeof(LeaderboardRecord)) != size)
+    {
+        b->dropped = records - seq + ((off_t)(records * sizeof(LeaderboardRecord)) != size);
+        if (ftruncate(b->log_fd, seq * sizeof(LeaderboardRecord)) != 0)
+        {
+            return -1;
+        }
+    }
+    if (b->tail_count > 0)
+    {
+        qsort(b->tail, b->tail_count, sizeof(LeaderboardEntry), compare_entries);
+    }
+    return 0;
+}
+
+// Escribe en name.idx.tmp las entradas de c, que cubren los primeros records registros del
+// log, y reemplaza al indice con rename, asi un corte deja uno de los dos completo. Antes se
+// sincroniza el log: el indice nunca cubre registros que no esten en el disco. No usa la
+// tabla salvo las rutas y el log, asi que el compactador la llama sin el mutex
+static int write_index(Leaderboard *b, Cursor *c, size_t count, uint64_t records)
+{
+    char tmp[sizeof(b->index_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", b->index_path);
+    LeaderboardEntry *chunk = malloc(LEADERBOARD_CHUNK * sizeof(LeaderboardEntry));
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (chunk == NULL || fd == -1 || fdatasync(b->log_fd) != 0)
+    {
+        free(chunk);
+        if (fd != -1)
+        {
+            close(fd);
+            unlink(tmp);
+        }
+        return -1;
+    }
+
+    LeaderboardHeader h = {LEADERBOARD_MAGIC, LEADERBOARD_VERSION, sizeof(LeaderboardEntry), (uint32_t)count, records, 0, 0};
+    h.checksum = header_checksum(&h);
+    int failed = save_write_all(fd, &h, sizeof(h), 0) != 0;
+
+    const LeaderboardEntry *e;
+    size_t used = 0;
+    off_t offset = sizeof(h);
+    while (!failed && (e = cursor_next(c)) != NULL)
+    {
+        chunk[used++] = *e;
+        if (used == LEADERBOARD_CHUNK)
+        {
+            failed = save_write_all(fd, chunk, used * sizeof(LeaderboardEntry), offset) != 0;
+            offset += used * sizeof(LeaderboardEntry);
+            used = 0;
+        }
+    }
+    failed |= used > 0 && save_write_all(fd, chunk, used * sizeof(LeaderboardEntry), offset) != 0;
+    free(chunk);
+
+    failed |= fsync(fd) != 0;
+    failed |= close(fd) != 0;
+    if (failed || rename(tmp, b->index_path) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    save_sync_parent_dir(b->index_path);
+    return 0;
+}
+
+// Compacta en el hilo que llama, con el mutex tomado y el compactador quieto: lo usan
+// leaderboard_compact, el cierre y la falta de memoria para mezclar las recientes
+static int compact_locked(Leaderboard *b)
+{
+    if (b->frozen_count == 0 && b->tail_count == 0 && b->recent_count == 0)
+    {
+        return 0;
+    }
+
+    long begin = prof_now_ns();
+    Cursor c;
+    void *map;
+    size_t size;
+    cursor_init(&c, b);
+    // map_index solo toca la tabla si lo mapea: si falla quedan el indice viejo y los demas
+    // niveles, con las mismas partidas que el archivo nuevo
+    if (write_index(b, &c, b->indexed + b->frozen_count + b->tail_count + b->recent_count, b->log_records) != 0 ||
+        map_index(b->index_path, &map, &size) != 0)
+    {
+        b->failed++;
+        return -1;
+    }
+    use_index(b, map, size);
+    free(b->frozen);
+    b->frozen = NULL;
+    b->frozen_count = 0;
+    b->tail_count = 0;
+    b->recent_count = 0;
+    b->compactions++;
+    b->compact_ns += prof_now_ns() - begin;
+    return 0;
+}
+
+// Congela la cola y despierta al compactador, que la mezcla con el indice sin el mutex. Las
+// partidas nuevas siguen llegando a las recientes y a una cola nueva. Si quedo una cola
+// congelada de una compactacion fallida, la cola se le suma
+static void start_compaction(Leaderboard *b)
+{
+    if (b->compacting || (b->frozen_count == 0 && b->tail_count == 0))
+    {
+        return;
+    }
+    if (b->frozen_count == 0)
+    {
+        b->frozen = b->tail;
+        b->frozen_count = b->tail_count;
+        b->tail = NULL;
+        b->tail_count = b->tail_capacity = 0;
+    }
+    else if (b->tail_count > 0)
+    {
+        LeaderboardEntry *both = malloc((b->frozen_count + b->tail_count) * sizeof(LeaderboardEntry));
+        if (both == NULL)
+        {
+            b->failed++;
+            return;
+        }
+        merge_sorted(both, b->frozen, b->frozen_count, b->tail, b->tail_count);
+        free(b->frozen);
+        b->frozen = both;
+        b->frozen_count += b->tail_count;
+        b->tail_count = 0;
+    }
+    // Las recientes son siempre las ultimas partidas del log: lo anterior queda congelado
+    b->frozen_records = b->log_records - b->recent_count;
+    b->compacting = 1;
+    pthread_cond_signal(&b->wake);
+}
+
+// Hilo compactador. Con el mutex solo toma el indice y la cola congelada, que nadie mas
+// modifica mientras compacting vale 1, y al final instala el indice nuevo. La mezcla y los
+// fsync corren sin el mutex: agregar partidas y consultar no esperan a la compactacion
+static void *compactor_loop(void *arg)
+{
+    Leaderboard *b = arg;
+    pthread_mutex_lock(&b->lock);
+    while (1)
+    {
+        while (!b->compacting && !b->stopping)
+        {
+            pthread_cond_wait(&b->wake, &b->lock);
+        }
+        if (!b->compacting)
+        {
+            break;
+        }
+
+        Cursor c;
+        c.levels = 0;
+        cursor_add(&c, b->index, b->indexed);
+        cursor_add(&c, b->frozen, b->frozen_count);
+        size_t count = b->indexed + b->frozen_count;
+        uint64_t records = b->frozen_records;
+        pthread_mutex_unlock(&b->lock);
+
+        long begin = prof_now_ns();
+        void *map;
+        size_t size;
+        int status = write_index(b, &c, count, records) == 0 && map_index(b->index_path, &map, &size) == 0 ? 0 : -1;
+        long elapsed = prof_now_ns() - begin;
+
+        pthread_mutex_lock(&b->lock);
+        b->compacting = 0;
+        if (status == 0)
+        {
+            use_index(b, map, size);
+            free(b->frozen);
+            b->frozen = NULL;
+            b->frozen_count = 0;
+            b->compactions++;
+            b->compact_ns += elapsed;
+            if (b->tail_count >= tail_limit(b) && !b->stopping)
+            {
+                start_compaction(b); // La cola volvio a llenarse mientras se escribia
+            }
+        }
+        else
+        {
+            b->failed++; // La cola congelada queda como nivel hasta la proxima compactacion
+        }
+        pthread_cond_broadcast(&b->done);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+// Vacia las recientes en la cola y, si la cola llego a su limite, le pide al compactador un
+// indice nuevo. Si no hay memoria para mezclar se compacta aca, que no la necesita
+static int drain_recent(Leaderboard *b)
+{
+    if (merge_recent(b) != 0)
+    {
+        return b->compacting ? -1 : compact_locked(b);
+    }
+    if (b->tail_count >= tail_limit(b))
+    {
+        start_compaction(b);
+    }
+    return 0;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_LA_TABLA
+static void destroy_sync(Leaderboard *b)
+{
+    pthread_cond_destroy(&b->done);
+    pthread_cond_destroy(&b->wake);
+    pthread_mutex_destroy(&b->lock);
+}
+
+// Al abrir solo se mapea el indice y se lee la cola del log que quedo sin compactar; si llega
+// a tail_limit se le pide un indice nuevo al compactador. Si el indice
+// falta, esta dañado o cubre mas registros de los que tiene el log, se rehace desde el log
+// completo
+int leaderboard_open(Leaderboard *b, const char *name)
+{
+    struct stat st;
+    memset(b, 0, sizeof(*b));
+    snprintf(b->log_path, sizeof(b->log_path), "%s.log", name);
+    snprintf(b->index_path, sizeof(b->index_path), "%s.idx", name);
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->wake, NULL);
+    pthread_cond_init(&b->done, NULL);
+    b->recent = malloc(LEADERBOARD_RECENT * sizeof(LeaderboardEntry));
+    b->log_fd = open(b->log_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (b->recent == NULL || b->log_fd == -1 || fstat(b->log_fd, &st) != 0)
+    {
+        free(b->recent);
+        if (b->log_fd != -1)
+        {
+            close(b->log_fd);
+        }
+        destroy_sync(b);
+        return -1;
+    }
+
+    void *map;
+    size_t size;
+    uint64_t records = st.st_size / sizeof(LeaderboardRecord);
+    if (map_index(b->index_path, &map, &size) == 0)
+    {
+        use_index(b, map, size);
+    }
+    if (b->indexed_records > records)
+    {
+        unmap_index(b);
+    }
+    if (read_log(b, records, st.st_size) != 0 || pthread_create(&b->compactor, NULL, compactor_loop, b) != 0)
+    {
+        unmap_index(b);
+        free(b->tail);
+        free(b->merged);
+        free(b->recent);
+        close(b->log_fd);
+        destroy_sync(b);
+        return -1;
+    }
+    pthread_mutex_lock(&b->lock);
+    if (b->tail_count >= tail_limit(b))
+    {
+        start_compaction(b);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+void leaderboard_close(Leaderboard *b)
+{
+    if (b->log_fd == -1)
+    {
+        return;
+    }
+    // El compactador termina la compactacion en curso antes de salir
+    pthread_mutex_lock(&b->lock);
+    b->stopping = 1;
+    pthread_cond_signal(&b->wake);
+    pthread_mutex_unlock(&b->lock);
+    pthread_join(b->compactor, NULL);
+
+    // Lo que no esta en el indice ya esta en el log y la proxima apertura lo lee: reescribir
+    // el indice en cada cierre costaria O(n) aunque se haya jugado una sola partida
+    if (b->frozen_count + b->tail_count + b->recent_count >= tail_limit(b))
+    {
+        compact_locked(b);
+    }
+    unmap_index(b);
+    free(b->frozen);
+    free(b->tail);
+    free(b->merged);
+    free(b->recent);
+    close(b->log_fd);
+    destroy_sync(b);
+    b->frozen = b->tail = b->merged = b->recent = NULL;
+    b->frozen_count = b->tail_count = b->tail_capacity = b->recent_count = 0;
+    b->log_fd = -1;
+}
+
+// El registro se agrega con un solo write sobre el log abierto con O_APPEND y sin fsync: una
+// partida cuesta unos microsegundos en el hilo del juego. Se sincroniza al compactar
+long leaderboard_add(Leaderboard *b, int score, unsigned long ticks)
+{
+    LeaderboardRecord r;
+    memset(&r, 0, sizeof(r));
+    pthread_mutex_lock(&b->lock);
+
+    // Si la ultima vez no se pudieron vaciar las recientes se reintenta; si siguen llenas la
+    // partida no se registra, ni en el log, para que el indice nunca cubra una que falte
+    if (b->recent_count == LEADERBOARD_RECENT)
+    {
+        drain_recent(b);
+    }
+    if (b->recent_count == LEADERBOARD_RECENT)
+    {
+        b->failed++;
+        pthread_mutex_unlock(&b->lock);
+        return -1;
+    }
+    r.entry.score = score;
+    r.entry.ticks = ticks > UINT32_MAX ? UINT32_MAX : ticks;
+    r.entry.seq = b->log_records;
+    r.entry.time = time(NULL);
+    r.checksum = save_crc32(&r.entry, sizeof(r.entry), 0);
+
+    ssize_t n = write(b->log_fd, &r, sizeof(r));
+    if (n != (ssize_t)sizeof(r))
+    {
+        // Un registro a medias correria a todos los siguientes: se quita
+        if (n > 0 && ftruncate(b->log_fd, b->log_records * sizeof(LeaderboardRecord)) != 0)
+        {
+            b->failed++;
+        }
+        b->failed++;
+        pthread_mutex_unlock(&b->lock);
+        return -1;
+    }
+
+    // Las puntuaciones iguales quedan despues de las anteriores
+    size_t pos = count_above(b->recent, b->recent_count, score, 1);
+    memmove(b->recent + pos + 1, b->recent + pos, (b->recent_count - pos) * sizeof(LeaderboardEntry));
+    b->recent[pos] = r.entry;
+    b->recent_count++;
+    b->log_records++;
+    long rank = rank_locked(b, score);
+
+    if (b->recent_count == LEADERBOARD_RECENT)
+    {
+        drain_recent(b);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return rank;
+}
+
+long leaderboard_rank(Leaderboard *b, int score)
+{
+    pthread_mutex_lock(&b->lock);
+    long rank = rank_locked(b, score);
+    pthread_mutex_unlock(&b->lock);
+    return rank;
+}
+
+long leaderboard_count(Leaderboard *b)
+{
+    pthread_mutex_lock(&b->lock);
+    long count = b->indexed + b->frozen_count + b->tail_count + b->recent_count;
+    pthread_mutex_unlock(&b->lock);
+    return count;
+}
+
+int leaderboard_top(Leaderboard *b, int k, LeaderboardEntry *out)
+{
+    Cursor c;
+    const LeaderboardEntry *e;
+    int n = 0;
+    pthread_mutex_lock(&b->lock);
+    cursor_init(&c, b);
+    while (n < k && (e = cursor_next(&c)) != NULL)
+    {
+        out[n++] = *e;
+    }
+    pthread_mutex_unlock(&b->lock);
+    return n;
+}
+
+int leaderboard_compact(Leaderboard *b)
+{
+    pthread_mutex_lock(&b->lock);
+    while (b->compacting)
+    {
+        pthread_cond_wait(&b->done, &b->lock);
+    }
+    int status = compact_locked(b);
+    pthread_mutex_unlock(&b->lock);
+    return status;
+}
+#pragma endregion
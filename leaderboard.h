@@ -0,0 +1,93 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LEADERBOARD_MAGIC 0x424C4941u // "AILB" en little endian
+#define LEADERBOARD_VERSION 1         // Se incrementa cuando cambia el formato del indice o del registro
+#define LEADERBOARD_RECENT 1024       // Partidas que se insertan ordenadas antes de mezclarlas con la cola
+#define LEADERBOARD_TAIL_MIN 4096     // Partidas fuera del indice que se toleran antes de compactar
+#define LEADERBOARD_TAIL_RATIO 8      // ... o una fraccion del indice, si es mayor
+#define LEADERBOARD_SHOWN 5           // Puntuaciones de la tabla en la pantalla de inicio
+
+// Una partida terminada. seq es su posicion en el registro: desempata las puntuaciones
+// iguales a favor de la mas antigua
+typedef struct
+{
+    int32_t score;
+    uint32_t ticks; // Ticks que duro la partida
+    uint32_t seq;   // Posicion en el registro
+    uint32_t time;  // Momento en que termino (segundos desde 1970)
+} LeaderboardEntry;
+
+// Registro de name.log: solo se agregan al final. Una escritura cortada deja el ultimo
+// registro incompleto o con otro checksum y se descarta al abrir
+typedef struct
+{
+    LeaderboardEntry entry;
+    uint32_t checksum; // CRC-32 de entry
+} LeaderboardRecord;
+
+// Cabecera de name.idx, seguida de count entradas ordenadas de mayor a menor puntuacion.
+// El indice cubre los primeros log_records registros; el resto es la cola
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+    uint64_t log_records;
+    uint32_t checksum; // CRC-32 de los campos anteriores
+    uint32_t reserved;
+} LeaderboardHeader;
+
+// Tabla de puntuaciones en tres niveles ordenados igual: el indice compactado, mapeado de
+// solo lectura sin leerlo; la cola en memoria con las partidas posteriores, y las partidas
+// recientes, un arreglo chico donde insertar cuesta poco. Las consultas buscan en los tres:
+// la posicion de una puntuacion es O(log n) y las K mejores O(K). Insertar mueve a lo sumo
+// LEADERBOARD_RECENT entradas; las recientes se mezclan con la cola cuando se llenan y la
+// cola con el indice, en un archivo nuevo, cuando llega a una fraccion de el. Esa mezcla la
+// hace un hilo compactador sin el mutex: la cola se congela como un cuarto nivel y las
+// partidas siguen entrando a una cola nueva. Un mutex permite compartirla entre hilos
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_t compactor;            // Hilo que reescribe el indice
+    pthread_cond_t wake;            // Despierta al compactador
+    pthread_cond_t done;            // El compactador termino una compactacion
+    int compacting;                 // Hay una compactacion pedida o en curso
+    int stopping;                   // El compactador debe salir
+    int log_fd;                     // name.log abierto para agregar al final
+    char log_path[4096], index_path[4096];
+    void *map;                      // name.idx mapeado (NULL si no hay indice)
+    size_t map_size;
+    const LeaderboardEntry *index;  // Entradas del indice, dentro del mapeo
+    size_t indexed;                 // Entradas del indice
+    uint64_t indexed_records;       // Registros del log que cubre el indice
+    LeaderboardEntry *tail;         // Partidas posteriores al indice, ordenadas como el indice
+    size_t tail_count, tail_capacity;
+    LeaderboardEntry *frozen;       // Cola que el compactador esta mezclando con el indice
+    size_t frozen_count;
+    uint64_t frozen_records;        // Registros del log que cubren el indice y la cola congelada
+    LeaderboardEntry *merged;       // Buffer donde se mezclan las recientes con la cola
+    LeaderboardEntry *recent;       // Ultimas partidas, LEADERBOARD_RECENT como maximo
+    size_t recent_count;
+    uint64_t log_records;           // Registros validos del log (seq de la proxima partida)
+    long loaded;                    // Registros leidos del log al abrir
+    long dropped;                   // Registros dañados descartados al abrir
+    long compactions;               // Indices reescritos
+    long failed;                    // Escrituras o compactaciones que fallaron
+    long compact_ns;                // Tiempo total de las compactaciones
+} Leaderboard;
+
+int leaderboard_open(Leaderboard *b, const char *name); // Abre name.log y name.idx (los crea si faltan), -1 si falla
+void leaderboard_close(Leaderboard *b);                 // Espera al compactador, compacta si la cola llego a su limite y libera todo
+long leaderboard_add(Leaderboard *b, int score, unsigned long ticks); // Registra una partida terminada: su posicion, -1 si falla
+long leaderboard_rank(Leaderboard *b, int score);       // Posicion que ocuparia score (1 = la mejor)
+long leaderboard_count(Leaderboard *b);                 // Partidas registradas
+int leaderboard_top(Leaderboard *b, int k, LeaderboardEntry *out); // Copia las k mejores partidas: cuantas hay
+int leaderboard_compact(Leaderboard *b);                // Mezcla todo con el indice en un indice nuevo en el hilo que llama, -1 si falla
+
+#endif
@@ -1,29 +1,56 @@
 #pragma region _DEFINICIONES_Y_MACROS
+#define _GNU_SOURCE // ptsname_r
 #include <ncurses.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
-
-#define DELAY 30000          // Tiempo de espera entre actualizaciones en microsegundos
-#define MAX_PROJECTILES 5    // Máximo número de proyectiles que puede tener el jugador
-#define BMAX_PROJECTILES 1   // Máximo número de proyectiles que puede tener el jefe
-#define MAX_ENEMIES 10       // Máximo número de enemigos en el juego
-#define SPEED_LOW_ENEMIES 10 // Velocidad de movimiento de los enemigos
-#define MAX_SAVED_GAMES 3    // Maximo de partidas a guardar
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "render.h"
+#include "term.h"
+#include "sprites.h"
+#include "boss_patterns.h"
+#include "game_clock.h"
+#include "input_queue.h"
+#include "save_file.h"
+#include "slot_store.h"
+#include "replay.h"
+#include "workpool.h"
+#include "profiler.h"
+#include "frame_buffer.h"
+#include "spectate.h"
+#include "leaderboard.h"
+
+#define DEFAULT_SAVE_SLOTS 3 // Registros de partidas si no se indica --slots
+#define LEGACY_SAVED_GAMES 3 // Partidas del archivo del formato anterior
+#define MENU_PAGE_MAX 9      // Partidas por pagina en el menu de carga (se eligen con un digito)
 #define min(x, y) x < y ? x : y
-#define BOSS_TIME 5
-
-typedef struct
-{
-    int x, y;
-} Position;
-
-typedef struct
-{
-    Position pos;
-    int is_active; // Indica si el proyectil está activo o no
-} Projectile;
+#define BENCH_ROWS 40        // Filas del tablero usado en el modo benchmark
+#define BENCH_COLS 120       // Columnas del tablero usado en el modo benchmark
+#define SWARM_ROWS 250       // Filas del tablero en la configuracion swarm
+#define SWARM_COLS 500       // Columnas del tablero en la configuracion swarm
+#define SWARM_SHOTS 400      // Proyectiles que se disparan por tick en la configuracion swarm
+#define BATCH_MAX_TICKS 100000 // Tope de ticks de cada partida del modo batch si no se indica --ticks
+#define PROFILE_COLS 44        // Ancho del overlay del perfilador
+#define HOST_ROWS 24           // Filas de la pantalla de cada sesion del modo anfitrion
+#define HOST_COLS 80           // Columnas de la pantalla de cada sesion del modo anfitrion
+#define HOST_EVENTS 64         // Eventos que el anfitrion atiende por llamada a epoll_wait
+#define LEADERBOARD_NAME "leaderboard"           // Tabla de puntuaciones del juego (.log y .idx)
+#define HOST_LEADERBOARD_NAME "host_leaderboard" // Tabla que comparten las sesiones del modo anfitrion
 
 typedef struct
 {
@@ -34,768 +61,827 @@ typedef struct
     int health_points;
 } Saved_Games;
 
+// Tiempos de los guardados. stall es lo que el hilo del juego queda detenido por cada
+// guardado; write es lo que tarda el hijo (o el hilo de guardado del anfitrion) en escribir
+// el archivo, en paralelo al juego
+typedef struct
+{
+    long saves;
+    long autosaves;
+    long failed;
+    long writes;
+    long stall_ns;
+    long max_stall_ns;
+    long write_ns;
+    long max_write_ns;
+} SaveStats;
+
+// Resultado de una partida del modo batch
+typedef struct
+{
+    unsigned long seed;
+    int score;
+    long ticks;     // Ticks sobrevividos (o el tope si no murio)
+    int boss_kills;
+    int died;       // 0 si la partida llego al tope de ticks
+} BatchResult;
+
+// Tecla de un guion de entrada: se aplica antes de simular el tick indicado
+typedef struct
+{
+    unsigned long tick;
+    int key;
+} ScriptKey;
+
+// Partidas del modo batch. Cada hilo simula sobre su propio mundo y escribe solo los
+// resultados de sus partidas, asi que no se comparte nada mutable entre hilos
 typedef struct
 {
-    Position pos;
-    int is_active; // Indica si el enemigo está activo o no
-    int type;   // Tipo de enemigo (para variedad visual)
-} Enemy;
+    World *worlds;          // Un mundo por hilo
+    BatchResult *results;   // Un resultado por partida
+    unsigned long seed;     // Semilla de la partida 0; la partida i usa seed + i
+    long max_ticks;
+    const ScriptKey *script; // Teclas del guion (NULL juega el bot)
+    long script_keys;
+} Batch;
+
+// Entidades de una clase copiadas del mundo al publicar un cuadro
+typedef struct
+{
+    int count;
+    int *id, *x, *y;     // Identificador estable y posicion de cada entidad
+    unsigned char *type; // Tipo de cada enemigo (NULL en los proyectiles)
+} FrameEntities;
 
+// Instantanea inmutable de lo que se ve en pantalla. El hilo del juego la llena al final de
+// cada cuadro y el hilo de dibujo la dibuja sin tocar world ni las variables del juego
+typedef struct
+{
+    unsigned long tick; // Tick de la simulacion al publicar
+    int state;          // Estado del juego al publicar
+    int screen;         // Cambia cuando una pantalla estatica tiene que redibujarse
+    int rows, cols;     // Tablero de la partida
+    int hp, score, high_score;
+    Position player;
+    Boss boss;
+    FrameEntities projectiles, enemies, boss_projectiles;
+    int show_profile;
+    int menu_total, menu_page, menu_pages, menu_games; // Menu de carga
+    int menu_invalid;                                  // 1 si se eligio una partida que no existe
+    Saved_Games menu[MENU_PAGE_MAX];                   // Partidas de la pagina del menu
+    long rank, runs;                                   // Posicion de la ultima partida y partidas de la tabla
+    int top_count;                                     // Puntuaciones de la tabla de la pantalla de inicio
+    int top[LEADERBOARD_SHOWN];
+} Frame;
+
+// Una partida con todo lo que la rodea: mundo, menu, guardados, grabacion, reloj y colas
+// entre hilos. Cada funcion del juego la recibe como primer argumento, asi un proceso
+// puede llevar varias a la vez (el modo anfitrion tiene una por sesion). Las funciones
+// update_* y check_* de la simulacion ya reciben solo el World que vive aqui
 typedef struct
 {
-    Position pos;
-    int hp;
-    int direction;
-    int is_active;
-    int is_arriving;
-} Boss;
-
-// void asd(){
-//     struct Boss asd;
-//     asd.
-// }
+    World world; // Estado de la simulacion (jugador, enemigos, jefe, proyectiles, puntuacion)
+    Saved_Games *saved_games; // Metadatos de cada registro, leidos una vez al iniciar
+    Saved_Games loaded_game;
+    SlotStore slot_store;     // Orden de uso de los registros
+    int save_slots;           // Capacidad del archivo de partidas
+    const char *save_path;    // Archivo de partidas guardadas
+
+    atomic_int running; // Estado de ejecución del juego. Lo consultan todos los hilos
+    int high_score;   // Mejor puntuación alcanzada: la mejor de la tabla o la de la partida en curso
+    int state;        // Estado del juego (0: inicio, 1: jugando, 2: fin del juego, 3: menu de carga)
+    int current_game;
+    int menu_page;    // Pagina actual del menu de carga
+    int menu_pages;   // Paginas del menu de carga
+    int menu_games;   // Partidas mostradas en la pagina actual
+    int menu_slots[MENU_PAGE_MAX]; // Registro de cada partida de la pagina actual
+    int menu_invalid; // 1 si la ultima tecla del menu no elegia ninguna partida
+    int screen_serial; // Se incrementa cuando cambia el contenido de una pantalla estatica
+    int published_state, published_screen; // Ultima pantalla estatica publicada
+    int drawn_state;  // Estado cuya pantalla esta dibujada (-1 obliga a redibujar). Solo la usa quien dibuja
+    int drawn_screen; // screen del ultimo cuadro estatico dibujado
+    char profile_lines[PROF_PHASES + 1][PROFILE_COLS + 1]; // Textos del overlay del perfilador
+    long profile_frames; // Cuadros dibujados con el overlay
+    FrameBuffer frame_buffer; // Cuadros que publica el hilo del juego para el hilo de dibujo
+    Frame frames[FRAME_SLOTS];
+    const char *broadcast_path; // Socket donde se transmite la partida a los espectadores (--broadcast)
+    SpectateServer spectate_server; // Espectadores conectados, lo atiende el hilo de transmision
+    FrameBuffer spectate_buffer;    // Cuadros que publica el hilo del juego para el hilo de transmision
+    Frame spectate_frames[FRAME_SLOTS];
+    GameClock game_clock;   // Reloj de paso fijo del bucle principal
+    InputQueue input_queue; // Teclas pendientes del hilo de entrada al bucle del juego
+
+    pid_t save_child;       // Proceso hijo que esta escribiendo una partida (-1 ninguno)
+    long save_child_start;  // Momento del fork del hijo en curso (ns)
+    int save_pending;       // Registro que se guarda cuando termine el hijo en curso (-1 ninguno)
+    int save_pending_world; // El guardado pendiente incluye el mundo
+    unsigned char *save_world; // Instantanea del mundo del ultimo guardado pedido
+    struct SaveQueue *save_queue; // Hilo de guardado del anfitrion (NULL: se guarda con fork)
+    Saved_Games *save_games; // Metadatos del guardado pendiente, copiados para el hilo de guardado
+    int save_queued;        // La partida esta en la cola del hilo de guardado
+    long autosave_ticks;    // Ticks entre guardados automaticos (0 desactivado)
+    long ticks_since_save;  // Ticks simulados desde el ultimo guardado
+    SaveStats save_stats;   // Costo de los guardados para el hilo del juego
+    Replay recorder;        // Archivo donde se graban las partidas con --record (cerrado si no se graba)
+    unsigned long next_seed; // Semilla de la proxima partida nueva (--seed fija la primera)
+    Leaderboard *leaderboard; // Tabla de puntuaciones (NULL si no se registran las partidas)
+    long last_rank;         // Posicion en la tabla de la ultima partida terminada (0 si no se registro)
+    long runs;              // Partidas de la tabla
+    int top_count;          // Mejores partidas de la tabla que se muestran
+    LeaderboardEntry top[LEADERBOARD_SHOWN];
+    int show_profile;       // 1 si se muestra el overlay del perfilador (tecla 'o')
+    long game_cpu_ns;       // Tiempo de CPU que consumio el hilo del juego
+    long input_cpu_ns;      // Tiempo de CPU que consumio el hilo de entrada
+    long render_cpu_ns;     // Tiempo de CPU que consumio el hilo de dibujo
+    long broadcast_cpu_ns;  // Tiempo de CPU que consumio el hilo de transmision
+} GameState;
+
+// Hilo de guardado del modo anfitrion: las sesiones corren en hilos del pool y un fork desde
+// ahi copiaria el proceso entero con todas las sesiones. Cada sesion deja a lo sumo un
+// guardado pendiente (instantanea y registro, en su GameState) y se encola una sola vez; el
+// hilo lo copia con el mutex y escribe el archivo sin el
+typedef struct SaveQueue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // Hay partidas en la cola o hay que salir
+    pthread_cond_t done;    // Termino un guardado
+    pthread_t thread;
+    GameState **ring;       // Partidas con un guardado pendiente, en orden de llegada
+    int capacity, head, count;
+    int stopping;           // Salir cuando la cola quede vacia
+    GameState *current;     // Partida que se esta escribiendo (NULL ninguna)
+    unsigned char *world;   // Copia de la instantanea que se esta escribiendo
+    Saved_Games *games;     // Copia de los metadatos que se estan escribiendo
+    size_t world_size;
+    int game_slots;
+} SaveQueue;
+
 #pragma endregion
 
 #pragma region VARIABLES_GLOBALES
-// Variables globales
-Position player;                               // Posición del jugador
-Projectile projectiles[MAX_PROJECTILES];       // Array de proyectiles del jugador
-Projectile boss_projectiles[BMAX_PROJECTILES]; // Array de proyectiles del jefe
-Enemy enemies[MAX_ENEMIES];                    // Array de enemigos
-Boss boss;
-Saved_Games saved_games[MAX_SAVED_GAMES];
-Saved_Games loaded_game;
-clock_t start_time;  // Tiempo inicial
-double elapsed_time; // Tiempo transcurrido
-int schedule_fifo_enemy[MAX_ENEMIES];
-
-int running = 1;    // Variable para controlar el estado de ejecución del juego
-int score = 0;      // Puntuación del jugador
-int hp = 3;         // Vida del jugador
-int high_score = 0; // Mejor puntuación alcanzada
-int state = 0;      // Estado del juego (0: inicio, 1: jugando, 2: fin del juego)
-int current_game = -1;
-int enemy_died = 0;
-pthread_mutex_t mutex; // Mutex para sincronizar acceso a recursos compartidos
+// La terminal es una sola por proceso; todo lo demas vive en GameState
+int screen_backend = TERM_NCURSES; // Backend de la terminal, se elige con --term
 
 #pragma endregion 
 
 #pragma region DECLARACIONES_DE_FUNCIONES_PRINCIPALES
 // Funciones del juego
-void init_game();                // Inicializa el juego al iniciar una nueva partida
-void *game_loop(void *arg);      // Bucle principal del juego
+void game_state_init(GameState *g, const char *save_path); // Deja una partida en la pantalla de inicio, sin memoria reservada
+void init_game(GameState *g);    // Inicializa el juego al iniciar una nueva partida
+void *game_loop(void *arg);      // Bucle principal del juego (arg es el GameState)
 void *input_handler(void *arg);  // Manejador de entrada para capturar eventos del usuario
-void move_player(int direction); // Mueve al jugador según la dirección indicada
-void shoot();                    // Dispara un proyectil desde la posición del jugador
-void update_projectiles();       // Actualiza la posición de los proyectiles
-void update_boss_projectiles();
-void update_enemies(); // Actualiza la posición de los enemigos
-void spawn_boss();
-void update_boss();                                                            // Actualiza la posición del jefe
-void check_collisions();                                                       // Verifica colisiones entre proyectiles y enemigos
-void draw_borders();                                                           // Dibuja los bordes de la pantalla
-void draw_ship(int x, int y);                                                  // Dibuja el barco del jugador
-void draw_enemy(int x, int y, int type);                                       // Dibuja un enemigo en la pantalla
-void draw_boss(int x, int y);                                                  // Dibuja el Jefe
-int check_collision(Position pos, Position *parts, int size);                  // Comprueba si hay colisión entre dos objetos
-int check_collision_enemies(Position *ship_parts, Position *parts, int size);  // Comprueba si hay colisión entre el barco y los enemigos
-int check_collision_boss(Position boss_projectile, Position *parts, int size); // Comprueba si hay colisión entre el proyectil del jefe y la nave
-void update_score(int type);                                                   // Actualiza la puntuación basada en el tipo de enemigo derrotado
-void draw_start_screen();                                                      // Dibuja la pantalla de inicio del juego
-void draw_game_over_screen();                                                  // Dibuja la pantalla de fin del juego
-
-void save_game(const char *filename, Saved_Games *game);          // Guarda partida en el estdo actual
-int load_games(const char *filename, Saved_Games *game, int max); // Carga partidas guardadas
-void display_games(Saved_Games saved_games[], int num_games);     // Muestra las partidas guardadas
+void *render_loop(void *arg);    // Hilo de dibujo: dibuja el ultimo cuadro publicado
+void *broadcast_loop(void *arg); // Hilo de transmision: envia el ultimo cuadro publicado a los espectadores
+void step_game(GameState *g, int due); // Simula los ticks vencidos de la partida en curso
+void drain_input(GameState *g);  // Aplica las teclas pendientes de la cola de entrada
+void handle_key(GameState *g, int ch); // Cambia el estado del juego segun una tecla
+int play_key(World *w, int ch);  // Aplica una tecla de movimiento o disparo, devuelve 0 si no es una de ellas
+void end_recording(GameState *g); // Cierra en la grabacion la partida en curso
+void record_loaded_game(GameState *g); // Graba el inicio de una partida cargada con su instantanea
+void record_run(GameState *g);   // Registra en la tabla de puntuaciones la partida que termino
+void refresh_leaderboard(GameState *g); // Trae de la tabla las mejores partidas y la mejor puntuacion
+void init_screen();              // Inicia la terminal con el backend elegido y los pares de colores
+void init_pairs();               // Define los pares de colores del juego en la pantalla del hilo
+int frame_alloc(Frame *f, const World *w); // Reserva las entidades de un cuadro con las capacidades del mundo, -1 si falla
+void frame_free(Frame *f);       // Libera las entidades de un cuadro
+void capture_frame(GameState *g, Frame *f);    // Copia en f lo que hay que dibujar del estado actual
+void publish_frame(GameState *g);              // Publica un cuadro para el hilo de dibujo si cambio algo visible
+void draw_frame(GameState *g, const Frame *f); // Dibuja la pantalla que corresponde al estado del cuadro
+void draw_game(GameState *g, const Frame *f);  // Dibuja un cuadro de la partida en curso
+void draw_profile_overlay(GameState *g);       // Dibuja el tiempo de cada fase del cuadro en el ultimo segundo
+void print_render_stats();       // Reporta las celdas y bytes enviados a la terminal por cuadro
+long thread_cpu_ns();            // Tiempo de CPU consumido por el hilo que llama
+int run_bench(long ticks, int swarm); // Ejecuta ticks de simulacion sin terminal y reporta el rendimiento
+int run_snapshot_bench(long reps);    // Mide cuanto tardan sim_snapshot y sim_restore
+int run_rng_bench(long reps);         // Compara el generador de la simulacion con rand()
+int run_bullet_bench(long ticks);     // Simula al jefe con el guion de miles de proyectiles y mide cada tick
+int run_batch(int argc, char *argv[]); // Juega muchas partidas sin terminal en paralelo y escribe un CSV
+void batch_game(void *ctx, int worker, long game); // Juega una partida del modo batch
+void bot_play(World *w);              // Elige la tecla del bot para el proximo tick
+long load_script(const char *path, ScriptKey **keys); // Lee las teclas de la primera partida de una grabacion
+int run_replay(const char *path, int headless); // Repite una grabacion en tiempo real o sin terminal
+int run_spectate(const char *path, int headless); // Mira la partida que transmite otro proceso del juego
+int run_host(int argc, char *argv[]);  // Muchas sesiones independientes en un proceso, cada una en su pty
+int run_scores(int argc, char *argv[]); // Muestra las mejores partidas de la tabla y la posicion de una puntuacion
+int run_leaderboard_bench(long runs);   // Registra muchas partidas en una tabla temporal y mide las consultas
+void frame_view(const Frame *f, SpectateFrame *v); // Describe un cuadro para el codificador de espectadores
+void draw_borders();             // Dibuja los bordes de la pantalla
+void draw_start_screen(const Frame *f);     // Dibuja la pantalla de inicio del juego
+void draw_game_over_screen(const Frame *f); // Dibuja la pantalla de fin del juego
+
+int save_game(GameState *g, const char *filename, int slot, const Saved_Games *games, const void *world); // Guarda una partida en su registro, -1 si falla
+int rebuild_save_file(GameState *g, const char *filename, const Saved_Games *games); // Recrea el archivo con save_slots registros
+int load_games(GameState *g, const char *filename, Saved_Games *game, int max);  // Carga partidas guardadas
+int load_save_index(GameState *g, const char *filename);                         // Lee una vez los metadatos y arma el indice de registros
+int load_world(GameState *g, const char *filename, int slot);                    // Restaura el mundo guardado en un registro
+size_t save_record_size(GameState *g);                                           // Bytes de un registro: Saved_Games y la instantanea del mundo
+void save_game_async(GameState *g, int slot, int with_world);                    // Guarda una partida desde un proceso hijo o la deja pendiente
+void start_pending_save(GameState *g);                                           // Crea el hijo que escribe el guardado pendiente
+void reap_save_child(GameState *g, int block);                                   // Recoge el hijo de guardado si ya termino y lanza el pendiente
+int save_queue_start(SaveQueue *q, int capacity);                                // Crea el hilo de guardado para capacity partidas, -1 si falla
+void save_queue_stop(SaveQueue *q);                                              // Escribe lo pendiente y termina el hilo de guardado
+void save_queue_push(GameState *g, int slot, int with_world);                    // Deja el guardado de una sesion del anfitrion al hilo de guardado
+void save_queue_wait(GameState *g);                                              // Espera a que se escriba el guardado pendiente de una sesion
+void *save_queue_loop(void *arg);                                                // Hilo de guardado del anfitrion
+void print_save_stats(const SaveStats *stats, const char *stalled);              // Reporta el costo de los guardados
+void load_legacy_games(const char *filename, Saved_Games *game, int max);        // Importa un archivo del formato anterior
+void select_menu_page(GameState *g);                                             // Arma la pagina actual del menu de carga
+void display_games(const Frame *f);                               // Muestra las partidas guardadas
 
 #pragma endregion
 
 #pragma region FUNCION_PRINCIPAL
 // Función principal del programa
-int main()
-{
-    srand(time(NULL)); // Inicializa la semilla para generar números aleatorios
-    initscr();         // Inicia el modo ncurses
-    noecho();          // Desactiva el eco de teclado
-    curs_set(FALSE);   // Oculta el cursor
-    timeout(0);        // Configura getch para ser no bloqueante
-    start_color();     // iniciar color
-
-    // Definir pares de colores
-    init_pair(1, COLOR_BLUE, COLOR_BLACK);
-    init_pair(2, COLOR_MAGENTA, COLOR_BLACK);
-    init_pair(3, COLOR_GREEN, COLOR_BLACK);
-    init_pair(4, COLOR_RED, COLOR_BLACK);
-    init_pair(5, COLOR_YELLOW, COLOR_BLACK);
-
-    pthread_t game_thread, input_thread; // Declara los identificadores de los hilos para el juego y el manejo de entrada
-    pthread_mutex_init(&mutex, NULL);    // Inicializa el mutex para sincronización
-
-    // Crea los hilos para el bucle del juego y el manejo de entrada
-    pthread_create(&game_thread, NULL, game_loop, NULL);
-    pthread_create(&input_thread, NULL, input_handler, NULL);
-
-    // Espera a que ambos hilos terminen antes de continuar
-    pthread_join(game_thread, NULL);
-    pthread_join(input_thread, NULL);
-
-    endwin();                      // Finaliza el modo ncurses
-    pthread_mutex_destroy(&mutex); // Destruye el mutex
-
-    return 0;
-}
-
-// Inicializa el juego, reseteando variables y posicionando al jugador y elementos en sus estados iniciales
-void init_game()
+int main(int argc, char *argv[])
 {
-    player.x = COLS / 2;  // Coloca al jugador en el centro horizontalmente
-    player.y = LINES - 9; // Coloca al jugador cerca del borde inferior
-    score = 0;            // Resetea la puntuación
-    hp = 3;               // Resetea la vida del jugador
-
-    // Inicializa el arreglo de scheduler para la generacion de enemigos
-    enemy_died = MAX_ENEMIES;
-    for (int i = 0; i < MAX_ENEMIES; i++)
+    // Modo benchmark: simula sin terminal ni esperas y reporta ticks por segundo
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
     {
-        schedule_fifo_enemy[i] = i + 1;
+        long ticks = argc >= 3 ? atol(argv[2]) : 0;
+        if (ticks <= 0)
+        {
+            fprintf(stderr, "Usage: %s --bench N [--swarm | --snapshot | --rng | --bullets | --leaderboard]\n", argv[0]);
+            return 1;
+        }
+        if (argc >= 4 && strcmp(argv[3], "--snapshot") == 0)
+        {
+            return run_snapshot_bench(ticks);
+        }
+        if (argc >= 4 && strcmp(argv[3], "--rng") == 0)
+        {
+            return run_rng_bench(ticks);
+        }
+        if (argc >= 4 && strcmp(argv[3], "--bullets") == 0)
+        {
+            return run_bullet_bench(ticks);
+        }
+        if (argc >= 4 && strcmp(argv[3], "--leaderboard") == 0)
+        {
+            return run_leaderboard_bench(ticks);
+        }
+        return run_bench(ticks, argc >= 4 && strcmp(argv[3], "--swarm") == 0);
     }
 
-    // Desactiva todos los proyectiles y enemigos al inicio de una nueva partida
-    for (int i = 0; i < MAX_PROJECTILES; i++)
-    {
-        projectiles[i].is_active = 0;
-    }
-    for (int i = 0; i < MAX_ENEMIES; i++)
+    // Modo batch: muchas partidas sin terminal repartidas entre todos los nucleos
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
     {
-        enemies[i].is_active = 0;
+        return run_batch(argc, argv);
     }
-    for (int i = 0; i < BMAX_PROJECTILES; i++)
+
+    // Modo anfitrion: cientos de partidas en un proceso, cada una en su propia pty
+    if (argc >= 2 && strcmp(argv[1], "--host") == 0)
     {
-        boss_projectiles[i].is_active = 0;
+        return run_host(argc, argv);
     }
-    boss.is_active = 0;
-}
-
-// cargar valores del juego cargado
-void startload_game(Saved_Games saved)
-{
-    player.x = saved.Ship.x;       // Coloca al jugador en el centro horizontalmente
-    player.y = LINES - 9;          // Coloca al jugador cerca del borde inferior
-    score = saved.score;           // Indica la puntuación al valor cargado
-    hp = saved.health_points;      // Indica la vida del jugador al valor cargado
-    high_score = saved.high_score; // Indica la mejor puntuacion al valor cargado
 
-    // Inicializa el arreglo de scheduler para la generacion de enemigos
-    enemy_died = MAX_ENEMIES;
-    for (int i = 0; i < MAX_ENEMIES; i++)
+    // Tabla de puntuaciones: las mejores partidas registradas, sin abrir la terminal
+    if (argc >= 2 && strcmp(argv[1], "--scores") == 0)
     {
-        schedule_fifo_enemy[i] = i + 1;
+        return run_scores(argc, argv);
     }
 
-    // Desactiva todos los proyectiles y enemigos al inicio de una nueva partida
-    for (int i = 0; i < MAX_PROJECTILES; i++)
+    // Backend de la terminal para el juego y la repeticion: --term ansi compone en un buffer
+    // propio y escribe cada cuadro con un solo write() de secuencias ANSI
+    for (int i = 1; i + 1 < argc; i++)
     {
-        projectiles[i].is_active = 0;
+        if (strcmp(argv[i], "--term") == 0)
+        {
+            screen_backend = strcmp(argv[i + 1], "ansi") == 0 ? TERM_ANSI : TERM_NCURSES;
+        }
     }
-    for (int i = 0; i < MAX_ENEMIES; i++)
+
+    // Modo espectador: se conecta al socket de un juego lanzado con --broadcast y lo dibuja
+    if (argc >= 2 && strcmp(argv[1], "--spectate") == 0)
     {
-        enemies[i].is_active = 0;
+        int headless = argc >= 3 && strcmp(argv[argc - 1], "--headless") == 0;
+        const char *path = argc >= 3 && strncmp(argv[2], "--", 2) != 0 ? argv[2] : SPECTATE_DEFAULT_PATH;
+        return run_spectate(path, headless);
     }
-    for (int i = 0; i < 5; i++)
+
+    // Modo repeticion: reproduce las partidas de una grabacion hecha con --record
+    if (argc >= 2 && strcmp(argv[1], "--replay") == 0)
     {
-        boss_projectiles[i].is_active = 0;
+        if (argc < 3)
+        {
+            fprintf(stderr, "Usage: %s --replay FILE [--headless] [--term ncurses|ansi]\n", argv[0]);
+            return 1;
+        }
+        return run_replay(argv[2], argc >= 4 && strcmp(argv[3], "--headless") == 0);
     }
-}
-
-#pragma endregion
-
-#pragma region BUCLE_PRINCIPAL
-// Bucle principal del juego, controla el estado del juego y actualiza la pantalla según el estado actual
-void *game_loop(void *arg)
-{
-    int move_enemy = 0; // controla el mover de los enemigos
-    int clock_flag = 0; // controla el inicio del reloj
 
-    // Main loop
-    while (running)
+    GameState game;
+    GameState *g = &game;
+    game_state_init(g, "saved_games.dat");
+    g->next_seed = time(NULL); // Semilla de la primera partida, se puede fijar con --seed
+    const char *record_path = NULL;
+    const char *trace_path = "trace.json"; // Traza de Chrome que se escribe al salir
+    for (int i = 1; i + 1 < argc; i += 2)
     {
-        pthread_mutex_lock(&mutex); // Bloquea mutex para acceso seeguro a las variables
-        // Dependiendo del estado, muestra la pantalla de inicio, actualiza el juego o la pantalla de fin de juego
-        if (state == 0)
+        if (strcmp(argv[i], "--autosave") == 0)
         {
-            draw_start_screen();
+            g->autosave_ticks = atol(argv[i + 1]) * 1000000L / DELAY; // Guardado automatico cada N segundos de juego
         }
-        else if (state == 1)
+        else if (strcmp(argv[i], "--slots") == 0 && atoi(argv[i + 1]) > 0)
         {
-
-            update_projectiles();      // Actualiza proyectiles
-            update_boss_projectiles(); // Actualiza los proyectiles del jefe
-
-            // Actualiza enemigos si es necesario
-            if (!move_enemy)
-            {
-                update_enemies();
-            }
-
-            check_collisions(); // verifica las colisiones
-
-            // Verificar si hay que actualizar la puntuacion mas alta
-            if (hp <= 0)
-            {
-                state = 2;
-                if (score > high_score)
-                {
-                    high_score = score;
-                }
-            }
-            if (score > high_score)
-            {
-                high_score = score;
-            }
-
-            clear();        // Limpia la pantalla antes de dibujar
-            draw_borders(); // Dibuja los bordes
-
-            if (boss.is_active)
-            {
-                update_boss();
-                draw_boss(boss.pos.y, boss.pos.x);
-            }
-
-            if (!clock_flag)
-            { // Echamos a andar el timer
-                clock_flag = 1;
-                start_time = clock();
-            }
-            elapsed_time = (double)(clock() - start_time) / CLOCKS_PER_SEC; // Calcular el tiempo transcurrido
-
-            if (elapsed_time >= BOSS_TIME && !boss.is_active)
-            {
-                spawn_boss();
-            }
-
-            draw_ship(player.x, player.y); // Dibuja al jugador
-
-            // Imprimir
-            mvprintw(1, 2, "HP: %d", hp);
-            mvprintw(1, 10, "Score: %d", score);
-            mvprintw(1, 20, "High Score: %d", high_score);
-            if (boss.is_active)
-            {
-                mvprintw(1, 40, "Boss HP %d", boss.hp);
-            }
-            for (int i = 0; i < MAX_PROJECTILES; i++)
-            {
-                if (projectiles[i].is_active)
-                {
-                    mvprintw(projectiles[i].pos.y, projectiles[i].pos.x, "|");
-                }
-            }
-            for (int i = 0; i < MAX_ENEMIES; i++)
-            {
-                if (enemies[i].is_active)
-                {
-                    draw_enemy(enemies[i].pos.x, enemies[i].pos.y, enemies[i].type);
-                }
-            }
-            for (int i = 0; i < BMAX_PROJECTILES; i++)
-            {
-                if (boss_projectiles[i].is_active)
-                {
-                    mvprintw(boss_projectiles[i].pos.x, boss_projectiles[i].pos.y, "U");
-                }
-            }
-            refresh(); // Actualiza la pantalla con los cambios
+            g->save_slots = atoi(argv[i + 1]); // Cantidad de partidas guardadas antes de desalojar la menos usada
         }
-        else if (state == 2)
+        else if (strcmp(argv[i], "--seed") == 0)
         {
-            draw_game_over_screen();
+            g->next_seed = strtoul(argv[i + 1], NULL, 10);
         }
-
-        pthread_mutex_unlock(&mutex); // Desbloquea el mutex
-
-        usleep(DELAY);                                     // espera el proximo ciclo
-        move_enemy = (move_enemy + 1) % SPEED_LOW_ENEMIES; // Controla la velocidad de los enemigos
-    }
-    return NULL;
-}
-
-#pragma endregion
-
-#pragma region MANEJO_ENTRADA
-// Maneja la entrada del usuario para controlar el juego
-void *input_handler(void *arg)
-{
-    int ch;
-    while (running)
-    {
-        ch = getch();               // obtiene la entrada del usuario
-        pthread_mutex_lock(&mutex); // Bloquea el mutex
-
-        // Cambia el estado del juego segun la entrada
-        if (state == 0)
+        else if (strcmp(argv[i], "--record") == 0)
         {
-            if (ch == 'n')
-            {
-                state = 1;
-                current_game = -1;
-                init_game();
-            }
-            else if (ch == 'q')
-            {
-                running = 0;
-            }
-            else if (ch == 'l')
-            {
-                state = 1;
-                // Cargar todos los juegos desde el archivo
-                int num_games = load_games("saved_games.dat", saved_games, MAX_SAVED_GAMES);
-
-                // Mostrar los juegos cargados
-                display_games(saved_games, num_games);
-
-                // Esperar a que el usuario ingrese un número para seleccionar un juego
-                int choice;
-                do
-                {
-                    mvprintw(LINES - 2, 2, "Select a game to load (1 to %d): ", num_games);
-                    choice = getch();
-
-                    if (choice == 'q')
-                    {
-                        state = 0;
-                        break;
-                    }
-
-                    choice -= '0';
-
-                    if (choice < 1 || choice > num_games)
-                    {
-                        mvprintw(LINES - 1, 2, "Invalid selection. Please try again.");
-                        refresh();
-                        usleep(DELAY); // Espera un poco antes de volver a pedir la entrada
-                    }
-                } while (choice < 1 || choice > num_games);
-
-                if (state == 0)
-                {
-                    continue;
-                }
-
-                // Guardar que juego se va a cargar
-                current_game = choice - 1;
-
-                for (int i = 0; i < MAX_SAVED_GAMES; i++)
-                {
-                    if (saved_games[i].lru > saved_games[current_game].lru)
-                    {
-                        saved_games[i].lru--;
-                    }
-                }
-
-                // Cargar el juego seleccionado
-                saved_games[current_game].lru = num_games;
-                loaded_game = saved_games[current_game];
-
-                // Sobreescribir las partidas guardadas del juego en un archivo
-                save_game("saved_games.dat", saved_games);
-
-                startload_game(loaded_game);
-                state = 1; // Regresar al estado de juego después de cargar un juego
-            }
+            record_path = argv[i + 1]; // Graba las teclas de cada partida para repetirla con --replay
         }
-        else if (state == 1)
+        else if (strcmp(argv[i], "--trace") == 0)
         {
-            switch (ch)
-            {
-            case 'a':
-            case KEY_LEFT:
-                move_player(KEY_LEFT);
-                break;
-            case 'd':
-            case KEY_RIGHT:
-                move_player(KEY_RIGHT);
-                break;
-            case ' ':
-                shoot();
-                break;
-            case 'q':
-                state = 0;
-                break;
-            case 's':
-                // Cargar todos los juegos desde el archivo
-                int num_games = load_games("saved_games.dat", saved_games, 3);
-                num_games = min(num_games, MAX_SAVED_GAMES - 1);
-
-                Saved_Games game = {high_score,
-                                    score,
-                                    {player.x, player.y},
-                                    num_games + 1,
-                                    hp};
-
-                if (current_game == -1)
-                {
-                    int saved_game_successfull = 0, old_game_index = -1;
-
-                    for (int i = 0; i < MAX_SAVED_GAMES; i++)
-                    {
-                        if (saved_games[i].lru == 0)
-                        {
-                            saved_games[i] = game;
-                            saved_game_successfull = 1;
-                            break;
-                        }
-                        if (saved_games[i].lru == 1)
-                        {
-                            old_game_index = i;
-                        }
-                    }
-
-                    if (!saved_game_successfull)
-                    {
-                        for (int i = 0; i < MAX_SAVED_GAMES; i++)
-                        {
-                            saved_games[i].lru--;
-                        }
-
-                        saved_games[old_game_index] = game;
-                    }
-                }
-                else
-                {
-                    for (int i = 0; i < MAX_SAVED_GAMES; i++)
-                    {
-                        if (saved_games[i].lru > saved_games[current_game].lru)
-                        {
-                            saved_games[i].lru--;
-                        }
-                    }
-
-                    saved_games[current_game] = game;
-                }
-
-                // Guardar el juego en un archivo
-                save_game("saved_games.dat", saved_games);
-                break;
-            }
+            trace_path = argv[i + 1];
         }
-        else if (state == 2)
+        else if (strcmp(argv[i], "--broadcast") == 0)
         {
-            if (ch == 'r')
-            {
-                state = 0;
-            }
-            else if (ch == 'q')
-            {
-                running = 0;
-            }
+            g->broadcast_path = argv[i + 1]; // Otros procesos pueden mirar la partida con --spectate
         }
+    }
 
-        pthread_mutex_unlock(&mutex); // Desblqouea el mutex
+    if (record_path != NULL && replay_open_write(&g->recorder, record_path) != 0)
+    {
+        perror(record_path);
+        return 1;
     }
-    return NULL;
-}
 
-#pragma endregion
+    init_screen();
 
-#pragma region FUNCIONES_DE_ACTUALIZACION
-// Mueve al jugador según la dirección ingresada por el usuario
-void move_player(int direction)
-{
-    if (direction == KEY_LEFT && player.x > 2)
+    if (sim_create(&g->world, MAX_ENEMIES, MAX_PROJECTILES) != 0)
     {
-        player.x--;
+        term_close();
+        fprintf(stderr, "Not enough memory for the game world\n");
+        return 1;
     }
-    else if (direction == KEY_RIGHT && player.x < COLS - 3)
+
+    // El tamaño de los registros depende del mundo, por eso el indice se lee despues de sim_create
+    if (load_save_index(g, g->save_path) != 0)
     {
-        player.x++;
+        term_close();
+        fprintf(stderr, "Not enough memory for the saved games\n");
+        return 1;
     }
-}
 
-// Dispara un proyectil desde la posicion del jugador
-void shoot()
-{
-    for (int i = 0; i < MAX_PROJECTILES; i++)
+    // Sin tabla de puntuaciones se juega igual, solo que las partidas no se registran
+    Leaderboard leaderboard;
+    if (leaderboard_open(&leaderboard, LEADERBOARD_NAME) == 0)
     {
-        if (!projectiles[i].is_active)
-        {
-            projectiles[i].pos.x = player.x;
-            projectiles[i].pos.y = player.y - 1;
-            projectiles[i].is_active = 1;
-            break;
-        }
+        g->leaderboard = &leaderboard;
+        refresh_leaderboard(g);
     }
-}
 
-// Actualiza las posiciones de los proyectiles activos
-void update_projectiles()
-{
-    for (int i = 0; i < MAX_PROJECTILES; i++)
+    for (int i = 0; i < FRAME_SLOTS; i++)
     {
-        if (projectiles[i].is_active)
-        { // Mueve el proyectil hacia arriba y lo desactiva si sale de pantalla
-            projectiles[i].pos.y--;
-            if (projectiles[i].pos.y < 3)
-            {
-                projectiles[i].is_active = 0;
-            }
+        if (frame_alloc(&g->frames[i], &g->world) != 0)
+        {
+            term_close();
+            fprintf(stderr, "Not enough memory for the frame buffers\n");
+            return 1;
         }
     }
-}
 
-// Actualiza las posiciones y estados de los enemigos
-void update_enemies()
-{
-    for (int i = 0; i < MAX_ENEMIES; i++)
+    // Los espectadores reciben sus propios cuadros: el hilo de transmision no comparte los del dibujo
+    if (g->broadcast_path != NULL)
     {
-        if (enemies[i].is_active)
+        int capacity[SPECTATE_CLASSES] = {g->world.projectiles.capacity, g->world.enemies.capacity,
+                                          g->world.boss_projectiles.capacity};
+        for (int i = 0; i < FRAME_SLOTS; i++)
         {
-            enemies[i].pos.y++;
-            if (enemies[i].pos.y >= LINES - 3)
+            if (frame_alloc(&g->spectate_frames[i], &g->world) != 0)
             {
-                enemies[i].is_active = 0;
-                schedule_fifo_enemy[i] = enemy_died + 1;
-                enemy_died++;
+                term_close();
+                fprintf(stderr, "Not enough memory for the frame buffers\n");
+                return 1;
             }
         }
+        if (spectate_server_open(&g->spectate_server, g->broadcast_path, capacity) != 0)
+        {
+            term_close();
+            perror(g->broadcast_path);
+            return 1;
+        }
     }
-    
-    int lenght_cicle = enemy_died;
 
-    mvprintw(LINES - 2, 2, "(%d): ", enemy_died);
-    for (int i = 0; i < MAX_ENEMIES; i++)
+    pthread_t game_thread, input_thread, render_thread, broadcast_thread; // Identificadores de los hilos
+    input_queue_init(&g->input_queue);      // Cola de teclas entre el hilo de entrada y el del juego
+    frame_buffer_init(&g->frame_buffer);    // Cuadros entre el hilo del juego y el de dibujo
+    frame_buffer_init(&g->spectate_buffer); // Cuadros entre el hilo del juego y el de transmision
+    prof_enabled = 1;                       // El juego interactivo siempre mide sus fases
+
+    // Crea los hilos para el bucle del juego, el dibujo y el manejo de entrada
+    pthread_create(&game_thread, NULL, game_loop, g);
+    pthread_create(&render_thread, NULL, render_loop, g);
+    pthread_create(&input_thread, NULL, input_handler, g);
+    if (g->broadcast_path != NULL)
     {
-        mvprintw(LINES - 2, 2 * (i + 1), "%d ", schedule_fifo_enemy[i]);
+        pthread_create(&broadcast_thread, NULL, broadcast_loop, g);
     }
-    
 
-    for (int i = 0; i < lenght_cicle; i++)
+    // Espera a que los hilos terminen antes de continuar. Los de entrada y dibujo pueden
+    // estar dormidos esperando una tecla o un cuadro: se los despierta cuando el juego ya termino
+    long started = input_now_ns();
+    pthread_join(game_thread, NULL);
+    input_wake(&g->input_queue);
+    frame_buffer_wake(&g->frame_buffer);
+    pthread_join(input_thread, NULL);
+    pthread_join(render_thread, NULL);
+    if (g->broadcast_path != NULL)
     {
-        if (enemy_died >= 1 && rand() % 100 < 5)
-        {
-            for (int i = 0; i < MAX_ENEMIES; i++)
-            {
-                if(schedule_fifo_enemy[i] == 1)
-                {
-                    enemies[i].pos.x = 2 + rand() % (COLS - 4);
-                    enemies[i].pos.y = 3;
-                    enemies[i].is_active = 1;
-                    enemies[i].type = rand() % 3; // 3 tipos de enemigos
-                }
-
-                if(schedule_fifo_enemy[i] >= 1)
-                {
-                    schedule_fifo_enemy[i]--;
-                }
-            }
+        frame_buffer_wake(&g->spectate_buffer);
+        pthread_join(broadcast_thread, NULL);
+    }
+    long wall_ns = input_now_ns() - started;
+    reap_save_child(g, 1); // No se sale con un guardado a medias
+
+    term_close(); // Restaura la terminal
+
+    print_render_stats();
+    render_free();
+    printf("shots dropped (projectile pool full): %ld\n", g->world.projectiles.exhausted);
+    sim_destroy(&g->world);
+    game_clock_print_stats(&g->game_clock);
+    printf("input: %ld events, max queue depth %ld, dropped %ld, avg latency %.2f ms\n",
+           g->input_queue.popped, g->input_queue.max_depth, atomic_load(&g->input_queue.dropped),
+           g->input_queue.popped ? g->input_queue.latency_ns / 1e6 / g->input_queue.popped : 0.0);
+    printf("pipeline: %ld frames published, %ld drawn, %ld replaced before being drawn\n", g->frame_buffer.published,
+           g->frame_buffer.consumed, g->frame_buffer.published - g->frame_buffer.consumed);
+    printf("cpu: game thread %.1f ms, render thread %.1f ms, input thread %.1f ms (%ld wakeups) in %.1f s\n",
+           g->game_cpu_ns / 1e6, g->render_cpu_ns / 1e6, g->input_cpu_ns / 1e6, g->input_queue.wakeups, wall_ns / 1e9);
+    if (g->broadcast_path != NULL)
+    {
+        SpectateServer *ss = &g->spectate_server;
+        printf("broadcast: %ld spectators, %ld frames, %.1f bytes/delta, %ld keyframes, %ld resyncs, %ld bytes "
+               "sent, %.1f ms cpu\n",
+               ss->accepted, ss->frames, ss->frames ? (double)ss->delta_bytes / ss->frames : 0.0, ss->keyframes,
+               ss->resyncs, ss->sent_bytes, g->broadcast_cpu_ns / 1e6);
+        spectate_server_close(ss);
+    }
+    input_queue_free(&g->input_queue);
+    frame_buffer_free(&g->frame_buffer);
+    frame_buffer_free(&g->spectate_buffer);
+    for (int i = 0; i < FRAME_SLOTS; i++)
+    {
+        frame_free(&g->frames[i]);
+        frame_free(&g->spectate_frames[i]);
+    }
+    print_save_stats(&g->save_stats, "game thread");
+    if (g->leaderboard != NULL)
+    {
+        printf("leaderboard: %ld runs, %ld read from the log at startup, %ld compactions\n", g->runs,
+               leaderboard.loaded, leaderboard.compactions);
+        leaderboard_close(&leaderboard);
+    }
+    if (prof_export_chrome(trace_path) == 0)
+    {
+        printf("trace: %s (open in chrome://tracing or ui.perfetto.dev)\n", trace_path);
+    }
+    prof_free();
+    if (g->recorder.writing)
+    {
+        printf("recorded: %ld records to %s\n", g->recorder.records, record_path);
+    }
+    replay_close(&g->recorder);
+    slot_store_free(&g->slot_store);
+    free(g->saved_games);
+    free(g->save_world);
+    free(g->save_games);
 
-            enemy_died--;
-        }
+    return 0;
+}
+
+// Inicia la terminal sin eco ni cursor, con lectura de teclas no bloqueante y los colores del juego.
+// Si el backend ANSI no se puede usar (la salida no es una terminal) se vuelve a ncurses
+void init_screen()
+{
+    if (term_open(screen_backend) != 0)
+    {
+        screen_backend = TERM_NCURSES;
+        term_open(screen_backend);
     }
+    init_pairs();
 }
 
-/* Boss Section*/
-void spawn_boss()
+// Definir pares de colores
+void init_pairs()
 {
-    boss.is_active = 1;
-    boss.is_arriving = 1;
-    boss.direction = rand() % 2;
-    boss.hp = 5;
-    boss.pos.x = 6;
-    boss.pos.y = COLS / 2;
-    start_time = clock();
-    draw_boss(boss.pos.x, boss.pos.y);
+    term_init_pair(1, COLOR_BLUE, COLOR_BLACK);
+    term_init_pair(2, COLOR_MAGENTA, COLOR_BLACK);
+    term_init_pair(3, COLOR_GREEN, COLOR_BLACK);
+    term_init_pair(4, COLOR_RED, COLOR_BLACK);
+    term_init_pair(5, COLOR_YELLOW, COLOR_BLACK);
 }
 
-void draw_boss(int x, int y)
+void game_state_init(GameState *g, const char *save_path)
 {
-    // Disenno del boss
-    /*
-     /\^/\
-    ( o o )
-     \ v /
-     /-"-\
-    */
-    // Dibujar la nave con colores
+    memset(g, 0, sizeof(*g));
+    g->save_slots = DEFAULT_SAVE_SLOTS;
+    g->save_path = save_path;
+    g->running = 1;
+    g->current_game = -1;
+    g->menu_pages = 1;
+    g->published_state = g->published_screen = -1;
+    g->drawn_state = g->drawn_screen = -1;
+    g->save_child = -1;
+    g->save_pending = -1;
+}
 
-    attron(COLOR_PAIR(1)); // Aplicar color azul
-    mvprintw(y - 3, x, "/\\^/\\");
-    attroff(COLOR_PAIR(1)); // Desactivar color azul
+// Inicializa el juego, reseteando variables y posicionando al jugador y elementos en sus estados iniciales.
+// Cada partida nueva se siembra con su propia semilla, que es lo que guarda la grabacion
+void init_game(GameState *g)
+{
+    unsigned long seed = g->next_seed++;
+    sim_seed(&g->world, seed);
+    sim_init(&g->world, term_rows(), term_cols());
+    replay_new_game(&g->recorder, g->world.tick, seed, g->world.rows, g->world.cols);
+}
 
-    attron(COLOR_PAIR(2)); // Aplicar color magenta
-    mvprintw(y - 2, x - 1, "( o o )");
-    mvprintw(y - 1, x, "\\ v /");
-    attroff(COLOR_PAIR(2)); // Desactivar color magenta
+// cargar valores del juego cargado. Si la partida tiene una instantanea del mundo tomada en
+// una terminal del mismo tamaño se restaura completa; si no, solo la nave, puntos y vida.
+// La mejor puntuacion no cambia: es la de la tabla, no la que se guardo con la partida
+void startload_game(GameState *g, Saved_Games saved)
+{
+    if (load_world(g, g->save_path, g->current_game) == 0)
+    {
+        return;
+    }
 
-    attron(COLOR_PAIR(1)); // Aplicar color azul
-    mvprintw(y, x, "/-\"-\\ ");
-    // mvprintw(y, x, "A");
-    attroff(COLOR_PAIR(1)); // Desactivar color azul
+    sim_init(&g->world, term_rows(), term_cols());
+    g->world.player.x = saved.Ship.x;  // Coloca al jugador en la posicion guardada
+    g->world.score = saved.score;      // Indica la puntuación al valor cargado
+    g->world.hp = saved.health_points; // Indica la vida del jugador al valor cargado
+}
 
-    // // Actualizar la pantalla para mostrar cambios
-    // refresh();
+#pragma endregion
 
-    // // Esperar entrada del usuario para salir
-    // getch();
+#pragma region BUCLE_PRINCIPAL
+// Bucle principal del juego, controla el estado del juego y publica lo que hay que mostrar segun el estado
+// actual. Avanza con un reloj de paso fijo: si un cuadro se atrasa, simula los ticks vencidos antes de
+// publicar. No escribe en la terminal: el hilo de dibujo envia el cuadro N mientras aqui se simula el N+1
+void *game_loop(void *arg)
+{
+    GameState *g = arg;
+    game_clock_init(&g->game_clock, DELAY * 1000L, MAX_CATCHUP_TICKS);
+    prof_thread_init("game");
 
-    // // Finalizar ncurses
-    // endwin();
+    // Main loop
+    while (g->running)
+    {
+        long t = prof_begin();
+        int due = game_clock_wait(&g->game_clock); // Espera el deadline del proximo tick
+        prof_end(PROF_WAIT, t);
+        long frame = prof_begin();
+
+        t = prof_begin();
+        drain_input(g);                // Aplica las teclas recibidas desde el cuadro anterior
+        prof_end(PROF_INPUT, t);
+        step_game(g, due);
+
+        t = prof_begin();
+        publish_frame(g); // El hilo de dibujo toma el cuadro sin esperar a este hilo
+        prof_end(PROF_PUBLISH, t);
+        prof_end(PROF_FRAME, frame);
+    }
+    g->game_cpu_ns = thread_cpu_ns();
+    return NULL;
 }
 
-void update_boss()
+// Un paso del bucle despues de aplicar las teclas. Solo la partida avanza con el reloj; las
+// pantallas de inicio, fin y carga cambian con las teclas
+void step_game(GameState *g, int due)
 {
-    if (boss.is_active)
+    reap_save_child(g, 0); // Recoge sin esperar un guardado que haya terminado
+    if (g->state != 1)
     {
-        if(boss.is_arriving)
+        return;
+    }
+    for (int t = 0; t < due && g->state == 1; t++)
+    {
+        sim_tick(&g->world); // Actualiza proyectiles, enemigos, jefe y colisiones
+
+        // Verificar si hay que actualizar la puntuacion mas alta
+        if (g->world.hp <= 0)
         {
-            if(boss.pos.x == LINES/2 - 4)
-            {
-                boss.is_arriving = 0;
-            }
-            boss.pos.x++;
+            end_recording(g);
+            record_run(g);
+            g->state = 2;
         }
-        else
+        if (g->world.score > g->high_score)
         {
-            if (boss.pos.y == 6 || boss.pos.y == COLS - 10)
-            {
-                boss.direction = (boss.direction + 1) % 2;
-            }
-            boss.pos.y = boss.direction == 0 ? boss.pos.y - 1 : boss.pos.y + 1;
+            g->high_score = g->world.score;
         }
+        g->ticks_since_save++;
+    }
+
+    // El guardado automatico hace lo mismo que la tecla 's'
+    if (g->state == 1 && g->autosave_ticks > 0 && g->ticks_since_save >= g->autosave_ticks)
+    {
+        g->save_stats.autosaves++;
+        handle_key(g, 's');
     }
 }
 
-void update_boss_projectiles()
+// Hilo de dibujo: es el unico que escribe en la terminal. Duerme hasta que el hilo del juego
+// publica un cuadro y dibuja siempre el mas reciente sin esperar al juego, asi que lo que tarda
+// la escritura en la terminal no retrasa el proximo tick. Si se atrasa, los cuadros
+// intermedios se descartan en lugar de encolarse
+void *render_loop(void *arg)
 {
-    for (int i = 0; i < BMAX_PROJECTILES; i++)
+    GameState *g = arg;
+    prof_thread_init("render");
+    while (g->running)
     {
-        if (boss_projectiles[i].is_active)
+        int slot = frame_buffer_wait(&g->frame_buffer);
+        if (slot != -1)
         {
-            if (boss_projectiles[i].pos.x == LINES - 2)
-            {
-                boss_projectiles[i].is_active = 0;
-                continue;
-            }
-            boss_projectiles[i].pos.x += 1;
+            draw_frame(g, &g->frames[slot]);
         }
-        else
+    }
+    g->render_cpu_ns = thread_cpu_ns();
+    return NULL;
+}
+
+// Hilo de transmision: igual que el de dibujo toma siempre el ultimo cuadro publicado, asi
+// que el hilo del juego paga una copia por tick sin importar cuantos espectadores haya. La
+// codificacion y los envios a cada espectador corren aqui
+void *broadcast_loop(void *arg)
+{
+    GameState *g = arg;
+    SpectateFrame view;
+    prof_thread_init("broadcast");
+    while (g->running)
+    {
+        int slot = spectate_server_wait(&g->spectate_server, &g->spectate_buffer);
+        if (slot != -1)
         {
-            if (boss.is_active && !boss.is_arriving)
-            {
-                boss_projectiles[i].is_active = 1;
-                boss_projectiles[i].pos.x = boss.pos.x + 1;
-                boss_projectiles[i].pos.y = boss.pos.y + 2;
-            }
+            long t = prof_begin();
+            frame_view(&g->spectate_frames[slot], &view);
+            spectate_server_send(&g->spectate_server, &view);
+            prof_end(PROF_BROADCAST, t);
         }
     }
+    g->broadcast_cpu_ns = thread_cpu_ns();
+    return NULL;
 }
 
 #pragma endregion
 
-#pragma region FUNCIONES_CHECK_COLISIONES
-// Verifica colisiones entre proyectiles y enemigos, y entre el jugador y enemigos
-void check_collisions()
+#pragma region MODO_BENCHMARK
+// Ejecuta la simulacion sin ncurses ni usleep durante la cantidad de ticks indicada.
+// Un piloto automatico dispara en cada tick y barre la pantalla para generar colisiones;
+// cuando la nave muere se reinicia la partida para mantener la carga constante.
+// Con swarm se usa un tablero grande con SWARM_ENEMIES enemigos, se disparan SWARM_SHOTS
+// proyectiles por tick desde el fondo y la nave no muere, para medir las columnas llenas.
+// Los enemigos del enjambre entran todos juntos en una oleada en el tick 0
+int run_bench(long ticks, int swarm)
 {
-    Position ship_parts[] = {// Define las partes del jugador para colisiones
-                             {player.x, player.y},
-                             {player.x - 1, player.y + 1},
-                             {player.x - 1, player.y - 1},
-                             {player.x - 2, player.y - 2},
-                             {player.x - 2, player.y + 2}};
+    World bench_world;
+    struct timespec begin, end;
+    long games = 1, live_enemies = 0, live_projectiles = 0, samples = 0;
+    int direction = DIR_RIGHT;
+    int rows = swarm ? SWARM_ROWS : BENCH_ROWS;
+    int cols = swarm ? SWARM_COLS : BENCH_COLS;
+
+    if (sim_create(&bench_world, swarm ? SWARM_ENEMIES : MAX_ENEMIES,
+                   swarm ? SWARM_PROJECTILES : MAX_PROJECTILES) != 0)
+    {
+        fprintf(stderr, "Not enough memory for the benchmark world\n");
+        return 1;
+    }
+
+    sim_seed(&bench_world, 12345); // Semilla fija para que las corridas sean comparables
+    sim_init(&bench_world, rows, cols);
+    if (swarm)
+    {
+        schedule_wave(&bench_world, 0, SWARM_ENEMIES); // El enjambre arranca con todos los enemigos en juego
+    }
 
-    for (int i = 0; i < MAX_PROJECTILES; i++)
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (long t = 0; t < ticks; t++)
     {
-        if (projectiles[i].is_active)
+        if (bench_world.player.x <= 2 || bench_world.player.x >= bench_world.cols - 3)
         {
-            // Comprueba cada proyectil del jugador contra todos los enemigos incluyendo al jefe
-            for (int j = 0; j < MAX_ENEMIES; j++)
+            direction = -direction;
+        }
+        move_player(&bench_world, direction);
+        shoot(&bench_world);
+        if (swarm)
+        {
+            for (int s = 0; s < SWARM_SHOTS; s++)
             {
-                if (enemies[j].is_active)
-                {
-                    Position enemy_parts[] = {
-                        {enemies[j].pos.x, enemies[j].pos.y},
-                        {enemies[j].pos.x - 1, enemies[j].pos.y + 1},
-                        {enemies[j].pos.x + 1, enemies[j].pos.y + 1},
-                        {enemies[j].pos.x - 2, enemies[j].pos.y + 2},
-                        {enemies[j].pos.x + 2, enemies[j].pos.y + 2}};
-
-                    if (check_collision(projectiles[i].pos, enemy_parts, 5))
-                    {
-                        // Comprueba colision entre jugador y enemigos
-                        projectiles[i].is_active = 0;
-                        update_score(enemies[j].type); // Suma puntos por tipo de enemigo derrotado
-                        enemies[j].is_active = 0;         // Desactiva el enemigo golpeado
-                        break;
-                    }
-                }
+                spawn_projectile(&bench_world, 2 + (t * 7919 + s * 104729) % (cols - 4), rows - 3);
             }
+            bench_world.hp = 3;
+        }
 
-            if (boss.is_active)
-            {
-                Position boss_parts[] = {
-                    {boss.pos.y + 5, boss.pos.x},
-                    {boss.pos.y + 4, boss.pos.x},
-                    {boss.pos.y + 3, boss.pos.x},
-                    {boss.pos.y + 2, boss.pos.x},
-                    {boss.pos.y + 1, boss.pos.x},
-                    {boss.pos.y, boss.pos.x},
-                };
-
-                if (check_collision(projectiles[i].pos, boss_parts, 6))
-                {
-                    boss.hp--;
-                    projectiles[i].is_active = 0;
-                    if (boss.hp == 0)
-                    {
-                        update_score(3);
-                        boss.is_active = 0;
-                        start_time = clock();
-                    }
-                }
-            }
+        sim_tick(&bench_world);
+
+        if (bench_world.hp <= 0)
+        {
+            sim_init(&bench_world, rows, cols);
+            games++;
         }
-    }
 
-    for (int i = 0; i < BMAX_PROJECTILES; i++)
-    {
-        if (check_collision_boss(boss_projectiles[i].pos, ship_parts, 5))
+        // Cada 64 ticks cuenta las entidades vivas para reportar la carga media
+        if ((t & 63) == 0)
         {
-            boss_projectiles[i].is_active = 0;
-            hp--;
+            live_enemies += bench_world.enemies.count;
+            live_projectiles += bench_world.projectiles.count;
+            samples++;
         }
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("ticks: %ld\n", ticks);
+    printf("games: %ld\n", games);
+    printf("live enemies/tick: %.1f\n", (double)live_enemies / samples);
+    printf("live projectiles/tick: %.1f\n", (double)live_projectiles / samples);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("ticks/sec: %.0f\n", ticks / seconds);
+    printf("ns/tick: %.1f\n", seconds * 1e9 / ticks);
+    printf("frame budget used: %.2f%%\n", seconds * 1e9 / ticks / (DELAY * 1000.0) * 100);
+    printf("projectile pool exhausted: %ld\n", bench_world.projectiles.exhausted);
+
+    sim_destroy(&bench_world);
+    return 0;
+}
 
-    for (int i = 0; i < MAX_ENEMIES; i++)
+// Toma y restaura reps instantaneas de un mundo con la capacidad del juego y de uno con la
+// del enjambre, despues de simular un rato para que tengan entidades vivas. Tambien
+// comprueba que el mundo restaurado sigue exactamente igual que el original
+int run_snapshot_bench(long reps)
+{
+    for (int swarm = 0; swarm <= 1; swarm++)
     {
-        if (enemies[i].is_active)
+        World a, b;
+        struct timespec t0, t1, t2;
+        int rows = swarm ? SWARM_ROWS : BENCH_ROWS, cols = swarm ? SWARM_COLS : BENCH_COLS;
+        int max_enemies = swarm ? SWARM_ENEMIES : MAX_ENEMIES;
+        int max_projectiles = swarm ? SWARM_PROJECTILES : MAX_PROJECTILES;
+
+        if (sim_create(&a, max_enemies, max_projectiles) != 0 || sim_create(&b, max_enemies, max_projectiles) != 0)
+        {
+            fprintf(stderr, "Not enough memory for the benchmark world\n");
+            return 1;
+        }
+        sim_seed(&a, 12345);
+        sim_init(&a, rows, cols);
+        if (swarm)
         {
-            Position enemy_parts[] = {
-                {enemies[i].pos.x, enemies[i].pos.y},
-                {enemies[i].pos.x - 1, enemies[i].pos.y + 1},
-                {enemies[i].pos.x + 1, enemies[i].pos.y + 1},
-                {enemies[i].pos.x - 2, enemies[i].pos.y + 2},
-                {enemies[i].pos.x + 2, enemies[i].pos.y + 2}};
+            schedule_wave(&a, 0, max_enemies);
+        }
+        for (int t = 0; t < 500; t++)
+        {
+            shoot(&a);
+            sim_tick(&a);
+        }
 
-            if (check_collision_enemies(ship_parts, enemy_parts, 5))
-            { // Comprueba colision entre jugador y enemigos
-                enemies[i].is_active = 0;
-                schedule_fifo_enemy[i] = enemy_died + 1;
-                enemy_died++;
+        size_t size = sim_snapshot_size(&a);
+        unsigned char *buffer = malloc(size);
+        if (buffer == NULL)
+        {
+            fprintf(stderr, "Not enough memory for the snapshot\n");
+            return 1;
+        }
 
-                hp--; // Resta la vida por colision
-                break;
-            }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (long r = 0; r < reps; r++)
+        {
+            sim_snapshot(&a, buffer);
         }
-    }
-}
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (long r = 0; r < reps; r++)
+        {
+            sim_restore(&b, buffer, size);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
 
-// Verifica si dos posiciones coinciden
-int check_collision(Position pos, Position *parts, int size)
-{
-    for (int i = 0; i < size; i++)
-    {
-        // exit(0);
-        if (pos.x == parts[i].x && pos.y == parts[i].y)
+        // El restaurado debe avanzar igual que el original
+        int same = 1;
+        for (int t = 0; t < 1000 && same; t++)
+        {
+            shoot(&a);
+            shoot(&b);
+            sim_tick(&a);
+            sim_tick(&b);
+            same = a.score == b.score && a.hp == b.hp && a.enemies.count == b.enemies.count &&
+                   a.projectiles.count == b.projectiles.count && sim_rng_digest(&a) == sim_rng_digest(&b);
+        }
+
+        double snap_us = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / reps;
+        double restore_us = ((t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec)) / 1e3 / reps;
+        printf("%s world: %zu bytes, snapshot %.2f us, restore %.2f us (%.2f GB/s), replay %s\n",
+               swarm ? "swarm" : "game", size, snap_us, restore_us, size / restore_us / 1e3,
+               same ? "identical" : "DIVERGED");
+
+        free(buffer);
+        sim_destroy(&a);
+        sim_destroy(&b);
+        if (!same)
         {
             return 1;
         }
@@ -803,218 +889,2300 @@ int check_collision(Position pos, Position *parts, int size)
     return 0;
 }
 
-int check_collision_enemies(Position *ship_parts, Position *parts, int size)
+// Mide cuanto cuesta cada numero aleatorio con rand(), rand_r() y el generador de la
+// simulacion, tanto crudo como acotado a un rango. Despues simula dos mundos intercalados
+// tick a tick y comprueba que cada uno avanza igual que si corriera solo
+int run_rng_bench(long reps)
 {
-    for (int i = 0; i < size; i++)
+    struct timespec t0, t1;
+    volatile unsigned int sink = 0; // Evita que el compilador descarte los bucles
+    unsigned int seed = 12345;
+    Rng r;
+    double ns[5];
+
+    srand(12345);
+    rng_seed(&r, 12345, 0);
+    for (int k = 0; k < 5; k++)
     {
-        for (int j = 0; j < size; j++)
+        unsigned int acc = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (long i = 0; i < reps; i++)
         {
-            if (ship_parts[j].x == parts[i].x && ship_parts[j].y == parts[i].y)
+            switch (k)
             {
-                return 1;
+            case 0:
+                acc += rand();
+                break;
+            case 1:
+                acc += rand_r(&seed);
+                break;
+            case 2:
+                acc += rng_next(&r);
+                break;
+            case 3:
+                acc += rand() % (BENCH_COLS - 4);
+                break;
+            case 4:
+                acc += rng_below(&r, BENCH_COLS - 4);
+                break;
             }
         }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        sink += acc;
+        ns[k] = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / reps;
     }
-    return 0;
-}
-
-int check_collision_boss(Position boss_projectile, Position *ship_parts, int size)
+    printf("rand():          %.2f ns/call\n", ns[0]);
+    printf("rand_r():        %.2f ns/call\n", ns[1]);
+    printf("rng_next():      %.2f ns/call (%.1fx rand)\n", ns[2], ns[0] / ns[2]);
+    printf("rand() %% n:      %.2f ns/call\n", ns[3]);
+    printf("rng_below(n):    %.2f ns/call (%.1fx rand %% n)\n", ns[4], ns[3] / ns[4]);
+
+    // El mundo a corre solo y despues otra vez intercalado con b, sembrado distinto
+    World a, b;
+    int score[2];
+    unsigned int digest[2];
+    if (sim_create(&a, MAX_ENEMIES, MAX_PROJECTILES) != 0 || sim_create(&b, MAX_ENEMIES, MAX_PROJECTILES) != 0)
+    {
+        fprintf(stderr, "Not enough memory for the benchmark world\n");
+        return 1;
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        sim_seed(&a, 12345);
+        sim_init(&a, BENCH_ROWS, BENCH_COLS);
+        sim_seed(&b, 777);
+        sim_init(&b, BENCH_ROWS, BENCH_COLS);
+        for (int t = 0; t < 5000; t++)
+        {
+            shoot(&a);
+            sim_tick(&a);
+            if (pass == 1)
+            {
+                shoot(&b);
+                sim_tick(&b);
+            }
+        }
+        score[pass] = a.score;
+        digest[pass] = sim_rng_digest(&a);
+    }
+    int same = score[0] == score[1] && digest[0] == digest[1];
+    printf("two worlds interleaved: %s\n", same ? "independent" : "INTERFERED");
+
+    sim_destroy(&a);
+    sim_destroy(&b);
+    return !same;
+}
+
+// Simula ticks con el jefe disparando el guion BOSS_SCRIPT_BULLET_HELL en el tablero del
+// enjambre. La nave barre la pantalla sin disparar y no muere, asi el jefe nunca se va y la
+// pool de proyectiles se mantiene llena. Se mide cada tick por separado para reportar el peor
+int run_bullet_bench(long ticks)
+{
+    World bench_world;
+    struct timespec begin, end, t0, t1;
+    long live = 0, max_live = 0, crowded = 0, hits = 0, max_tick_ns = 0;
+    int direction = DIR_RIGHT;
+
+    if (sim_create_pools(&bench_world, MAX_ENEMIES, MAX_PROJECTILES, BULLET_HELL_PROJECTILES) != 0)
+    {
+        fprintf(stderr, "Not enough memory for the benchmark world\n");
+        return 1;
+    }
+
+    sim_seed(&bench_world, 12345);
+    sim_init(&bench_world, SWARM_ROWS, SWARM_COLS);
+    bench_world.boss_script = BOSS_SCRIPT_BULLET_HELL;
+    bench_world.boss_ticks = 0; // El jefe aparece en el primer tick
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (long t = 0; t < ticks; t++)
+    {
+        if (bench_world.player.x <= 2 || bench_world.player.x >= bench_world.cols - 3)
+        {
+            direction = -direction;
+        }
+        move_player(&bench_world, direction);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        sim_tick(&bench_world);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        long tick_ns = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
+        if (tick_ns > max_tick_ns)
+        {
+            max_tick_ns = tick_ns;
+        }
+        hits += 3 - bench_world.hp;
+        bench_world.hp = 3;
+
+        long n = bench_world.boss_projectiles.count;
+        live += n;
+        if (n > max_live)
+        {
+            max_live = n;
+        }
+        if (n >= 5000)
+        {
+            crowded++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("ticks: %ld\n", ticks);
+    printf("live boss bullets/tick: %.1f (max %ld)\n", (double)live / ticks, max_live);
+    printf("ticks with 5000+ bullets: %ld (%.1f%%)\n", crowded, 100.0 * crowded / ticks);
+    printf("ship hits: %ld\n", hits);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("ticks/sec: %.0f\n", ticks / seconds);
+    printf("ns/tick: %.1f\n", seconds * 1e9 / ticks);
+    printf("ns/bullet: %.2f\n", live > 0 ? seconds * 1e9 / live : 0.0);
+    printf("slowest tick: %.1f us\n", max_tick_ns / 1e3);
+    printf("frame budget used: %.2f%% (slowest %.2f%%)\n", seconds * 1e9 / ticks / (DELAY * 1000.0) * 100,
+           max_tick_ns / (DELAY * 1000.0) * 100);
+    printf("boss bullet pool exhausted: %ld\n", bench_world.boss_projectiles.exhausted);
+
+    sim_destroy(&bench_world);
+    return 0;
+}
+
+// Registra runs partidas con puntuaciones aleatorias en una tabla temporal, la cierra y la
+// vuelve a abrir, y mide las consultas. Cada posicion se compara con la que da un conteo
+// directo de las puntuaciones registradas
+int run_leaderboard_bench(long runs)
+{
+    const int max_score = 100000;
+    struct timespec t0, t1;
+    char name[64];
+    Leaderboard b;
+    Rng r;
+    long *above = calloc(max_score + 2, sizeof(long)); // above[s]: partidas con mas de s puntos
+    if (above == NULL)
+    {
+        fprintf(stderr, "Not enough memory for the benchmark\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "bench_leaderboard_%d", (int)getpid());
+    if (leaderboard_open(&b, name) != 0)
+    {
+        perror(name);
+        free(above);
+        return 1;
+    }
+
+    // La partida mas lenta muestra si el hilo del juego espera a una compactacion
+    long slowest = 0;
+    rng_seed(&r, 12345, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < runs; i++)
+    {
+        int score = rng_below(&r, max_score);
+        long begin = prof_now_ns();
+        if (leaderboard_add(&b, score, rng_below(&r, 100000)) == -1)
+        {
+            fprintf(stderr, "leaderboard_add failed after %ld runs\n", i);
+            break;
+        }
+        long elapsed = prof_now_ns() - begin;
+        slowest = elapsed > slowest ? elapsed : slowest;
+        above[score]++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double add_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("add: %ld runs in %.3f s, %.2f us/run, slowest %.1f us\n", runs, add_s, add_s * 1e6 / runs,
+           slowest / 1e3);
+    for (int s = max_score - 1; s >= 0; s--)
+    {
+        above[s] += above[s + 1]; // Suma acumulada: ahora cuenta las partidas con s puntos o mas
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    leaderboard_close(&b);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    // Las compactaciones corren en el compactador: se cuentan cuando el cierre ya lo espero
+    printf("close: %.1f ms, %ld compactions in the background (%.1f ms total)\n",
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6, b.compactions, b.compact_ns / 1e6);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int opened = leaderboard_open(&b, name);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (opened != 0)
+    {
+        perror(name);
+        free(above);
+        return 1;
+    }
+    printf("open: %.3f ms, %ld runs indexed, %ld read from the log (%.1f MB index)\n",
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6, (long)b.indexed, b.loaded,
+           b.map_size / 1048576.0);
+
+    // Posicion de puntuaciones al azar, comparada con el conteo
+    long queries = 1000000, wrong = 0;
+    volatile long sink = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < queries; i++)
+    {
+        int score = rng_below(&r, max_score);
+        long rank = leaderboard_rank(&b, score);
+        wrong += rank != 1 + above[score + 1];
+        sink += rank;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("rank: %.0f ns/query, %s\n", ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / queries,
+           wrong ? "WRONG" : "all correct");
+
+    LeaderboardEntry top[10];
+    int n = 0, sorted = 1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long i = 0; i < queries; i++)
+    {
+        n = leaderboard_top(&b, 10, top);
+        sink += top[0].score;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int k = 1; k < n; k++)
+    {
+        sorted &= top[k - 1].score >= top[k].score;
+    }
+    sorted &= n == (runs < 10 ? runs : 10) && (n == 0 || above[top[0].score + 1] == 0);
+    printf("top 10: %.0f ns/query, %s\n", ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / queries,
+           sorted ? "correct" : "WRONG");
+
+    leaderboard_close(&b);
+    unlink(b.log_path);
+    unlink(b.index_path);
+    free(above);
+    return wrong || !sorted;
+}
+
+// Tabla de puntuaciones sin terminal: las K mejores partidas y, si se indica, la posicion
+// que tendria una puntuacion
+int run_scores(int argc, char *argv[])
+{
+    int k = argc >= 3 && argv[2][0] != '-' ? atoi(argv[2]) : 10;
+    Leaderboard b;
+    if (k <= 0)
+    {
+        fprintf(stderr, "Usage: %s --scores [K] [--rank SCORE]\n", argv[0]);
+        return 1;
+    }
+    if (leaderboard_open(&b, LEADERBOARD_NAME) != 0)
+    {
+        perror(LEADERBOARD_NAME);
+        return 1;
+    }
+    LeaderboardEntry *top = malloc(k * sizeof(LeaderboardEntry));
+    if (top == NULL)
+    {
+        leaderboard_close(&b);
+        fprintf(stderr, "Not enough memory for the table\n");
+        return 1;
+    }
+
+    int n = leaderboard_top(&b, k, top);
+    printf("%ld runs\n", leaderboard_count(&b));
+    for (int i = 0; i < n; i++)
+    {
+        time_t when = top[i].time;
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&when));
+        printf("%3d. %8d  %6.1f s  %s\n", i + 1, top[i].score, top[i].ticks * (DELAY / 1e6), date);
+    }
+    for (int i = 2; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--rank") == 0)
+        {
+            int score = atoi(argv[i + 1]);
+            printf("score %d: rank %ld\n", score, leaderboard_rank(&b, score));
+        }
+    }
+    free(top);
+    leaderboard_close(&b);
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region MODO_REPETICION
+// Avanza world hasta el tick target. Sin terminal simula de corrido; en tiempo real espera
+// el reloj de paso fijo y dibuja un cuadro cada vez que se ponen al dia los ticks vencidos
+static void replay_advance(GameState *g, unsigned long target, int headless, int *due)
+{
+    while (g->world.tick < target && g->running)
+    {
+        if (!headless && *due == 0)
+        {
+            capture_frame(g, &g->frames[0]); // Sin hilo de dibujo se usa un solo cuadro
+            draw_game(g, &g->frames[0]);
+            if (term_getch() == 'q')
+            {
+                g->running = 0;
+                break;
+            }
+            *due = game_clock_wait(&g->game_clock);
+            continue;
+        }
+        sim_tick(&g->world);
+        if (g->world.score > g->high_score)
+        {
+            g->high_score = g->world.score;
+        }
+        (*due)--;
+    }
+}
+
+// Reproduce todas las partidas de una grabacion sobre el mundo global. Cada partida
+// arranca desde su semilla o su instantanea y recibe las teclas en los mismos ticks; al
+// final se compara el estado con el que se grabo para detectar cualquier divergencia
+int run_replay(const char *path, int headless)
+{
+    Replay r;
+    ReplayEvent ev;
+    struct timespec begin, end;
+    long games = 0, keys = 0, ticks = 0, diverged = 0, incomplete = 0;
+    int in_game = 0, due = 0, status = 0;
+    GameState replay;
+    GameState *g = &replay;
+    game_state_init(g, NULL); // La repeticion no guarda partidas
+
+    if (replay_open_read(&r, path) != 0)
+    {
+        fprintf(stderr, "%s: not a replay file\n", path);
+        return 1;
+    }
+    if (sim_create(&g->world, MAX_ENEMIES, MAX_PROJECTILES) != 0)
+    {
+        fprintf(stderr, "Not enough memory for the game world\n");
+        replay_close(&r);
+        return 1;
+    }
+    if (!headless)
+    {
+        if (frame_alloc(&g->frames[0], &g->world) != 0)
+        {
+            fprintf(stderr, "Not enough memory for the frame buffers\n");
+            replay_close(&r);
+            sim_destroy(&g->world);
+            return 1;
+        }
+        init_screen();
+        game_clock_init(&g->game_clock, DELAY * 1000L, MAX_CATCHUP_TICKS);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    while (g->running && (status = replay_next(&r, &ev)) == 1)
+    {
+        if (ev.kind == REPLAY_NEW || ev.kind == REPLAY_SNAPSHOT)
+        {
+            incomplete += in_game; // La partida anterior no llego a grabar su final
+            if (ev.kind == REPLAY_NEW)
+            {
+                sim_seed(&g->world, ev.seed);
+                sim_init(&g->world, ev.rows, ev.cols);
+            }
+            else if (sim_restore(&g->world, ev.snapshot, ev.snapshot_size) != 0)
+            {
+                status = -1;
+                break;
+            }
+            g->drawn_state = -1;
+            g->state = 1; // capture_frame copia las entidades de la partida en curso
+            in_game = 1;
+            games++;
+            continue;
+        }
+        if (!in_game)
+        {
+            continue;
+        }
+
+        unsigned long start = g->world.tick;
+        replay_advance(g, ev.tick, headless, &due);
+        ticks += g->world.tick - start;
+        if (ev.kind == REPLAY_KEY)
+        {
+            play_key(&g->world, ev.key);
+            keys++;
+        }
+        else if (ev.kind == REPLAY_END)
+        {
+            diverged += g->world.score != ev.score || g->world.hp != ev.hp || sim_rng_digest(&g->world) != ev.rng;
+            in_game = 0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    incomplete += in_game;
+
+    if (!headless)
+    {
+        term_close();
+        print_render_stats();
+        render_free();
+        frame_free(&g->frames[0]);
+    }
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("games: %ld (%ld without end, %ld diverged)\n", games, incomplete, diverged);
+    printf("keys: %ld\n", keys);
+    printf("ticks: %ld\n", ticks);
+    printf("elapsed: %.3f s\n", seconds);
+    printf("ticks/sec: %.0f\n", seconds > 0 ? ticks / seconds : 0.0);
+    if (status == -1)
+    {
+        printf("replay file is damaged after %ld records\n", r.records);
+    }
+
+    replay_close(&r);
+    sim_destroy(&g->world);
+    return status == -1 || diverged > 0;
+}
+
+#pragma endregion
+
+#pragma region MODO_ESPECTADOR
+// Dibuja el ultimo estado recibido. La partida se dibuja con los mismos sprites y el mismo
+// renderizador que el juego; fuera de la partida se muestra un aviso solo cuando cambia
+static void draw_spectated(GameState *g, SpectateReader *r)
+{
+    const SpectateFrame *v = &r->frame;
+    Frame f;
+    memset(&f, 0, sizeof(f));
+    f.tick = v->tick;
+    f.state = v->state;
+    f.hp = v->hp;
+    f.score = v->score;
+    f.high_score = v->high_score;
+    f.player = (Position){v->player_x, v->player_y};
+    f.boss.is_active = v->boss_active;
+    f.boss.pos = (Position){v->boss_x, v->boss_y};
+    f.boss.hp = v->boss_hp;
+    FrameEntities *e[SPECTATE_CLASSES] = {&f.projectiles, &f.enemies, &f.boss_projectiles};
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        SpectateTrack *t = &r->tracks[c];
+        *e[c] = (FrameEntities){t->count, t->id, t->x, t->y, t->type};
+    }
+
+    if (f.state == 1)
+    {
+        draw_game(g, &f);
+        return;
+    }
+    if (g->drawn_state == f.state)
+    {
+        return;
+    }
+    int y = term_rows() / 2, x = term_cols() / 2 - 10;
+    term_clear();
+    term_print(y - 2, x, COLOR_PAIR(1), "Spectating");
+    if (f.state == 2)
+    {
+        term_print(y, x, COLOR_PAIR(4), "Game Over");
+        term_print(y + 1, x, 0, "Score: %d", f.score);
+    }
+    else
+    {
+        term_print(y, x, 0, "Waiting for the player to start a game");
+    }
+    term_print(y + 2, x, 0, "High Score: %d", f.high_score);
+    term_print(y + 3, x, 0, "Press 'q' to stop watching");
+    term_flush();
+    g->drawn_state = f.state;
+}
+
+// Se conecta al socket de un juego lanzado con --broadcast y dibuja lo que recibe hasta que
+// el juego termina o se pulsa 'q'. Sin terminal solo decodifica, para medir el flujo
+int run_spectate(const char *path, int headless)
+{
+    SpectateReader r;
+    int status = 0;
+    GameState spectated; // Solo se usan running y la pantalla dibujada
+    GameState *g = &spectated;
+    game_state_init(g, NULL);
+    if (spectate_connect(&r, path) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+    if (!headless)
+    {
+        init_screen();
+    }
+
+    long started = input_now_ns();
+    while (g->running)
+    {
+        struct pollfd fds[2] = {{r.fd, POLLIN, 0}, {term_input_fd(), POLLIN, 0}};
+        if (poll(fds, headless ? 1 : 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue; // SIGWINCH: el proximo cuadro se redibuja con el tamaño nuevo
+            }
+            break;
+        }
+        int ch;
+        while (!headless && (fds[1].revents & POLLIN) && (ch = term_getch()) != ERR)
+        {
+            if (ch == 'q')
+            {
+                g->running = 0;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            int applied = spectate_read(&r);
+            if (applied < 0)
+            {
+                status = r.messages == 0; // El juego cerro la conexion
+                break;
+            }
+            if (applied > 0 && r.synced && !headless)
+            {
+                draw_spectated(g, &r); // Solo el ultimo estado de lo que llego junto
+            }
+        }
+    }
+    long elapsed = input_now_ns() - started;
+
+    if (!headless)
+    {
+        term_close();
+        print_render_stats();
+        render_free();
+    }
+    printf("spectated: %ld messages (%ld keyframes), %ld bytes, %.1f bytes/message in %.1f s\n", r.messages,
+           r.keyframes, r.bytes, r.messages ? (double)r.bytes / r.messages : 0.0, elapsed / 1e9);
+    spectate_disconnect(&r);
+    return status;
+}
+
+#pragma endregion
+
+#pragma region MODO_ANFITRION
+// Sesion del modo anfitrion: una partida completa con su pty, su pantalla y su renderizador.
+// El jugador se conecta al esclavo de la pty (p. ej. screen /dev/pts/N) y el anfitrion
+// escribe los cuadros y lee las teclas por el maestro
+typedef struct
+{
+    GameState game;
+    int master, slave;   // Extremos de la pty; el esclavo queda abierto para que el maestro no cierre
+    char path[64];       // Ruta del esclavo
+    char save_path[32];  // Archivo de partidas propio de la sesion
+    TermScreen *screen;
+    Renderer *renderer;
+    Frame frame;         // Cuadro que se dibuja al final de cada tick
+} HostSession;
+
+// Estado compartido con los hilos del pool. Durante un lote cada hilo toca solo las sesiones
+// que procesa; entre lotes el hilo del anfitrion lee las teclas de las ptys
+typedef struct
+{
+    HostSession *sessions;
+    int count;
+    int due;            // Ticks que simula cada sesion en el lote actual
+    int bot;            // 1 si el bot juega todas las sesiones
+    atomic_long played; // Ticks simulados dentro de una partida (no en menus)
+    long batches;       // Ticks del anfitrion (un lote cada uno)
+    long session_ticks; // Ticks de todas las sesiones
+    long dropped;       // Ticks descartados por superar MAX_CATCHUP_TICKS
+    long busy_ns;       // Tiempo total de los lotes
+    long max_batch_ns;  // Lote mas largo
+    long late;          // Lotes que tardaron mas que un tick
+    long wall_ns;       // Duracion del modo anfitrion
+    Leaderboard leaderboard; // Tabla de puntuaciones de todas las sesiones
+    int ranked;         // 1 si la tabla se pudo abrir
+    SaveQueue saves;    // Hilo que escribe los guardados de todas las sesiones
+    int saving;         // 1 si el hilo de guardado esta corriendo
+} Host;
+
+static volatile sig_atomic_t host_stop; // Lo marca SIGINT o SIGTERM
+
+static void on_host_stop(int sig)
+{
+    (void)sig;
+    host_stop = 1;
+}
+
+// Memoria residente del proceso segun /proc/self/statm
+static long resident_bytes()
+{
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f != NULL)
+    {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Crea la pty en modo crudo (sin eco ni edicion de linea, para que los cuadros y las teclas
+// pasen tal cual) y la partida de la sesion, con su propio archivo de guardado, que escribe
+// el hilo de guardado del anfitrion. La tabla de puntuaciones es la del anfitrion (o ninguna
+// si board es NULL)
+static int host_session_open(HostSession *s, int index, unsigned long seed, Leaderboard *board, SaveQueue *saves)
+{
+    GameState *g = &s->game;
+    snprintf(s->save_path, sizeof(s->save_path), "session_%d.dat", index);
+    game_state_init(g, s->save_path);
+    g->save_queue = saves;
+    input_queue_init(&g->input_queue);
+    g->next_seed = seed + index;
+    g->leaderboard = board;
+    refresh_leaderboard(g);
+    s->slave = -1;
+
+    s->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (s->master == -1 || grantpt(s->master) != 0 || unlockpt(s->master) != 0 ||
+        ptsname_r(s->master, s->path, sizeof(s->path)) != 0)
+    {
+        return -1;
+    }
+    s->slave = open(s->path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    struct termios raw;
+    if (s->slave == -1 || tcgetattr(s->slave, &raw) != 0)
+    {
+        return -1;
+    }
+    cfmakeraw(&raw);
+    tcsetattr(s->slave, TCSANOW, &raw);
+    struct winsize ws = {HOST_ROWS, HOST_COLS, 0, 0};
+    ioctl(s->master, TIOCSWINSZ, &ws);
+
+    s->screen = term_screen_create(s->master, s->master, HOST_ROWS, HOST_COLS);
+    s->renderer = render_create();
+    if (s->screen == NULL || s->renderer == NULL || sim_create(&g->world, MAX_ENEMIES, MAX_PROJECTILES) != 0 ||
+        load_save_index(g, s->save_path) != 0 || frame_alloc(&s->frame, &g->world) != 0)
+    {
+        return -1;
+    }
+    TermScreen *previous = term_select(s->screen);
+    init_pairs();
+    term_select(previous);
+    return 0;
+}
+
+static void host_session_close(HostSession *s)
+{
+    GameState *g = &s->game;
+    reap_save_child(g, 1);
+    input_queue_free(&g->input_queue);
+    term_screen_destroy(s->screen);
+    render_destroy(s->renderer);
+    frame_free(&s->frame);
+    sim_destroy(&g->world);
+    slot_store_free(&g->slot_store);
+    free(g->saved_games);
+    free(g->save_world);
+    free(g->save_games);
+    if (s->slave != -1)
+    {
+        close(s->slave);
+    }
+    if (s->master != -1)
+    {
+        close(s->master);
+    }
+}
+
+// Lee las teclas que llegaron a la pty y las encola para el proximo tick de la sesion
+static void host_read_input(HostSession *s)
+{
+    TermScreen *previous = term_select(s->screen);
+    int ch;
+    while ((ch = term_getch()) != ERR)
+    {
+        input_queue_push(&s->game.input_queue, ch);
+    }
+    term_select(previous);
+}
+
+// Un tick de una sesion, en un hilo del pool: el mismo paso del bucle del juego seguido del
+// dibujo en la pantalla de la sesion. Salir no termina el proceso: la sesion vuelve a la
+// pantalla de inicio
+static void host_tick(void *ctx, int worker, long job)
+{
+    Host *h = ctx;
+    HostSession *s = &h->sessions[job];
+    GameState *g = &s->game;
+    TermScreen *screen = term_select(s->screen);
+    Renderer *renderer = render_select(s->renderer);
+    (void)worker;
+
+    drain_input(g);
+    if (h->bot && g->state != 1)
+    {
+        handle_key(g, g->state == 2 ? 'r' : 'n');
+    }
+    if (h->bot && g->state == 1)
+    {
+        bot_play(&g->world);
+    }
+    unsigned long tick = g->world.tick;
+    step_game(g, h->due);
+    atomic_fetch_add_explicit(&h->played, g->world.tick - tick, memory_order_relaxed);
+    if (!g->running)
+    {
+        g->running = 1;
+        g->state = 0;
+        g->screen_serial++;
+    }
+    capture_frame(g, &s->frame);
+    draw_frame(g, &s->frame);
+
+    term_select(screen);
+    render_select(renderer);
+}
+
+// Espera teclas y ticks hasta que llega SIGINT o SIGTERM o pasan seconds segundos (0 sin tope).
+// Las teclas se leen entre lotes, asi que nunca se tocan al mismo tiempo que las sesiones
+static void host_loop(Host *h, WorkPool *pool, int epoll_fd, int timer_fd, double seconds)
+{
+    struct epoll_event tev = {EPOLLIN, {.u64 = h->count}};
+    struct itimerspec period = {{0, DELAY * 1000L}, {0, DELAY * 1000L}};
+    struct epoll_event events[HOST_EVENTS];
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_host_stop; // Sin SA_RESTART, para que epoll_wait vuelva
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &tev);
+    timerfd_settime(timer_fd, 0, &period, NULL);
+
+    long started = input_now_ns();
+    while (!host_stop && (seconds <= 0 || input_now_ns() - started < seconds * 1e9))
+    {
+        int n = epoll_wait(epoll_fd, events, HOST_EVENTS, -1);
+        for (int e = 0; e < n; e++)
+        {
+            if (events[e].data.u64 != (uint64_t)h->count)
+            {
+                host_read_input(&h->sessions[events[e].data.u64]);
+                continue;
+            }
+            uint64_t expirations = 0;
+            if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            {
+                continue;
+            }
+            // Igual que el reloj del juego: si el lote anterior se atraso se simulan los ticks
+            // vencidos, hasta MAX_CATCHUP_TICKS
+            h->due = expirations > MAX_CATCHUP_TICKS ? MAX_CATCHUP_TICKS : (int)expirations;
+            h->dropped += expirations - h->due;
+            long t = input_now_ns();
+            work_pool_batch(pool, h->count, host_tick, h);
+            t = input_now_ns() - t;
+            h->busy_ns += t;
+            h->max_batch_ns = t > h->max_batch_ns ? t : h->max_batch_ns;
+            h->late += t > DELAY * 1000L;
+            h->session_ticks += (long)h->count * h->due;
+            h->batches++;
+        }
+    }
+    h->wall_ns = input_now_ns() - started;
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+// Varias sesiones independientes en un proceso. Un solo hilo espera en epoll las teclas de
+// todas las ptys y el timerfd del tick; en cada tick reparte las sesiones entre un pool fijo
+// de hilos y espera a que terminen antes de leer mas teclas. Al salir (SIGINT, SIGTERM o
+// --seconds) reporta la memoria por sesion y los ticks por segundo de todas juntas
+int run_host(int argc, char *argv[])
+{
+    int count = argc >= 3 ? atoi(argv[2]) : 0;
+    int workers = work_pool_default_workers(), bot = 0;
+    double seconds = 0;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bot") == 0)
+        {
+            bot = 1; // Cada sesion la juega el bot, para medir sin jugadores conectados
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+    }
+    if (count <= 0 || workers <= 0)
+    {
+        fprintf(stderr, "Usage: %s --host SESSIONS [--workers N] [--seconds S] [--bot]\n", argv[0]);
+        return 1;
+    }
+
+    // Cada sesion usa tres descriptores: maestro, esclavo y el eventfd de su cola de teclas
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)count * 3 + 16)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Host h;
+    memset(&h, 0, sizeof(h));
+    h.count = count;
+    h.bot = bot;
+    h.ranked = leaderboard_open(&h.leaderboard, HOST_LEADERBOARD_NAME) == 0;
+    h.saving = save_queue_start(&h.saves, count) == 0;
+    WorkerStats *stats = aligned_alloc(64, workers * sizeof(WorkerStats));
+    long rss_before = resident_bytes();
+    h.sessions = calloc(count, sizeof(HostSession));
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    WorkPool *pool = stats != NULL ? work_pool_create(workers, stats) : NULL;
+    int opened = 0, status = 1;
+    unsigned long seed = time(NULL);
+    int ready = h.sessions != NULL && pool != NULL && epoll_fd != -1 && timer_fd != -1 && h.saving;
+    if (!ready)
+    {
+        fprintf(stderr, "Could not start the host\n");
+    }
+    for (; ready && opened < count; opened++)
+    {
+        HostSession *s = &h.sessions[opened];
+        struct epoll_event ev = {EPOLLIN, {.u64 = opened}};
+        if (host_session_open(s, opened, seed, h.ranked ? &h.leaderboard : NULL, &h.saves) != 0 ||
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->master, &ev) != 0)
+        {
+            fprintf(stderr, "session %d: %s\n", opened, strerror(errno));
+            host_session_close(s);
+            ready = 0;
+            break;
+        }
+        printf("session %d: %s\n", opened, s->path);
+    }
+    fflush(stdout);
+
+    if (ready)
+    {
+        long rss_sessions = resident_bytes();
+        host_loop(&h, pool, epoll_fd, timer_fd, seconds);
+        long rss = resident_bytes();
+        // Los guardados que quedaron en la cola se escriben antes de sumar sus tiempos
+        save_queue_stop(&h.saves);
+        h.saving = 0;
+
+        long stalled = 0;
+        SaveStats saves;
+        memset(&saves, 0, sizeof(saves));
+        for (int i = 0; i < count; i++)
+        {
+            const SaveStats *st = &h.sessions[i].game.save_stats;
+            stalled += term_dropped_frames(h.sessions[i].screen);
+            saves.saves += st->saves;
+            saves.autosaves += st->autosaves;
+            saves.failed += st->failed;
+            saves.writes += st->writes;
+            saves.stall_ns += st->stall_ns;
+            saves.write_ns += st->write_ns;
+            saves.max_stall_ns = st->max_stall_ns > saves.max_stall_ns ? st->max_stall_ns : saves.max_stall_ns;
+            saves.max_write_ns = st->max_write_ns > saves.max_write_ns ? st->max_write_ns : saves.max_write_ns;
+        }
+        double wall = h.wall_ns / 1e9;
+        workers = work_pool_workers(pool);
+        printf("host: %d sessions on %d workers, %ld ticks in %.1f s (%ld late, %ld dropped)\n", count, workers,
+               h.batches, wall, h.late, h.dropped);
+        printf("ticks/sec: %.0f session ticks across all sessions, %.0f of them in a game\n", h.session_ticks / wall,
+               atomic_load(&h.played) / wall);
+        printf("tick batch: avg %.1f us, max %.1f us (tick %d us), %.2f us per session tick\n",
+               h.batches ? h.busy_ns / 1e3 / h.batches : 0.0, h.max_batch_ns / 1e3, DELAY,
+               h.session_ticks ? h.busy_ns / 1e3 / h.session_ticks : 0.0);
+        printf("memory: %.1f KB resident per session after opening, %.1f KB after playing (%zu bytes of state)\n",
+               (rss_sessions - rss_before) / 1024.0 / count, (rss - rss_before) / 1024.0 / count, sizeof(HostSession));
+        printf("output: %ld frames dropped on full ptys\n", stalled);
+        print_save_stats(&saves, "session");
+        if (h.ranked)
+        {
+            printf("leaderboard: %ld runs, %ld compactions\n", leaderboard_count(&h.leaderboard),
+                   h.leaderboard.compactions);
+        }
+        for (int i = 0; i < workers; i++)
+        {
+            printf("worker %d: %ld session ticks, %ld stolen\n", i, stats[i].executed, stats[i].stolen);
+        }
+        status = 0;
+    }
+
+    if (pool != NULL)
+    {
+        work_pool_destroy(pool);
+    }
+    if (h.saving)
+    {
+        save_queue_stop(&h.saves);
+    }
+    for (int i = 0; i < opened; i++)
+    {
+        h.sessions[i].game.save_queue = NULL; // El hilo de guardado ya escribio todo y termino
+        host_session_close(&h.sessions[i]);
+    }
+    if (epoll_fd != -1)
+    {
+        close(epoll_fd);
+    }
+    if (timer_fd != -1)
+    {
+        close(timer_fd);
+    }
+    if (h.ranked)
+    {
+        leaderboard_close(&h.leaderboard);
+    }
+    free(h.sessions);
+    free(stats);
+    return status;
+}
+
+#pragma endregion
+
+#pragma region MODO_BATCH
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Ordena values y devuelve el percentil p (0..100)
+static long percentile(long *values, long n, double p)
+{
+    qsort(values, n, sizeof(long), compare_long);
+    return values[(long)(p / 100 * (n - 1))];
+}
+
+// Bot simple: se alinea con el enemigo mas bajo (el mas cercano a la nave) o con el jefe
+// si no hay enemigos, y dispara cuando esta debajo de el
+void bot_play(World *w)
+{
+    EntityColumns *e = &w->enemies;
+    int target = -1, lowest = -1;
+
+    for (int i = 0; i < e->count; i++)
+    {
+        if (e->y[i] > lowest)
+        {
+            lowest = e->y[i];
+            target = e->x[i];
+        }
+    }
+    if (target == -1 && w->boss.is_active)
+    {
+        target = w->boss.pos.x + 2;
+    }
+    if (target == -1)
+    {
+        return;
+    }
+
+    if (target < w->player.x)
+    {
+        move_player(w, DIR_LEFT);
+    }
+    else if (target > w->player.x)
+    {
+        move_player(w, DIR_RIGHT);
+    }
+    if (abs(target - w->player.x) <= 1)
+    {
+        shoot(w);
+    }
+}
+
+// Juega la partida game con la semilla seed + game hasta que la nave muere o se llega al
+// tope de ticks. Las teclas salen del guion si hay uno o del bot si no
+void batch_game(void *ctx, int worker, long game)
+{
+    Batch *b = ctx;
+    World *w = &b->worlds[worker];
+    BatchResult *r = &b->results[game];
+    long next_key = 0;
+
+    r->seed = b->seed + game;
+    sim_seed(w, r->seed);
+    sim_init(w, BENCH_ROWS, BENCH_COLS);
+    while (w->hp > 0 && (long)w->tick < b->max_ticks)
+    {
+        if (b->script == NULL)
+        {
+            bot_play(w);
+        }
+        while (next_key < b->script_keys && b->script[next_key].tick <= w->tick)
+        {
+            play_key(w, b->script[next_key++].key);
+        }
+        sim_tick(w);
+    }
+
+    r->score = w->score;
+    r->ticks = w->tick;
+    r->boss_kills = w->boss_kills;
+    r->died = w->hp <= 0;
+}
+
+// Las teclas de la primera partida de una grabacion, con los ticks contados desde su inicio
+long load_script(const char *path, ScriptKey **keys)
+{
+    Replay r;
+    ReplayEvent ev;
+    long count = 0, cap = 0;
+    unsigned long start = 0;
+    int sessions = 0;
+
+    *keys = NULL;
+    if (replay_open_read(&r, path) != 0)
+    {
+        return -1;
+    }
+    while (replay_next(&r, &ev) == 1 && ev.kind != REPLAY_END)
+    {
+        if (ev.kind == REPLAY_NEW || ev.kind == REPLAY_SNAPSHOT)
+        {
+            if (sessions++ > 0)
+            {
+                break;
+            }
+            start = ev.tick;
+            continue;
+        }
+        if (count == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            ScriptKey *grown = realloc(*keys, cap * sizeof(ScriptKey));
+            if (grown == NULL)
+            {
+                break;
+            }
+            *keys = grown;
+        }
+        (*keys)[count].tick = ev.tick - start;
+        (*keys)[count].key = ev.key;
+        count++;
+    }
+    replay_close(&r);
+    return count;
+}
+
+// Reparte las partidas entre un hilo por nucleo con robo de trabajo, escribe una fila del
+// CSV por partida y resume puntos, supervivencia y jefes derrotados
+int run_batch(int argc, char *argv[])
+{
+    long games = argc >= 3 ? atol(argv[2]) : 0;
+    int workers = work_pool_default_workers();
+    const char *csv_path = "batch.csv", *script_path = NULL;
+    Batch b = {NULL, NULL, 1, BATCH_MAX_TICKS, NULL, 0};
+    int enemy_period = SPEED_LOW_ENEMIES, spawn_chance = SPAWN_CHANCE;
+    long boss_ticks = BOSS_TICKS;
+
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--threads") == 0)
+        {
+            workers = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv_path = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--ticks") == 0)
+        {
+            b.max_ticks = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            b.seed = strtoul(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--script") == 0)
+        {
+            script_path = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--speed") == 0)
+        {
+            enemy_period = atoi(argv[i + 1]); // Reemplaza SPEED_LOW_ENEMIES
+        }
+        else if (strcmp(argv[i], "--boss-time") == 0)
+        {
+            boss_ticks = atol(argv[i + 1]) * 1000000L / DELAY; // Reemplaza BOSS_TIME (segundos)
+        }
+        else if (strcmp(argv[i], "--spawn") == 0)
+        {
+            spawn_chance = atoi(argv[i + 1]); // Reemplaza SPAWN_CHANCE (%)
+        }
+    }
+    if (games <= 0 || workers <= 0 || b.max_ticks <= 0 || enemy_period <= 0 || boss_ticks < 0 ||
+        spawn_chance < 1 || spawn_chance > 100)
+    {
+        fprintf(stderr, "Usage: %s --batch GAMES [--threads N] [--csv FILE] [--ticks MAX] [--seed S]\n"
+                        "       [--script FILE] [--speed TICKS] [--boss-time SECONDS] [--spawn PERCENT]\n",
+                argv[0]);
+        return 1;
+    }
+
+    ScriptKey *script = NULL;
+    if (script_path != NULL)
+    {
+        b.script_keys = load_script(script_path, &script);
+        if (b.script_keys < 0)
+        {
+            fprintf(stderr, "%s: not a replay file\n", script_path);
+            return 1;
+        }
+        b.script = script;
+    }
+
+    b.worlds = calloc(workers, sizeof(World));
+    b.results = calloc(games, sizeof(BatchResult));
+    WorkerStats *stats = aligned_alloc(64, workers * sizeof(WorkerStats));
+    int created = 0;
+    if (b.worlds != NULL)
+    {
+        while (created < workers && sim_create(&b.worlds[created], MAX_ENEMIES, MAX_PROJECTILES) == 0)
+        {
+            b.worlds[created].enemy_period = enemy_period;
+            b.worlds[created].boss_ticks = boss_ticks;
+            b.worlds[created].spawn_chance = spawn_chance;
+            created++;
+        }
+    }
+
+    int status = 1;
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (created < workers || b.results == NULL || stats == NULL)
+    {
+        fprintf(stderr, "Not enough memory for the batch\n");
+    }
+    else if (work_pool_run(workers, games, batch_game, &b, stats) != 0)
+    {
+        fprintf(stderr, "Could not start the worker threads\n");
+    }
+    else
+    {
+        status = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    FILE *csv = status == 0 ? fopen(csv_path, "w") : NULL;
+    if (status == 0 && csv == NULL)
+    {
+        perror(csv_path);
+        status = 1;
+    }
+    if (csv != NULL)
+    {
+        long *scores = malloc(games * sizeof(long));
+        long *ticks = malloc(games * sizeof(long));
+        long total_ticks = 0, kills = 0, deaths = 0;
+
+        fprintf(csv, "game,seed,score,ticks,boss_kills,died,enemy_period,boss_ticks,spawn_chance\n");
+        for (long g = 0; g < games; g++)
+        {
+            BatchResult *r = &b.results[g];
+            fprintf(csv, "%ld,%lu,%d,%ld,%d,%d,%d,%ld,%d\n", g, r->seed, r->score, r->ticks, r->boss_kills,
+                    r->died, enemy_period, boss_ticks, spawn_chance);
+            total_ticks += r->ticks;
+            kills += r->boss_kills;
+            deaths += r->died;
+            if (scores != NULL && ticks != NULL)
+            {
+                scores[g] = r->score;
+                ticks[g] = r->ticks;
+            }
+        }
+        fclose(csv);
+
+        double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        printf("games: %ld on %d threads (%ld died, %ld hit the %ld tick limit)\n", games, workers, deaths,
+               games - deaths, b.max_ticks);
+        printf("elapsed: %.3f s, %.0f games/sec, %.0f ticks/sec\n", seconds, games / seconds, total_ticks / seconds);
+        if (scores != NULL && ticks != NULL)
+        {
+            long score_sum = 0;
+            for (long g = 0; g < games; g++)
+            {
+                score_sum += scores[g];
+            }
+            long p50 = percentile(scores, games, 50), p90 = percentile(scores, games, 90);
+            printf("score: mean %.1f, p50 %ld, p90 %ld, max %ld\n", (double)score_sum / games, p50, p90,
+                   scores[games - 1]);
+            p50 = percentile(ticks, games, 50);
+            p90 = percentile(ticks, games, 90);
+            printf("survival ticks: mean %.0f, p50 %ld, p90 %ld, max %ld\n", (double)total_ticks / games, p50,
+                   p90, ticks[games - 1]);
+        }
+        printf("boss kills/game: %.2f\n", (double)kills / games);
+        for (int i = 0; i < workers; i++)
+        {
+            printf("thread %d: %ld games, %ld stolen\n", i, stats[i].executed, stats[i].stolen);
+        }
+        printf("results: %s\n", csv_path);
+        free(scores);
+        free(ticks);
+    }
+
+    for (int i = 0; i < created; i++)
+    {
+        sim_destroy(&b.worlds[i]);
+    }
+    free(b.worlds);
+    free(b.results);
+    free(stats);
+    free(script);
+    return status;
+}
+
+#pragma endregion
+
+#pragma region MANEJO_ENTRADA
+long thread_cpu_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+// Hilo de entrada: solo lee teclas y las encola con su marca de tiempo. No toca el estado del
+// juego: la logica asociada a cada tecla la aplica el bucle del juego al vaciar la cola. Duerme en
+// poll hasta que llegan bytes al teclado; al terminar, main lo despierta con input_wake
+void *input_handler(void *arg)
+{
+    GameState *g = arg;
+    int ch;
+    prof_thread_init("input");
+    while (g->running)
+    {
+        if (input_wait(&g->input_queue, term_input_fd()) == 0)
+        {
+            continue; // Despertado para revisar running
+        }
+        while ((ch = term_getch()) != ERR) // obtiene la entrada del usuario
+        {
+            long t = prof_begin();
+            input_queue_push(&g->input_queue, ch);
+            prof_end(PROF_INPUT_READ, t);
+        }
+    }
+    g->input_cpu_ns = thread_cpu_ns();
+    return NULL;
+}
+
+// Vacia la cola de entrada al inicio de cada tick y aplica las teclas en el orden en que llegaron
+void drain_input(GameState *g)
+{
+    InputEvent ev;
+    while (input_queue_pop(&g->input_queue, &ev))
+    {
+        handle_key(g, ev.key);
+    }
+}
+
+// Cambia el estado del juego segun la tecla. Se ejecuta en el hilo del juego al vaciar la cola;
+// las pantallas que cambian las dibuja despues el hilo de dibujo con el cuadro publicado
+void handle_key(GameState *g, int ch)
+{
+    if (g->state == 0)
+    {
+        if (ch == 'n')
+        {
+            g->state = 1;
+            g->current_game = -1;
+            init_game(g);
+        }
+        else if (ch == 'q')
+        {
+            g->running = 0;
+        }
+        else if (ch == 'l')
+        {
+            // Mostrar los juegos del indice en memoria y esperar a que el usuario elija uno
+            g->menu_page = 0;
+            select_menu_page(g);
+            g->state = 3;
+        }
+    }
+    else if (g->state == 3)
+    {
+        if (ch == 'q')
+        {
+            g->state = 0;
+            return;
+        }
+
+        // Cambio de pagina
+        if ((ch == 'n' || ch == KEY_RIGHT) && g->menu_page + 1 < g->menu_pages)
+        {
+            g->menu_page++;
+            select_menu_page(g);
+            return;
+        }
+        if ((ch == 'p' || ch == KEY_LEFT) && g->menu_page > 0)
+        {
+            g->menu_page--;
+            select_menu_page(g);
+            return;
+        }
+
+        int choice = ch - '0';
+        if (choice < 1 || choice > g->menu_games)
+        {
+            g->menu_invalid = 1;
+            g->screen_serial++;
+            return;
+        }
+
+        // Guardar que juego se va a cargar y pasarlo al frente del orden de uso
+        g->current_game = g->menu_slots[choice - 1];
+        g->saved_games[g->current_game].lru = slot_store_touch(&g->slot_store, g->current_game);
+        g->loaded_game = g->saved_games[g->current_game];
+
+        // Primero se restaura el mundo desde el archivo y despues se reescribe en segundo
+        // plano solo el registro de esta partida con su nueva marca de uso
+        reap_save_child(g, 1);
+        startload_game(g, g->loaded_game);
+        record_loaded_game(g);
+        save_game_async(g, g->current_game, 0);
+        g->state = 1; // Regresar al estado de juego después de cargar un juego
+    }
+    else if (g->state == 1)
+    {
+        // Las teclas que cambian el mundo se graban con el tick antes del cual se aplicaron
+        if (play_key(&g->world, ch))
+        {
+            replay_key(&g->recorder, g->world.tick, ch);
+            return;
+        }
+
+        switch (ch)
+        {
+        case 'q':
+            end_recording(g);
+            g->state = 0;
+            break;
+        case 'o':
+            g->show_profile = !g->show_profile;
+            break;
+        case 's':
+        {
+            long save_begin = input_now_ns();
+
+            Saved_Games game = {g->high_score,
+                                g->world.score,
+                                {g->world.player.x, g->world.player.y},
+                                0,
+                                g->world.hp};
+
+            // Una partida nueva ocupa un registro libre o desaloja la usada hace mas tiempo
+            int slot = g->current_game, evicted;
+            if (slot == -1)
+            {
+                slot = slot_store_acquire(&g->slot_store, &evicted);
+            }
+            game.lru = slot_store_touch(&g->slot_store, slot);
+            g->saved_games[slot] = game;
+
+            // Guardar el juego en un archivo junto con el estado completo del mundo. Los
+            // siguientes guardados de esta partida reutilizan el mismo registro. Si el hijo
+            // anterior sigue escribiendo, este guardado espera a que step_game lo recoja
+            save_game_async(g, slot, 1);
+            g->current_game = slot;
+            g->ticks_since_save = 0;
+
+            long stall = input_now_ns() - save_begin;
+            g->save_stats.saves++;
+            g->save_stats.stall_ns += stall;
+            if (stall > g->save_stats.max_stall_ns)
+            {
+                g->save_stats.max_stall_ns = stall;
+            }
+            break;
+        }
+        }
+    }
+    else if (g->state == 2)
+    {
+        if (ch == 'r')
+        {
+            g->state = 0;
+            refresh_leaderboard(g);
+        }
+        else if (ch == 'q')
+        {
+            g->running = 0;
+        }
+    }
+}
+
+// Teclas de la partida que modifican el mundo. Es lo unico que hace falta repetir para
+// reproducir una partida: guardar o salir no cambian la simulacion
+int play_key(World *w, int ch)
+{
+    switch (ch)
+    {
+    case 'a':
+    case KEY_LEFT:
+        move_player(w, DIR_LEFT);
+        return 1;
+    case 'd':
+    case KEY_RIGHT:
+        move_player(w, DIR_RIGHT);
+        return 1;
+    case ' ':
+        shoot(w);
+        return 1;
+    }
+    return 0;
+}
+
+void end_recording(GameState *g)
+{
+    replay_end_game(&g->recorder, g->world.tick, g->world.score, g->world.hp, sim_rng_digest(&g->world));
+}
+
+// Una partida cargada no se puede reconstruir con una semilla, asi que se graba su instantanea
+void record_loaded_game(GameState *g)
+{
+    if (!g->recorder.writing)
+    {
+        return;
+    }
+    size_t size = sim_snapshot_size(&g->world);
+    void *buffer = malloc(size);
+    if (buffer != NULL)
+    {
+        sim_snapshot(&g->world, buffer);
+        replay_loaded_game(&g->recorder, g->world.tick, buffer, size);
+        free(buffer);
+    }
+}
+
+// Las partidas cargadas cuentan como una sola partida: se registran al terminar, con los
+// ticks desde el inicio original
+void record_run(GameState *g)
+{
+    if (g->leaderboard == NULL)
+    {
+        return;
+    }
+    g->last_rank = leaderboard_add(g->leaderboard, g->world.score, g->world.tick);
+    refresh_leaderboard(g);
+}
+
+// La mejor puntuacion sale de la tabla y no del registro de partida que se cargo. En el modo
+// anfitrion la tabla es compartida, asi que otra sesion pudo haberla cambiado
+void refresh_leaderboard(GameState *g)
+{
+    if (g->leaderboard == NULL)
+    {
+        return;
+    }
+    g->runs = leaderboard_count(g->leaderboard);
+    g->top_count = leaderboard_top(g->leaderboard, LEADERBOARD_SHOWN, g->top);
+    if (g->top_count > 0 && g->top[0].score > g->high_score)
+    {
+        g->high_score = g->top[0].score;
+    }
+    g->screen_serial++;
+}
+
+#pragma endregion
+
+#pragma region CUADROS_PUBLICADOS
+static int entities_alloc(FrameEntities *fe, const EntityColumns *c)
+{
+    fe->count = 0;
+    fe->id = malloc(c->capacity * sizeof(int));
+    fe->x = malloc(c->capacity * sizeof(int));
+    fe->y = malloc(c->capacity * sizeof(int));
+    fe->type = c->type != NULL ? malloc(c->capacity) : NULL;
+    return fe->id == NULL || fe->x == NULL || fe->y == NULL || (c->type != NULL && fe->type == NULL) ? -1 : 0;
+}
+
+static void entities_free(FrameEntities *fe)
+{
+    free(fe->id);
+    free(fe->x);
+    free(fe->y);
+    free(fe->type);
+}
+
+// Las entidades vivas son densas, asi que copiarlas son tres o cuatro memcpy por clase
+static void entities_copy(FrameEntities *fe, const EntityColumns *c)
+{
+    fe->count = c->count;
+    memcpy(fe->id, c->id, c->count * sizeof(int));
+    memcpy(fe->x, c->x, c->count * sizeof(int));
+    memcpy(fe->y, c->y, c->count * sizeof(int));
+    if (fe->type != NULL)
+    {
+        memcpy(fe->type, c->type, c->count);
+    }
+}
+
+int frame_alloc(Frame *f, const World *w)
+{
+    memset(f, 0, sizeof(*f));
+    if (entities_alloc(&f->projectiles, &w->projectiles) != 0 || entities_alloc(&f->enemies, &w->enemies) != 0 ||
+        entities_alloc(&f->boss_projectiles, &w->boss_projectiles) != 0)
+    {
+        frame_free(f);
+        return -1;
+    }
+    return 0;
+}
+
+void frame_free(Frame *f)
+{
+    entities_free(&f->projectiles);
+    entities_free(&f->enemies);
+    entities_free(&f->boss_projectiles);
+    memset(f, 0, sizeof(*f));
+}
+
+// Solo se copia lo que muestra la pantalla del estado actual: las entidades en la partida y
+// la pagina del menu en el menu de carga
+void capture_frame(GameState *g, Frame *f)
 {
-    for (int i = 0; i < size; i++)
+    f->tick = g->world.tick;
+    f->state = g->state;
+    f->screen = g->screen_serial;
+    f->rows = g->world.rows;
+    f->cols = g->world.cols;
+    f->hp = g->world.hp;
+    f->score = g->world.score;
+    f->high_score = g->high_score;
+    f->show_profile = g->show_profile;
+    f->rank = g->last_rank;
+    f->runs = g->runs;
+    f->top_count = g->top_count;
+    for (int k = 0; k < g->top_count; k++)
+    {
+        f->top[k] = g->top[k].score;
+    }
+    if (g->state == 1)
     {
-        if(boss_projectile.x == ship_parts[i].y && boss_projectile.y == ship_parts[i].x)
+        f->player = g->world.player;
+        f->boss = g->world.boss;
+        entities_copy(&f->projectiles, &g->world.projectiles);
+        entities_copy(&f->enemies, &g->world.enemies);
+        entities_copy(&f->boss_projectiles, &g->world.boss_projectiles);
+    }
+    else if (g->state == 3)
+    {
+        f->menu_total = g->slot_store.used;
+        f->menu_page = g->menu_page;
+        f->menu_pages = g->menu_pages;
+        f->menu_games = g->menu_games;
+        f->menu_invalid = g->menu_invalid;
+        for (int k = 0; k < g->menu_games; k++)
         {
-            return 1;
+            f->menu[k] = g->saved_games[g->menu_slots[k]];
         }
     }
+}
+
+// En la partida se publica un cuadro por iteracion del bucle; las pantallas estaticas solo
+// cuando cambian, asi el hilo de dibujo no se despierta en el menu para no hacer nada
+void publish_frame(GameState *g)
+{
+    if (g->state != 1 && g->state == g->published_state && g->screen_serial == g->published_screen)
+    {
+        return;
+    }
+    capture_frame(g, &g->frames[frame_buffer_write_slot(&g->frame_buffer)]);
+    frame_buffer_publish(&g->frame_buffer);
+    if (g->broadcast_path != NULL)
+    {
+        capture_frame(g, &g->spectate_frames[frame_buffer_write_slot(&g->spectate_buffer)]);
+        frame_buffer_publish(&g->spectate_buffer);
+    }
+    g->published_state = g->state;
+    g->published_screen = g->screen_serial;
+}
 
-    return 0;
+// El codificador lee las columnas del cuadro sin copiarlas. Fuera de la partida no hay entidades
+void frame_view(const Frame *f, SpectateFrame *v)
+{
+    const FrameEntities *e[SPECTATE_CLASSES] = {&f->projectiles, &f->enemies, &f->boss_projectiles};
+    v->tick = f->tick;
+    v->state = f->state;
+    v->rows = f->rows;
+    v->cols = f->cols;
+    v->hp = f->hp;
+    v->score = f->score;
+    v->high_score = f->high_score;
+    v->player_x = f->player.x;
+    v->player_y = f->player.y;
+    v->boss_active = f->boss.is_active;
+    v->boss_x = f->boss.pos.x;
+    v->boss_y = f->boss.pos.y;
+    v->boss_hp = f->boss.hp;
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        int playing = f->state == 1;
+        v->entities[c] = (SpectateEntities){playing ? e[c]->count : 0, e[c]->id, e[c]->x, e[c]->y, e[c]->type};
+    }
 }
 
 #pragma endregion
 
 #pragma region FUNCIONES_DE_DIBUJO
-// Dibuja los bordes de la pantalla
-void draw_borders()
+// Dibuja la pantalla del estado del cuadro. La partida se dibuja en cada cuadro; las
+// pantallas de inicio, fin y carga son estaticas y solo se dibujan cuando cambian
+void draw_frame(GameState *g, const Frame *f)
 {
-    for (int i = 0; i < COLS; i++)
+    if (f->state == 1)
+    {
+        draw_game(g, f);
+        return;
+    }
+    if (f->state == g->drawn_state && f->screen == g->drawn_screen)
     {
-        mvprintw(0, i, "#");
-        mvprintw(2, i, "-");
-        mvprintw(LINES - 1, i, "#");
+        return;
+    }
+    if (f->state == 0)
+    {
+        draw_start_screen(f);
+    }
+    else if (f->state == 2)
+    {
+        draw_game_over_screen(f);
     }
-    for (int i = 0; i < LINES; i++)
+    else if (f->state == 3)
     {
-        mvprintw(i, 0, "#");
-        mvprintw(i, COLS - 1, "#");
+        display_games(f);
     }
+    g->drawn_state = f->state;
+    g->drawn_screen = f->screen;
 }
 
-void draw_ship(int x, int y)
+// Dibuja un cuadro de la partida con el estado copiado en f
+void draw_game(GameState *g, const Frame *f)
 {
+    long t = prof_begin();
+    // Los bordes y el fondo se dibujan una sola vez al entrar a la partida
+    if (g->drawn_state != 1 || render_needs_reset())
+    {
+        render_reset();
+        g->drawn_state = 1;
+    }
+    render_begin_frame(); // Borra las entidades del cuadro anterior
 
-    // Dibujar la nave con colores
-    attron(COLOR_PAIR(1)); // Aplicar color azul
-    mvprintw(y, x, "A");
-    attroff(COLOR_PAIR(1)); // Desactivar color azul
-
-    attron(COLOR_PAIR(2)); // Aplicar color magenta
-    mvprintw(y + 1, x - 1, "MTM");
-    mvprintw(y + 2, x - 2, "WTTTW");
-    attroff(COLOR_PAIR(2)); // Desactivar color magenta
-
-    attron(COLOR_PAIR(1)); // Aplicar color azul
-    mvprintw(y + 3, x - 4, "TTTTHTTTT");
-    mvprintw(y + 4, x - 2, "UUUUU");
-    attroff(COLOR_PAIR(1)); // Desactivar color azul
+    if (f->boss.is_active)
+    {
+        draw_boss(f->boss.pos.x, f->boss.pos.y);
+    }
 
-    // Actualizar la pantalla para mostrar cambios
-    refresh();
+    draw_ship(f->player.x, f->player.y); // Dibuja al jugador
 
-    // Esperar entrada del usuario para salir
-    getch();
+    // El HUD solo se redibuja cuando cambia algun valor
+    render_hud(f->hp, f->score, f->high_score, f->boss.is_active, f->boss.hp);
 
-    // Finalizar ncurses
-    endwin();
+    const FrameEntities *p = &f->projectiles, *e = &f->enemies, *bp = &f->boss_projectiles;
+    for (int i = 0; i < p->count; i++)
+    {
+        render_text(p->y[i], p->x[i], "|", 0);
+    }
+    for (int i = 0; i < e->count; i++)
+    {
+        draw_enemy(e->x[i], e->y[i], e->type[i]);
+    }
+    for (int i = 0; i < bp->count; i++)
+    {
+        render_text(bp->y[i], bp->x[i], "U", 0);
+    }
+    if (f->show_profile)
+    {
+        draw_profile_overlay(g);
+    }
+    prof_end(PROF_DRAW, t);
+    render_end_frame(); // Envia solo las celdas que cambiaron y actualiza la pantalla
 }
 
-// Dibuja un enemigo según su tipo
-void draw_enemy(int x, int y, int type)
+// El overlay se compone como una entidad mas, asi que el renderizador lo borra solo cuando
+// se apaga. Los valores se recalculan una vez por segundo para que se puedan leer
+void draw_profile_overlay(GameState *g)
 {
-    switch (type)
+    char (*lines)[PROFILE_COLS + 1] = g->profile_lines;
+
+    if (g->profile_frames++ % (1000000 / DELAY) == 0)
+    {
+        snprintf(lines[0], sizeof(lines[0]), "%-23s %6s %6s %5s", "phase (us)", "avg", "max", "n");
+        for (int p = 0; p < PROF_PHASES; p++)
+        {
+            long count;
+            double avg_us, max_us;
+            prof_window(p, &count, &avg_us, &max_us);
+            snprintf(lines[p + 1], sizeof(lines[p + 1]), "%-23s %6.0f %6.0f %5ld", prof_phase_name(p), avg_us,
+                     max_us, count);
+        }
+    }
+    for (int p = 0; p <= PROF_PHASES; p++)
     {
-    case 0:
-        attron(COLOR_PAIR(3));
-        mvprintw(y, x - 2, " (@@) ");
-        mvprintw(y + 1, x - 2, " /\"\"\\ ");
-        attroff(COLOR_PAIR(3));
-        break;
-    case 1:
-        attron(COLOR_PAIR(5));
-        mvprintw(y, x - 2, " dOOb ");
-        mvprintw(y + 1, x - 2, " ^/\\^ ");
-        attroff(COLOR_PAIR(5));
-        break;
-    case 2:
-        attron(COLOR_PAIR(4));
-        mvprintw(y, x - 2, " /MM\\ ");
-        mvprintw(y + 1, x - 2, " |~~| ");
-        attroff(COLOR_PAIR(4));
-        break;
+        render_text(3 + p, term_cols() - PROFILE_COLS - 2, lines[p], 0);
     }
 }
 
+// Dibuja los bordes de la pantalla. El renderizador los compone una sola vez en su capa
+// de fondo, por lo que esta funcion solo fuerza ese redibujado completo
+void draw_borders()
+{
+    render_reset();
+}
+
 #pragma endregion
 
-#pragma region FUNCIONES_PUNTUACION_INICIO_FIN
-// Actualiza la puntuación basada en el tipo de enemigo derrotado
-void update_score(int type)
+#pragma region FUNCIONES_INICIO_FIN
+// Reporta cuantas celdas se enviaron por cuadro frente a un redibujado completo y, con el
+// backend ANSI, cuantos bytes costo cada cuadro
+void print_render_stats()
 {
-    switch (type)
+    RenderStats rs = render_stats();
+    if (rs.frames > 0)
     {
-    case 0:
-        score += 30;
-        break;
-    case 1:
-        score += 20;
-        break;
-    case 2:
-        score += 10;
-        break;
-    case 3:
-        score += 50;
-        break;
+        printf("frames: %ld, changed cells/frame: avg %.1f, max %d (full screen %d)\n",
+               rs.frames, (double)rs.changed_cells / rs.frames, rs.max_changed, rs.screen_cells);
+    }
+    if (rs.frames > 0 && rs.bytes > 0)
+    {
+        printf("terminal: %ld bytes, %.1f bytes/frame\n", rs.bytes, (double)rs.bytes / rs.frames);
     }
 }
 
 // Muestra la pantalla de inicio con instrucciones para comenzar o salir
-void draw_start_screen()
+void draw_start_screen(const Frame *f)
 {
-    clear();
-    attron(COLOR_PAIR(1));
-    mvprintw(LINES / 2 - 2, COLS / 2 - 10, "Space Shooter Game");
-    attroff(COLOR_PAIR(1));
-    mvprintw(LINES / 2, COLS / 2 - 10, "Press 'n' to Start New Game");
-    mvprintw(LINES / 2 + 1, COLS / 2 - 10, "Press 'q' to Quit");
-    mvprintw(LINES / 2 + 2, COLS / 2 - 10, "High Score: %d", high_score);
-    mvprintw(LINES / 2 + 3, COLS / 2 - 10, "Press 'l' to Load Games");
-    refresh();
+    int y = term_rows() / 2, x = term_cols() / 2 - 10;
+    term_clear();
+    term_print(y - 2, x, COLOR_PAIR(1), "Space Shooter Game");
+    term_print(y, x, 0, "Press 'n' to Start New Game");
+    term_print(y + 1, x, 0, "Press 'q' to Quit");
+    term_print(y + 2, x, 0, "High Score: %d", f->high_score);
+    term_print(y + 3, x, 0, "Press 'l' to Load Games");
+    if (f->top_count > 0)
+    {
+        term_print(y + 5, x, COLOR_PAIR(5), "Top Scores (%ld runs)", f->runs);
+    }
+    for (int k = 0; k < f->top_count; k++)
+    {
+        term_print(y + 6 + k, x, 0, "%d. %d", k + 1, f->top[k]);
+    }
+    term_flush();
 }
 
 // Muestra la pantalla de fin del juego con puntuación y opciones
-void draw_game_over_screen()
+void draw_game_over_screen(const Frame *f)
 {
-    clear();
-    attron(COLOR_PAIR(4));
-    mvprintw(LINES / 2 - 2, COLS / 2 - 10, "Game Over");
-    attroff(COLOR_PAIR(4));
-    mvprintw(LINES / 2, COLS / 2 - 10, "Press 'r' to Return to Start Screen");
-    mvprintw(LINES / 2 + 1, COLS / 2 - 10, "Press 'q' to Quit");
-    mvprintw(LINES / 2 + 2, COLS / 2 - 10, "Score: %d", score);
-    mvprintw(LINES / 2 + 3, COLS / 2 - 10, "High Score: %d", high_score);
-    refresh();
+    int y = term_rows() / 2, x = term_cols() / 2 - 10;
+    term_clear();
+    term_print(y - 2, x, COLOR_PAIR(4), "Game Over");
+    term_print(y, x, 0, "Press 'r' to Return to Start Screen");
+    term_print(y + 1, x, 0, "Press 'q' to Quit");
+    term_print(y + 2, x, 0, "Score: %d", f->score);
+    term_print(y + 3, x, 0, "High Score: %d", f->high_score);
+    if (f->rank > 0)
+    {
+        term_print(y + 4, x, 0, "Rank: %ld of %ld", f->rank, f->runs);
+    }
+    term_flush();
 }
 
 #pragma endregion
 
 #pragma region FUNCIONES_GUARDADO_Y_CARGA
-void save_game(const char *filename, Saved_Games *saved_games)
+size_t save_record_size(GameState *g)
 {
-    FILE *file = fopen(filename, "wb"); // Abre el archivo en modo append binario
-    if (file == NULL)
+    return sizeof(Saved_Games) + sim_snapshot_size(&g->world);
+}
+
+// Guarda una partida en su registro. Cada registro es un Saved_Games de games seguido de una
+// instantanea del mundo; se guarda world (de sim_snapshot) y, si es NULL, se conserva la
+// instantanea que ya tenia el registro. Solo se escribe ese registro, en su lugar. Si el
+// archivo no existe, no es valido o tiene otra capacidad, primero se recrea completo. Corre
+// en el hijo o en el hilo de guardado, que no escriben en la terminal: las fallas solo se
+// cuentan. De g solo lee la capacidad, que no cambia durante la partida
+int save_game(GameState *g, const char *filename, int slot, const Saved_Games *games, const void *world)
+{
+    size_t record_size = save_record_size(g), world_size = record_size - sizeof(Saved_Games);
+    unsigned char *record = calloc(1, record_size);
+    SaveFile file;
+    int status = -1;
+
+    if (record == NULL)
+    {
+        return -1;
+    }
+
+    if (save_file_open(&file, filename, record_size) != 0 || file.slots != (uint32_t)g->save_slots)
+    {
+        save_file_close(&file);
+        if (rebuild_save_file(g, filename, games) != 0 ||
+            save_file_open(&file, filename, record_size) != 0)
+        {
+            free(record);
+            return -1;
+        }
+    }
+
+    const unsigned char *old = save_file_record(&file, slot);
+    memcpy(record, &games[slot], sizeof(Saved_Games));
+    if (world != NULL)
+    {
+        memcpy(record + sizeof(Saved_Games), world, world_size);
+    }
+    else if (old != NULL)
+    {
+        memcpy(record + sizeof(Saved_Games), old + sizeof(Saved_Games), world_size);
+    }
+
+    status = save_file_write(&file, slot, record);
+    save_file_close(&file);
+    free(record);
+    return status;
+}
+
+// Crea el archivo con save_slots registros a partir de los metadatos de games. Las
+// instantaneas del archivo anterior se conservan en la misma posicion si tiene el formato
+// actual, aunque su capacidad sea otra
+int rebuild_save_file(GameState *g, const char *filename, const Saved_Games *games)
+{
+    size_t record_size = save_record_size(g);
+    unsigned char *records = calloc(g->save_slots, record_size);
+    unsigned char *used = calloc(g->save_slots, 1);
+    SaveFile old;
+    int have_old = save_file_open(&old, filename, record_size) == 0;
+    int status = -1;
+
+    if (records != NULL && used != NULL)
+    {
+        for (int i = 0; i < g->save_slots; i++)
+        {
+            unsigned char *record = records + i * record_size;
+            const unsigned char *previous = have_old ? save_file_record(&old, i) : NULL;
+            if (previous != NULL)
+            {
+                memcpy(record, previous, record_size);
+            }
+            memcpy(record, &games[i], sizeof(Saved_Games));
+            used[i] = games[i].lru > 0;
+        }
+        status = save_file_create(filename, g->save_slots, record_size, records, used);
+    }
+    save_file_close(&old);
+    free(records);
+    free(used);
+    return status;
+}
+
+// Guarda en un proceso hijo creado con fork. El hijo ve una copia copy-on-write de saved_games
+// y de la instantanea del mundo tal como estaban en el fork, asi que el hilo del juego sigue
+// simulando sin esperar al disco. Solo hay un hijo a la vez: si el anterior sigue escribiendo
+// el guardado queda pendiente (uno solo, los siguientes lo reemplazan) y reap_save_child lo
+// lanza al recogerlo. La instantanea se toma ahora, asi el pendiente guarda el mundo de este
+// momento aunque la partida termine antes
+void save_game_async(GameState *g, int slot, int with_world)
+{
+    if (g->save_queue != NULL)
+    {
+        save_queue_push(g, slot, with_world);
+        return;
+    }
+    size_t world_size = save_record_size(g) - sizeof(Saved_Games);
+    if (with_world && g->save_world == NULL && (g->save_world = malloc(world_size)) == NULL)
+    {
+        g->save_stats.failed++;
+        return;
+    }
+    if (with_world)
+    {
+        sim_snapshot(&g->world, g->save_world);
+    }
+    g->save_pending = slot;
+    g->save_pending_world = with_world;
+    if (g->save_child == -1)
+    {
+        start_pending_save(g);
+    }
+}
+
+void start_pending_save(GameState *g)
+{
+    int slot = g->save_pending;
+    const void *world = g->save_pending_world ? g->save_world : NULL;
+    g->save_pending = -1;
+
+    pid_t pid = fork();
+    if (pid == 0)
     {
-        perror("Error opening file for writing");
+        // El hijo no toca la terminal ni ejecuta los atexit del padre
+        _exit(save_game(g, g->save_path, slot, g->saved_games, world) == 0 ? 0 : 1);
+    }
+    if (pid < 0)
+    {
+        // Sin fork se guarda en el momento
+        if (save_game(g, g->save_path, slot, g->saved_games, world) != 0)
+        {
+            g->save_stats.failed++;
+        }
+        return;
+    }
+    g->save_child = pid;
+    g->save_child_start = input_now_ns();
+}
+
+// Con block espera tambien al guardado pendiente: al salir o al cargar no queda nada sin escribir
+void reap_save_child(GameState *g, int block)
+{
+    int status;
+    if (g->save_queue != NULL)
+    {
+        if (block)
+        {
+            save_queue_wait(g);
+        }
         return;
     }
+    while (g->save_child != -1 && waitpid(g->save_child, &status, block ? 0 : WNOHANG) == g->save_child)
+    {
+        long elapsed = input_now_ns() - g->save_child_start;
+        g->save_stats.writes++;
+        g->save_stats.write_ns += elapsed;
+        if (elapsed > g->save_stats.max_write_ns)
+        {
+            g->save_stats.max_write_ns = elapsed;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            g->save_stats.failed++;
+        }
+        g->save_child = -1;
+        if (g->save_pending != -1)
+        {
+            start_pending_save(g);
+        }
+    }
+}
 
-    size_t written = fwrite(saved_games, sizeof(Saved_Games), MAX_SAVED_GAMES, file);
-    if (written != 1)
+int save_queue_start(SaveQueue *q, int capacity)
+{
+    memset(q, 0, sizeof(*q));
+    q->capacity = capacity;
+    q->ring = malloc(capacity * sizeof(GameState *));
+    if (q->ring == NULL)
+    {
+        return -1;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->wake, NULL);
+    pthread_cond_init(&q->done, NULL);
+    if (pthread_create(&q->thread, NULL, save_queue_loop, q) != 0)
     {
-        perror("Error writing to file");
+        pthread_cond_destroy(&q->done);
+        pthread_cond_destroy(&q->wake);
+        pthread_mutex_destroy(&q->lock);
+        free(q->ring);
+        return -1;
     }
+    return 0;
+}
 
-    fclose(file);
+void save_queue_stop(SaveQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->stopping = 1;
+    pthread_cond_signal(&q->wake);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);
+    pthread_cond_destroy(&q->done);
+    pthread_cond_destroy(&q->wake);
+    pthread_mutex_destroy(&q->lock);
+    free(q->ring);
+    free(q->world);
+    free(q->games);
 }
 
-int load_games(const char *filename, Saved_Games saved_games[MAX_SAVED_GAMES], int max_games)
+// Toma la instantanea y los metadatos con el mutex, porque el hilo de guardado puede estar
+// copiando el guardado anterior de esta partida; si ya estaba en la cola solo se reemplaza
+void save_queue_push(GameState *g, int slot, int with_world)
 {
-    FILE *file = fopen(filename, "rb");
-    if (file == NULL)
+    SaveQueue *q = g->save_queue;
+    size_t world_size = save_record_size(g) - sizeof(Saved_Games);
+    if ((g->save_world == NULL && (g->save_world = malloc(world_size)) == NULL) ||
+        (g->save_games == NULL && (g->save_games = malloc(g->save_slots * sizeof(Saved_Games))) == NULL))
     {
-        perror("Error opening file for reading");
-        return 0;
+        pthread_mutex_lock(&q->lock);
+        g->save_stats.failed++;
+        pthread_mutex_unlock(&q->lock);
+        return;
     }
+    pthread_mutex_lock(&q->lock);
+    if (with_world)
+    {
+        sim_snapshot(&g->world, g->save_world);
+    }
+    memcpy(g->save_games, g->saved_games, g->save_slots * sizeof(Saved_Games));
+    g->save_pending = slot;
+    g->save_pending_world = with_world;
+    if (!g->save_queued)
+    {
+        q->ring[(q->head + q->count) % q->capacity] = g;
+        q->count++;
+        g->save_queued = 1;
+        pthread_cond_signal(&q->wake);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
 
-    size_t read = fread(saved_games, sizeof(Saved_Games), max_games, file);
-    if (ferror(file))
+// Espera a que se escriba el guardado pendiente de g, si tiene uno
+void save_queue_wait(GameState *g)
+{
+    SaveQueue *q = g->save_queue;
+    pthread_mutex_lock(&q->lock);
+    while (g->save_queued || q->current == g)
     {
-        perror("Error reading from file");
+        pthread_cond_wait(&q->done, &q->lock);
     }
+    pthread_mutex_unlock(&q->lock);
+}
 
-    fclose(file);
+// Hilo de guardado. Copia el guardado pendiente de la primera partida de la cola, asi la
+// sesion puede pedir otro mientras este se escribe, y escribe el archivo sin el mutex. Al
+// detenerlo termina de vaciar la cola
+void *save_queue_loop(void *arg)
+{
+    SaveQueue *q = arg;
+    pthread_mutex_lock(&q->lock);
+    while (1)
+    {
+        while (q->count == 0 && !q->stopping)
+        {
+            pthread_cond_wait(&q->wake, &q->lock);
+        }
+        if (q->count == 0)
+        {
+            break;
+        }
+        GameState *g = q->ring[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        g->save_queued = 0;
+
+        size_t world_size = save_record_size(g) - sizeof(Saved_Games);
+        if (world_size > q->world_size)
+        {
+            free(q->world);
+            q->world = malloc(world_size);
+            q->world_size = q->world != NULL ? world_size : 0;
+        }
+        if (g->save_slots > q->game_slots)
+        {
+            free(q->games);
+            q->games = malloc(g->save_slots * sizeof(Saved_Games));
+            q->game_slots = q->games != NULL ? g->save_slots : 0;
+        }
+        int slot = g->save_pending, with_world = g->save_pending_world;
+        g->save_pending = -1;
+        if (q->world == NULL || q->games == NULL)
+        {
+            g->save_stats.failed++;
+            pthread_cond_broadcast(&q->done);
+            continue;
+        }
+        if (with_world)
+        {
+            memcpy(q->world, g->save_world, world_size);
+        }
+        memcpy(q->games, g->save_games, g->save_slots * sizeof(Saved_Games));
+        q->current = g;
+        pthread_mutex_unlock(&q->lock);
+
+        long begin = input_now_ns();
+        int status = save_game(g, g->save_path, slot, q->games, with_world ? q->world : NULL);
+        long elapsed = input_now_ns() - begin;
+
+        pthread_mutex_lock(&q->lock);
+        q->current = NULL;
+        g->save_stats.writes++;
+        g->save_stats.write_ns += elapsed;
+        if (elapsed > g->save_stats.max_write_ns)
+        {
+            g->save_stats.max_write_ns = elapsed;
+        }
+        g->save_stats.failed += status != 0;
+        pthread_cond_broadcast(&q->done);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+// stalled nombra a quien detiene cada guardado: el hilo del juego o la sesion del anfitrion
+void print_save_stats(const SaveStats *stats, const char *stalled)
+{
+    if (stats->saves == 0)
+    {
+        return;
+    }
+    printf("saves: %ld (%ld autosaves, %ld failed), %s stall avg %.1f us max %.1f us, "
+           "background write avg %.2f ms max %.2f ms\n",
+           stats->saves, stats->autosaves, stats->failed, stalled, stats->stall_ns / 1e3 / stats->saves,
+           stats->max_stall_ns / 1e3, stats->write_ns / 1e6 / (stats->writes ? stats->writes : 1),
+           stats->max_write_ns / 1e6);
+}
+
+// Restaura el mundo directamente desde el registro mapeado, sin copias intermedias
+int load_world(GameState *g, const char *filename, int slot)
+{
+    SaveFile file;
+    int restored = -1;
+
+    if (save_file_open(&file, filename, save_record_size(g)) == 0)
+    {
+        const unsigned char *record = save_file_record(&file, slot);
+        if (record != NULL &&
+            sim_restore(&g->world, record + sizeof(Saved_Games), sim_snapshot_size(&g->world)) == 0 &&
+            g->world.rows == term_rows() && g->world.cols == term_cols())
+        {
+            restored = 0;
+        }
+        save_file_close(&file);
+    }
+    return restored;
+}
+
+// Lee las partidas directamente del archivo mapeado. Los registros vacios o con checksum
+// invalido quedan en cero. Los archivos con registros de solo Saved_Games (sin instantanea)
+// y los del formato anterior (los structs sin cabecera) se importan y se convierten al
+// formato nuevo en el proximo guardado
+int load_games(GameState *g, const char *filename, Saved_Games games[], int max_games)
+{
+    SaveFile file;
+    memset(games, 0, max_games * sizeof(Saved_Games));
+
+    if (save_file_open(&file, filename, save_record_size(g)) == 0 ||
+        save_file_open(&file, filename, sizeof(Saved_Games)) == 0)
+    {
+        for (int i = 0; i < max_games; i++)
+        {
+            const void *record = save_file_record(&file, i);
+            if (record != NULL)
+            {
+                memcpy(&games[i], record, sizeof(Saved_Games));
+            }
+        }
+        save_file_close(&file);
+    }
+    else
+    {
+        load_legacy_games(filename, games, max_games);
+    }
 
     int cant_games = 0;
     for (int i = 0; i < max_games; i++)
     {
-        cant_games += saved_games[i].lru > 0;
+        cant_games += games[i].lru > 0;
     }
 
     return cant_games;
 }
 
-void display_games(Saved_Games saved_games[], int num_games)
+// Se llama una sola vez al iniciar. La capacidad es la mayor entre --slots y la del archivo
+// para no perder partidas; a partir de aqui el menu y los guardados usan solo el indice en
+// memoria y el archivo ya no se vuelve a leer entero
+int load_save_index(GameState *g, const char *filename)
+{
+    SaveFile file;
+    if (save_file_open(&file, filename, save_record_size(g)) == 0 ||
+        save_file_open(&file, filename, sizeof(Saved_Games)) == 0)
+    {
+        g->save_slots = (int)file.slots > g->save_slots ? (int)file.slots : g->save_slots;
+        save_file_close(&file);
+    }
+    g->save_slots = g->save_slots < LEGACY_SAVED_GAMES ? LEGACY_SAVED_GAMES : g->save_slots;
+
+    int *lru = malloc(g->save_slots * sizeof(int));
+    g->saved_games = calloc(g->save_slots, sizeof(Saved_Games));
+    if (lru == NULL || g->saved_games == NULL || slot_store_init(&g->slot_store, g->save_slots) != 0)
+    {
+        free(lru);
+        return -1;
+    }
+
+    load_games(g, filename, g->saved_games, g->save_slots);
+    for (int i = 0; i < g->save_slots; i++)
+    {
+        lru[i] = g->saved_games[i].lru;
+    }
+    slot_store_load(&g->slot_store, lru);
+    free(lru);
+    return 0;
+}
+
+void load_legacy_games(const char *filename, Saved_Games games[], int max_games)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0 || st.st_size != LEGACY_SAVED_GAMES * sizeof(Saved_Games))
+    {
+        return;
+    }
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        perror("Error opening file for reading");
+        return;
+    }
+    if (fread(games, sizeof(Saved_Games), min(max_games, LEGACY_SAVED_GAMES), file) == 0)
+    {
+        perror("Error reading from file");
+    }
+    fclose(file);
+}
+
+// Elige las partidas de la pagina actual del menu de carga, de la usada mas recientemente a
+// la menos usada. Solo se recorre el indice en memoria hasta la pagina pedida
+void select_menu_page(GameState *g)
+{
+    int page_size = min(MENU_PAGE_MAX, term_rows() - 6);
+    page_size = page_size < 1 ? 1 : page_size;
+    g->menu_pages = g->slot_store.used > 0 ? (g->slot_store.used + page_size - 1) / page_size : 1;
+
+    int slot = g->slot_store.head;
+    for (int k = 0; k < g->menu_page * page_size && slot != -1; k++)
+    {
+        slot = g->slot_store.next[slot];
+    }
+
+    g->menu_games = 0;
+    for (; slot != -1 && g->menu_games < page_size; slot = g->slot_store.next[slot])
+    {
+        g->menu_slots[g->menu_games++] = slot;
+    }
+    g->menu_invalid = 0;
+    g->screen_serial++;
+}
+
+// Muestra la pagina del menu de carga copiada en el cuadro
+void display_games(const Frame *f)
 {
-    clear();
-    int row = 2; // Iniciar en la fila 2 para dejar espacio para el encabezado
-    for (int i = 0; i < num_games; i++)
+    term_clear();
+    term_print(1, 2, 0, "Saved games: %d (page %d of %d)", f->menu_total, f->menu_page + 1, f->menu_pages);
+
+    int row = 3; // Iniciar en la fila 3 para dejar espacio para el encabezado
+    for (int k = 0; k < f->menu_games; k++)
+    {
+        term_print(row++, 2, 0, "%d. Score: %d   High Score: %d   Health Points: %d", k + 1, f->menu[k].score,
+                   f->menu[k].high_score, f->menu[k].health_points);
+    }
+    term_print(term_rows() - 2, 2, 0, "Select a game to load (1 to %d), 'n'/'p' next/previous page, 'q' back: ",
+               f->menu_games);
+    if (f->menu_invalid)
     {
-        mvprintw(row, 2, "Game %d:", i + 1);
-        mvprintw(row + 1, 4, "High Score: %d", saved_games[i].high_score);
-        mvprintw(row + 2, 4, "LRU: %d", saved_games[i].lru);
-        mvprintw(row + 3, 4, "Health Points: %d", saved_games[i].health_points);
-        mvprintw(row + 4, 4, "Score: %d", saved_games[i].score);
-        row += 6; // Saltar 6 filas entre juegos para dejar espacio
+        term_print(term_rows() - 1, 2, 0, "Invalid selection. Please try again.");
     }
-    refresh();
+    term_flush();
 }
 #pragma endregion
\ No newline at end of file
@@ -1 +1,25 @@
-gcc main.c -o space_game -lpthread -lncurses
+# Uso: make -f makefile.mk [space_game | bench | clean]
+CC = gcc
+CFLAGS ?= -O2 -g -Wall -Wno-unknown-pragmas
+LDLIBS = -lpthread -lncurses -lm
+
+GAME_OBJS = main.o sprites.o sprite_atlas.o boss_patterns.o sim.o render.o term.o game_clock.o input_queue.o save_file.o slot_store.o replay.o rng.o workpool.o profiler.o frame_buffer.o spectate.o leaderboard.o
+BENCH_OBJS = bench.o sprites.o sprite_atlas.o boss_patterns.o sim.o render.o term.o rng.o profiler.o
+
+space_game: $(GAME_OBJS)
+	$(CC) $(CFLAGS) $(GAME_OBJS) -o $@ $(LDLIBS)
+
+bench_game: $(BENCH_OBJS)
+	$(CC) $(CFLAGS) $(BENCH_OBJS) -o $@ $(LDLIBS)
+
+# Microbenchmarks de las funciones calientes, p. ej. make -f makefile.mk bench BENCH_ARGS="--csv"
+bench: bench_game
+	./bench_game $(BENCH_ARGS)
+
+%.o: %.c $(wildcard *.h)
+	$(CC) $(CFLAGS) -c $< -o $@
+
+clean:
+	rm -f *.o bench_game
+
+.PHONY: bench clean
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <time.h>
+#include "profiler.h"
+
+int prof_enabled = 0;
+
+static ProfRing *rings[PROF_MAX_THREADS]; // Buffers registrados
+static atomic_int ring_count;
+static _Thread_local ProfRing *thread_ring; // Buffer del hilo actual (NULL si no se registro)
+static ProfPhase phases[PROF_PHASES];
+
+// Totales en la lectura anterior del overlay (solo los usa el hilo que llama a prof_window)
+static long window_total_ns[PROF_PHASES], window_count[PROF_PHASES];
+
+static const char *phase_names[PROF_PHASES] = {
+    "frame", "clock wait", "input drain", "update_projectiles", "update_boss_projectiles",
+    "update_enemies", "run_spawns", "check_collisions", "update_boss", "draw", "flush", "refresh", "input read",
+    "publish", "broadcast",
+};
+
+#pragma region FUNCIONES_DEL_PERFILADOR
+long prof_now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+void prof_thread_init(const char *name)
+{
+    int slot = atomic_fetch_add(&ring_count, 1);
+    if (slot >= PROF_MAX_THREADS)
+    {
+        return; // Sin lugar: el hilo solo suma a los totales del overlay
+    }
+    ProfRing *r = aligned_alloc(64, sizeof(ProfRing));
+    if (r != NULL)
+    {
+        atomic_init(&r->head, 0);
+        r->name = name;
+    }
+    rings[slot] = r;
+    thread_ring = r;
+}
+
+void prof_free()
+{
+    int threads = atomic_load(&ring_count);
+    for (int t = 0; t < threads && t < PROF_MAX_THREADS; t++)
+    {
+        free(rings[t]);
+        rings[t] = NULL;
+    }
+    atomic_store(&ring_count, 0);
+}
+
+void prof_record(int phase, long start_ns)
+{
+    long dur = prof_now_ns() - start_ns;
+    ProfPhase *p = &phases[phase];
+
+    atomic_fetch_add_explicit(&p->total_ns, dur, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->count, 1, memory_order_relaxed);
+    long max = atomic_load_explicit(&p->window_max_ns, memory_order_relaxed);
+    while (dur > max && !atomic_compare_exchange_weak_explicit(&p->window_max_ns, &max, dur, memory_order_relaxed,
+                                                                memory_order_relaxed))
+    {
+    }
+
+    ProfRing *r = thread_ring;
+    if (r != NULL)
+    {
+        unsigned long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        ProfEvent *ev = &r->events[head & (PROF_RING_SIZE - 1)];
+        ev->start_ns = start_ns;
+        ev->dur_ns = (int)dur;
+        ev->phase = phase;
+        atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    }
+}
+
+const char *prof_phase_name(int phase)
+{
+    return phase_names[phase];
+}
+
+// Promedio y maximo de la fase desde la llamada anterior para la misma fase
+void prof_window(int phase, long *count, double *avg_us, double *max_us)
+{
+    ProfPhase *p = &phases[phase];
+    long total = atomic_load_explicit(&p->total_ns, memory_order_relaxed);
+    long n = atomic_load_explicit(&p->count, memory_order_relaxed);
+
+    *count = n - window_count[phase];
+    *avg_us = *count > 0 ? (total - window_total_ns[phase]) / 1e3 / *count : 0;
+    *max_us = atomic_exchange_explicit(&p->window_max_ns, 0, memory_order_relaxed) / 1e3;
+    window_total_ns[phase] = total;
+    window_count[phase] = n;
+}
+
+// Cada evento es una fase completa ("ph":"X") con inicio y duracion en microsegundos
+// desde el primer evento guardado; cada buffer es un hilo ("tid") con su nombre
+int prof_export_chrome(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    int threads = atomic_load(&ring_count);
+    threads = threads < PROF_MAX_THREADS ? threads : PROF_MAX_THREADS;
+    long origin = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        ProfRing *r = rings[t];
+        unsigned long head = r ? atomic_load_explicit(&r->head, memory_order_acquire) : 0;
+        unsigned long first = head > PROF_RING_SIZE ? head - PROF_RING_SIZE : 0;
+        if (head > first && (origin == 0 || r->events[first & (PROF_RING_SIZE - 1)].start_ns < origin))
+        {
+            origin = r->events[first & (PROF_RING_SIZE - 1)].start_ns;
+        }
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    int comma = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        ProfRing *r = rings[t];
+        if (r == NULL)
+        {
+            continue;
+        }
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                comma ? ",\n" : "", t + 1, r->name);
+        comma = 1;
+
+        unsigned long head = atomic_load_explicit(&r->head, memory_order_acquire);
+        for (unsigned long i = head > PROF_RING_SIZE ? head - PROF_RING_SIZE : 0; i < head; i++)
+        {
+            const ProfEvent *ev = &r->events[i & (PROF_RING_SIZE - 1)];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    phase_names[ev->phase], t + 1, (ev->start_ns - origin) / 1e3, ev->dur_ns / 1e3);
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
+#pragma endregion
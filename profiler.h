@@ -0,0 +1,78 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define PROF_RING_SIZE (1 << 16) // Eventos que guarda cada hilo (potencia de 2); se pisan los mas viejos
+#define PROF_MAX_THREADS 4       // Hilos que pueden registrarse en el perfilador
+
+// Fases medidas. PROF_FRAME envuelve a las demas fases del hilo del juego
+#define PROF_FRAME 0             // Cuadro completo del hilo del juego
+#define PROF_WAIT 1              // Espera del reloj de paso fijo
+#define PROF_INPUT 2             // Vaciado de la cola de entrada
+#define PROF_PROJECTILES 3       // update_projectiles
+#define PROF_BOSS_PROJECTILES 4  // update_boss_projectiles
+#define PROF_ENEMIES 5           // update_enemies
+#define PROF_SPAWNS 6            // run_spawns
+#define PROF_COLLISIONS 7        // check_collisions
+#define PROF_BOSS 8              // update_boss
+#define PROF_DRAW 9              // Hilo de dibujo: composicion del cuadro en el buffer del renderizador
+#define PROF_FLUSH 10            // Envio de las celdas cambiadas a ncurses
+#define PROF_REFRESH 11          // refresh()
+#define PROF_INPUT_READ 12       // Hilo de entrada: encolar una tecla leida
+#define PROF_PUBLISH 13          // Copia del cuadro que el hilo del juego publica para el de dibujo
+#define PROF_BROADCAST 14        // Hilo de transmision: codificar un cuadro y encolarlo a los espectadores
+#define PROF_PHASES 15
+
+// Evento de una fase: inicio y duracion en nanosegundos de CLOCK_MONOTONIC
+typedef struct
+{
+    long start_ns;
+    int dur_ns;
+    int phase;
+} ProfEvent;
+
+// Buffer circular de un hilo. Solo lo escribe su hilo, sin candados: el evento se guarda y
+// despues se publica avanzando head con release. Se lee al exportar, con los hilos detenidos
+typedef struct
+{
+    ProfEvent events[PROF_RING_SIZE];
+    _Alignas(64) atomic_ulong head; // Eventos escritos en total
+    const char *name;               // Nombre del hilo en la traza
+} ProfRing;
+
+// Totales de una fase sumando todos los hilos. Los lee el overlay mientras los hilos escriben
+typedef struct
+{
+    _Alignas(64) atomic_long total_ns;
+    atomic_long count;
+    atomic_long window_max_ns; // Mayor duracion desde la ultima lectura del overlay
+} ProfPhase;
+
+extern int prof_enabled; // 0 desactiva las mediciones (prof_begin devuelve 0)
+
+long prof_now_ns();                         // CLOCK_MONOTONIC en nanosegundos
+void prof_thread_init(const char *name);    // Asigna un buffer al hilo que llama
+void prof_free();                           // Libera los buffers (con los hilos ya detenidos)
+void prof_record(int phase, long start_ns); // Guarda una fase que empezo en start_ns y termina ahora
+const char *prof_phase_name(int phase);     // Nombre de la fase en el overlay y en la traza
+void prof_window(int phase, long *count, double *avg_us, double *max_us); // Medicion desde la llamada anterior
+int prof_export_chrome(const char *path);   // Escribe los buffers como trace_event JSON de Chrome, -1 si falla
+
+// Temporizador de una fase: t = prof_begin(); ...; prof_end(PROF_X, t). Si el perfilador
+// esta desactivado cuesta una comparacion
+static inline long prof_begin()
+{
+    return prof_enabled ? prof_now_ns() : 0;
+}
+
+static inline void prof_end(int phase, long start_ns)
+{
+    if (start_ns != 0)
+    {
+        prof_record(phase, start_ns);
+    }
+}
+
+#endif
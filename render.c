@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "term.h"
+#include "profiler.h"
+
+#pragma region ESTADO_DEL_RENDERIZADOR
+// Un tramo horizontal de celdas escrito durante un cuadro
+typedef struct
+{
+    int y, x, len;
+} Span;
+
+typedef struct
+{
+    Span *items;
+    int count, capacity;
+} SpanList;
+
+// El renderizador mantiene tres capas del tamaño de la pantalla:
+//  - base:  fondo estatico (bordes y HUD), se dibuja una sola vez
+//  - back:  cuadro que se esta componiendo
+//  - front: lo que la terminal tiene en pantalla segun nosotros
+// Solo se visitan las celdas de los tramos escritos en este cuadro y en el anterior,
+// de modo que el costo depende de la cantidad de entidades y no del tamaño de la terminal.
+// Hay uno por pantalla: el del proceso y uno por sesion del modo anfitrion, elegido por
+// cada hilo con render_select igual que la pantalla con term_select
+struct Renderer
+{
+    chtype *base, *back, *front;
+    int rows, cols;
+    SpanList prev_spans, cur_spans;
+    int needs_reset;
+    int hud_hp, hud_score, hud_high_score, hud_boss_active, hud_boss_hp;
+    RenderStats stats;
+};
+
+#define RENDERER_INIT {.needs_reset = 1, .hud_hp = -1, .hud_score = -1, .hud_high_score = -1, \
+                       .hud_boss_active = -1, .hud_boss_hp = -1}
+
+static Renderer process_renderer = RENDERER_INIT;
+static _Thread_local Renderer *rd = &process_renderer; // Renderizador del hilo que llama
+#pragma endregion
+
+#pragma region FUNCIONES_AUXILIARES
+// Agrega un tramo a la lista, creciendo el arreglo si hace falta
+static void push_span(SpanList *list, int y, int x, int len)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, list->capacity * sizeof(Span));
+    }
+    list->items[list->count++] = (Span){y, x, len};
+}
+
+// Escribe un texto en una capa recortandolo a los limites de la pantalla.
+// Devuelve la columna inicial y la longitud de lo escrito en *start y *len
+static void put_text(chtype *layer, int y, int x, const char *text, chtype attr, int *start, int *len)
+{
+    int n = strlen(text);
+    int first = x < 0 ? 0 : x;
+    int last = x + n > rd->cols ? rd->cols : x + n;
+
+    *start = first;
+    *len = 0;
+    if (y < 0 || y >= rd->rows || first >= last)
+    {
+        return;
+    }
+
+    for (int c = first; c < last; c++)
+    {
+        layer[y * rd->cols + c] = (unsigned char)text[c - x] | attr;
+    }
+    *len = last - first;
+}
+
+// Envia a la terminal las celdas del tramo que difieren de lo que hay en pantalla. Cada
+// racha de celdas distintas sale con una sola llamada a term_put
+static int flush_span(Span s)
+{
+    int changed = 0;
+    int c = s.x, end = s.x + s.len;
+    chtype *b = rd->back + s.y * rd->cols, *f = rd->front + s.y * rd->cols;
+    while (c < end)
+    {
+        while (c < end && b[c] == f[c])
+        {
+            c++;
+        }
+        int start = c;
+        while (c < end && b[c] != f[c])
+        {
+            f[c] = b[c];
+            c++;
+        }
+        if (c > start)
+        {
+            term_put(s.y, start, b + start, c - start);
+            changed += c - start;
+        }
+    }
+    return changed;
+}
+
+// Dibuja los bordes en la capa base
+static void compose_borders()
+{
+    for (int i = 0; i < rd->rows * rd->cols; i++)
+    {
+        rd->base[i] = ' ';
+    }
+    for (int i = 0; i < rd->cols; i++)
+    {
+        rd->base[i] = '#';
+        if (rd->rows > 2)
+        {
+            rd->base[2 * rd->cols + i] = '-';
+        }
+        rd->base[(rd->rows - 1) * rd->cols + i] = '#';
+    }
+    for (int i = 0; i < rd->rows; i++)
+    {
+        rd->base[i * rd->cols] = '#';
+        rd->base[i * rd->cols + rd->cols - 1] = '#';
+    }
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_RENDERIZADOR
+void render_init()
+{
+    render_free();
+    rd->rows = term_rows();
+    rd->cols = term_cols();
+    rd->base = malloc(rd->rows * rd->cols * sizeof(chtype));
+    rd->back = malloc(rd->rows * rd->cols * sizeof(chtype));
+    rd->front = malloc(rd->rows * rd->cols * sizeof(chtype));
+    rd->stats.screen_cells = rd->rows * rd->cols;
+    rd->needs_reset = 1;
+}
+
+void render_free()
+{
+    free(rd->base);
+    free(rd->back);
+    free(rd->front);
+    rd->base = rd->back = rd->front = NULL;
+    free(rd->prev_spans.items);
+    free(rd->cur_spans.items);
+    memset(&rd->prev_spans, 0, sizeof(rd->prev_spans));
+    memset(&rd->cur_spans, 0, sizeof(rd->cur_spans));
+}
+
+void render_invalidate()
+{
+    rd->needs_reset = 1;
+}
+
+int render_needs_reset()
+{
+    return rd->needs_reset || rd->base == NULL || rd->rows != term_rows() || rd->cols != term_cols();
+}
+
+// Limpia la pantalla y dibuja el fondo completo. Solo se llama al entrar a una partida,
+// despues de que otra pantalla dibujo encima o cuando cambia el tamaño de la terminal
+void render_reset()
+{
+    if (rd->base == NULL || rd->rows != term_rows() || rd->cols != term_cols())
+    {
+        render_init();
+    }
+
+    compose_borders();
+    memcpy(rd->back, rd->base, rd->rows * rd->cols * sizeof(chtype));
+    memcpy(rd->front, rd->base, rd->rows * rd->cols * sizeof(chtype));
+    rd->prev_spans.count = 0;
+    rd->cur_spans.count = 0;
+    rd->hud_hp = rd->hud_score = rd->hud_high_score = rd->hud_boss_active = rd->hud_boss_hp = -1;
+
+    term_clear();
+    for (int y = 0; y < rd->rows; y++)
+    {
+        term_put(y, 0, rd->base + y * rd->cols, rd->cols);
+    }
+    rd->needs_reset = 0;
+}
+
+// Restaura el fondo en las celdas que ocuparon las entidades del cuadro anterior
+void render_begin_frame()
+{
+    for (int i = 0; i < rd->prev_spans.count; i++)
+    {
+        Span s = rd->prev_spans.items[i];
+        memcpy(rd->back + s.y * rd->cols + s.x, rd->base + s.y * rd->cols + s.x, s.len * sizeof(chtype));
+    }
+}
+
+void render_text(int y, int x, const char *text, chtype attr)
+{
+    int start, len;
+    put_text(rd->back, y, x, text, attr, &start, &len);
+    if (len > 0)
+    {
+        push_span(&rd->cur_spans, y, start, len);
+    }
+}
+
+// Las celdas ya traen el color, asi que componer un sprite es copiar memoria
+void render_cells(int y, int x, const chtype *cells, int n)
+{
+    int first = x < 0 ? 0 : x;
+    int last = x + n > rd->cols ? rd->cols : x + n;
+    if (y < 0 || y >= rd->rows || first >= last)
+    {
+        return;
+    }
+    memcpy(rd->back + y * rd->cols + first, cells + (first - x), (last - first) * sizeof(chtype));
+    push_span(&rd->cur_spans, y, first, last - first);
+}
+
+void render_hud(int hp, int score, int high_score, int boss_active, int boss_hp)
+{
+    if (hp == rd->hud_hp && score == rd->hud_score && high_score == rd->hud_high_score &&
+        boss_active == rd->hud_boss_active && (!boss_active || boss_hp == rd->hud_boss_hp))
+    {
+        return;
+    }
+    rd->hud_hp = hp;
+    rd->hud_score = score;
+    rd->hud_high_score = high_score;
+    rd->hud_boss_active = boss_active;
+    rd->hud_boss_hp = boss_hp;
+
+    // Recompone la fila del HUD en la capa base respetando el orden original de los textos
+    char text[32];
+    int start, len;
+    for (int c = 1; c < rd->cols - 1; c++)
+    {
+        rd->base[rd->cols + c] = ' ';
+    }
+    snprintf(text, sizeof(text), "HP: %d", hp);
+    put_text(rd->base, 1, 2, text, 0, &start, &len);
+    snprintf(text, sizeof(text), "Score: %d", score);
+    put_text(rd->base, 1, 10, text, 0, &start, &len);
+    snprintf(text, sizeof(text), "High Score: %d", high_score);
+    put_text(rd->base, 1, 20, text, 0, &start, &len);
+    if (boss_active)
+    {
+        snprintf(text, sizeof(text), "Boss HP %d", boss_hp);
+        put_text(rd->base, 1, 40, text, 0, &start, &len);
+    }
+
+    memcpy(rd->back + rd->cols + 1, rd->base + rd->cols + 1, (rd->cols - 2) * sizeof(chtype));
+    push_span(&rd->cur_spans, 1, 1, rd->cols - 2);
+}
+
+int render_end_frame()
+{
+    int changed = 0;
+    long t = prof_begin();
+    for (int i = 0; i < rd->prev_spans.count; i++)
+    {
+        changed += flush_span(rd->prev_spans.items[i]);
+    }
+    for (int i = 0; i < rd->cur_spans.count; i++)
+    {
+        changed += flush_span(rd->cur_spans.items[i]);
+    }
+    prof_end(PROF_FLUSH, t);
+
+    t = prof_begin();
+    rd->stats.bytes += term_flush();
+    prof_end(PROF_REFRESH, t);
+
+    // Los tramos de este cuadro son los que hay que borrar en el siguiente
+    SpanList tmp = rd->prev_spans;
+    rd->prev_spans = rd->cur_spans;
+    rd->cur_spans = tmp;
+    rd->cur_spans.count = 0;
+
+    rd->stats.frames++;
+    rd->stats.changed_cells += changed;
+    rd->stats.last_changed = changed;
+    if (changed > rd->stats.max_changed)
+    {
+        rd->stats.max_changed = changed;
+    }
+    return changed;
+}
+
+RenderStats render_stats()
+{
+    return rd->stats;
+}
+
+Renderer *render_create()
+{
+    Renderer *r = malloc(sizeof(Renderer));
+    if (r != NULL)
+    {
+        *r = (Renderer)RENDERER_INIT;
+    }
+    return r;
+}
+
+void render_destroy(Renderer *r)
+{
+    if (r == NULL)
+    {
+        return;
+    }
+    Renderer *previous = render_select(r);
+    render_free();
+    render_select(previous == r ? NULL : previous);
+    free(r);
+}
+
+Renderer *render_select(Renderer *r)
+{
+    Renderer *previous = rd;
+    rd = r != NULL ? r : &process_renderer;
+    return previous;
+}
+#pragma endregion
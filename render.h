@@ -0,0 +1,38 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <ncurses.h>
+
+// Estadisticas del renderizador diferencial
+typedef struct
+{
+    long frames;        // Cuadros emitidos con render_end_frame
+    long changed_cells; // Celdas enviadas a la terminal en total
+    int last_changed;   // Celdas enviadas en el ultimo cuadro
+    int max_changed;    // Maximo de celdas enviadas en un cuadro
+    int screen_cells;   // Celdas de la pantalla (referencia para un redibujado completo)
+    long bytes;         // Bytes escritos en la terminal (solo los cuenta el backend ANSI)
+} RenderStats;
+
+typedef struct Renderer Renderer; // Capas y estadisticas de una pantalla
+
+void render_init();       // Reserva los buffers de celdas para el tamaño actual de la terminal
+void render_free();       // Libera los buffers de celdas
+void render_invalidate(); // Marca la pantalla como sucia (otro codigo dibujo encima, p. ej. un menu)
+int render_needs_reset(); // Indica si hay que llamar a render_reset antes del proximo cuadro
+void render_reset();      // Limpia la pantalla y dibuja una sola vez los bordes y el HUD
+
+void render_begin_frame();                                      // Borra del buffer las celdas dibujadas en el cuadro anterior
+void render_text(int y, int x, const char *text, chtype attr);  // Compone un texto en el buffer y marca sus celdas como sucias
+void render_cells(int y, int x, const chtype *cells, int n);    // Copia n celdas con sus atributos al buffer y las marca como sucias
+void render_hud(int hp, int score, int high_score, int boss_active, int boss_hp); // Redibuja el HUD solo si cambio algun valor
+int render_end_frame();                                         // Envia a la terminal solo las celdas que cambiaron y devuelve cuantas
+RenderStats render_stats();                                     // Devuelve las estadisticas acumuladas
+
+// Un renderizador por pantalla: cada hilo compone en el que eligio con render_select (por
+// defecto el del proceso), normalmente junto con su pantalla de term_select
+Renderer *render_create();             // Crea un renderizador vacio, NULL si falla
+void render_destroy(Renderer *r);      // Libera el renderizador y sus buffers
+Renderer *render_select(Renderer *r);  // El hilo que llama usa r (NULL el del proceso), devuelve el anterior
+
+#endif
@@ -0,0 +1,227 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+#include "save_file.h"
+#include "varint.h"
+
+#pragma region FUNCIONES_AUXILIARES
+static void put_varint(FILE *f, unsigned long v)
+{
+    unsigned char buf[VARINT_MAX];
+    fwrite(buf, varint_put(buf, v), 1, f);
+}
+
+// Junta los bytes de un varint hasta el que no tiene el bit de continuacion
+static int get_varint(FILE *f, unsigned long *v)
+{
+    unsigned char buf[VARINT_MAX];
+    size_t n = 0;
+    int c;
+    do
+    {
+        c = getc(f);
+        if (c == EOF)
+        {
+            return -1;
+        }
+        buf[n++] = (unsigned char)c;
+    } while ((c & 0x80) && n < VARINT_MAX);
+
+    const unsigned char *p = buf;
+    return varint_get(&p, buf + n, v);
+}
+
+static void put_op(Replay *r, unsigned long tick, int kind)
+{
+    put_varint(r->f, (tick - r->last_tick) << 2 | kind);
+    r->last_tick = tick;
+    r->records++;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_ARCHIVO
+int replay_open_write(Replay *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "wb");
+    if (r->f == NULL)
+    {
+        return -1;
+    }
+
+    uint32_t header[2] = {REPLAY_MAGIC, REPLAY_VERSION};
+    if (fwrite(header, sizeof(header), 1, r->f) != 1)
+    {
+        replay_close(r);
+        return -1;
+    }
+    r->writing = 1;
+    return 0;
+}
+
+int replay_open_read(Replay *r, const char *path)
+{
+    uint32_t header[2];
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (r->f == NULL)
+    {
+        return -1;
+    }
+    if (fread(header, sizeof(header), 1, r->f) != 1 || header[0] != REPLAY_MAGIC || header[1] != REPLAY_VERSION)
+    {
+        replay_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+void replay_close(Replay *r)
+{
+    if (r->f != NULL)
+    {
+        fclose(r->f);
+    }
+    free(r->snapshot);
+    memset(r, 0, sizeof(*r));
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_ESCRITURA
+// Las funciones de escritura no hacen nada si no hay un archivo abierto para escribir, asi
+// el juego las llama siempre sin comprobar si se esta grabando
+void replay_new_game(Replay *r, unsigned long tick, unsigned long seed, int rows, int cols)
+{
+    if (!r->writing)
+    {
+        return;
+    }
+    r->last_tick = tick;
+    put_op(r, tick, REPLAY_NEW);
+    put_varint(r->f, tick);
+    put_varint(r->f, seed);
+    put_varint(r->f, rows);
+    put_varint(r->f, cols);
+    r->in_session = 1;
+}
+
+void replay_loaded_game(Replay *r, unsigned long tick, const void *snapshot, size_t size)
+{
+    if (!r->writing)
+    {
+        return;
+    }
+    r->last_tick = tick;
+    put_op(r, tick, REPLAY_SNAPSHOT);
+    put_varint(r->f, tick);
+    put_varint(r->f, size);
+    fwrite(snapshot, size, 1, r->f);
+    put_varint(r->f, save_crc32(snapshot, size, 0));
+    r->in_session = 1;
+}
+
+void replay_key(Replay *r, unsigned long tick, int key)
+{
+    if (!r->writing || !r->in_session)
+    {
+        return;
+    }
+    put_op(r, tick, REPLAY_KEY);
+    put_varint(r->f, key);
+}
+
+// Al cerrar cada partida se vacia el buffer: si el juego se corta despues, las partidas
+// terminadas quedan completas en el archivo
+void replay_end_game(Replay *r, unsigned long tick, int score, int hp, unsigned int rng)
+{
+    if (!r->writing || !r->in_session)
+    {
+        return;
+    }
+    put_op(r, tick, REPLAY_END);
+    put_varint(r->f, zigzag(score));
+    put_varint(r->f, zigzag(hp));
+    put_varint(r->f, rng);
+    fflush(r->f);
+    r->in_session = 0;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_LECTURA
+int replay_next(Replay *r, ReplayEvent *ev)
+{
+    unsigned long op, a, b, c;
+    int first = getc(r->f);
+    if (first == EOF)
+    {
+        return 0;
+    }
+    ungetc(first, r->f);
+    if (get_varint(r->f, &op) != 0)
+    {
+        return -1;
+    }
+
+    memset(ev, 0, sizeof(*ev));
+    ev->kind = op & 3;
+    ev->tick = r->last_tick + (op >> 2);
+    switch (ev->kind)
+    {
+    case REPLAY_KEY:
+        if (get_varint(r->f, &a) != 0)
+        {
+            return -1;
+        }
+        ev->key = (int)a;
+        break;
+    case REPLAY_NEW:
+        if (get_varint(r->f, &ev->tick) != 0 || get_varint(r->f, &a) != 0 ||
+            get_varint(r->f, &b) != 0 || get_varint(r->f, &c) != 0)
+        {
+            return -1;
+        }
+        ev->seed = a;
+        ev->rows = (int)b;
+        ev->cols = (int)c;
+        break;
+    case REPLAY_SNAPSHOT:
+        // El tamaño se acota antes de reservar: un varint dañado no puede pedir gigabytes
+        if (get_varint(r->f, &ev->tick) != 0 || get_varint(r->f, &a) != 0 || a > REPLAY_SNAPSHOT_MAX)
+        {
+            return -1;
+        }
+        if (a > r->snapshot_cap)
+        {
+            unsigned char *grown = realloc(r->snapshot, a);
+            if (grown == NULL)
+            {
+                return -1;
+            }
+            r->snapshot = grown;
+            r->snapshot_cap = a;
+        }
+        // La instantanea va directo a sim_restore: una cortada o alterada se rechaza aca
+        if (fread(r->snapshot, a, 1, r->f) != 1 || get_varint(r->f, &b) != 0 ||
+            b != save_crc32(r->snapshot, a, 0))
+        {
+            return -1;
+        }
+        ev->snapshot = r->snapshot;
+        ev->snapshot_size = a;
+        break;
+    case REPLAY_END:
+        if (get_varint(r->f, &a) != 0 || get_varint(r->f, &b) != 0 || get_varint(r->f, &c) != 0)
+        {
+            return -1;
+        }
+        ev->score = unzigzag(a);
+        ev->hp = unzigzag(b);
+        ev->rng = (unsigned int)c;
+        break;
+    }
+    r->last_tick = ev->tick;
+    r->records++;
+    return 1;
+}
+#pragma endregion
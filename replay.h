@@ -0,0 +1,55 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define REPLAY_MAGIC 0x50524941u // "AIRP" en little endian
+#define REPLAY_VERSION 3         // Se incrementa cuando cambia el formato de los registros
+#define REPLAY_SNAPSHOT_MAX (1 << 24) // Bytes de una instantanea como maximo (la del enjambre ocupa menos de 2 MB)
+
+// Tipos de registro. Cada registro empieza con un varint (delta de tick << 2 | tipo), donde
+// el delta es la distancia en ticks al registro anterior de la misma partida
+#define REPLAY_KEY 0      // Tecla aplicada antes de simular el tick: varint tecla
+#define REPLAY_NEW 1      // Partida nueva: varint tick, semilla, filas, columnas
+#define REPLAY_SNAPSHOT 2 // Partida cargada: varint tick, bytes de la instantanea, la instantanea y su CRC-32
+#define REPLAY_END 3      // Fin de la partida: puntos, vida (zigzag) y estado del generador
+
+// Registro leido de un archivo de repeticion
+typedef struct
+{
+    int kind;                 // REPLAY_KEY, REPLAY_NEW, REPLAY_SNAPSHOT o REPLAY_END
+    unsigned long tick;       // Tick absoluto de la partida
+    int key;                  // REPLAY_KEY
+    unsigned long seed;       // REPLAY_NEW: semilla con que se sembro la partida
+    int rows, cols;           // REPLAY_NEW: tablero
+    unsigned char *snapshot;  // REPLAY_SNAPSHOT: instantanea (la libera replay_close)
+    size_t snapshot_size;
+    int score, hp;            // REPLAY_END: estado final para comprobar la repeticion
+    unsigned int rng;         // REPLAY_END: sim_rng_digest al terminar
+} ReplayEvent;
+
+// Archivo de repeticion abierto para escribir o para leer. Se escribe en streaming con el
+// buffer de stdio: cada tecla cuesta unos pocos bytes y solo se vacia al cerrar una partida
+typedef struct
+{
+    FILE *f;
+    int writing;              // 1 si se abrio con replay_open_write
+    unsigned long last_tick;  // Tick del registro anterior de la partida actual
+    int in_session;           // 1 entre un registro de inicio y uno de fin
+    long records;             // Registros escritos o leidos
+    unsigned char *snapshot;  // Buffer de la ultima instantanea leida
+    size_t snapshot_cap;
+} Replay;
+
+int replay_open_write(Replay *r, const char *path); // Crea el archivo y escribe la cabecera, -1 si falla
+int replay_open_read(Replay *r, const char *path);  // Abre y valida la cabecera, -1 si falta o es de otra version
+void replay_close(Replay *r);                       // Vacia el buffer y cierra el archivo
+
+void replay_new_game(Replay *r, unsigned long tick, unsigned long seed, int rows, int cols); // Registra el inicio de una partida nueva
+void replay_loaded_game(Replay *r, unsigned long tick, const void *snapshot, size_t size); // Registra el inicio de una partida cargada
+void replay_key(Replay *r, unsigned long tick, int key);                                  // Registra una tecla aplicada en tick
+void replay_end_game(Replay *r, unsigned long tick, int score, int hp, unsigned int rng);  // Registra el fin de la partida y vacia el buffer
+int replay_next(Replay *r, ReplayEvent *ev);                                              // Lee el proximo registro: 1 si hay, 0 al final, -1 si esta dañado
+
+#endif
@@ -0,0 +1,20 @@
+#include "rng.h"
+
+// La semilla pasa por splitmix64 para que semillas parecidas (1, 2, 3...) den estados
+// iniciales sin relacion entre si
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+void rng_seed(Rng *r, uint64_t seed, uint64_t stream)
+{
+    r->state = 0;
+    r->inc = stream << 1 | 1;
+    rng_next(r);
+    r->state += splitmix64(seed);
+    rng_next(r);
+}
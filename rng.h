@@ -0,0 +1,52 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Generador PCG32 (XSH RR): 64 bits de estado y un incremento impar que elige la secuencia,
+// asi que dos flujos con la misma semilla y distinto incremento no se solapan. No tiene
+// estado global ni candados: cada simulacion lleva sus propios flujos. rng_next y
+// rng_below van en el encabezado para que se inlineen en los bucles de la simulacion
+typedef struct
+{
+    uint64_t state;
+    uint64_t inc; // Siempre impar
+} Rng;
+
+void rng_seed(Rng *r, uint64_t seed, uint64_t stream); // Inicializa el flujo stream con una semilla
+
+// Proximo numero de 32 bits
+static inline uint32_t rng_next(Rng *r)
+{
+    uint64_t old = r->state;
+    r->state = old * 6364136223846793005ULL + r->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+// Numero uniforme en [0, n) sin el sesgo de rng_next() % n: se multiplica por n y se
+// rechazan los pocos valores que caerian de mas en los primeros resultados (Lemire)
+static inline uint32_t rng_below(Rng *r, uint32_t n)
+{
+    uint64_t m = (uint64_t)rng_next(r) * n;
+    uint32_t low = (uint32_t)m;
+    if (low < n)
+    {
+        uint32_t threshold = -n % n;
+        while (low < threshold)
+        {
+            m = (uint64_t)rng_next(r) * n;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// Numero uniforme en (0, 1]
+static inline double rng_unit(Rng *r)
+{
+    return (rng_next(r) + 1.0) / 4294967296.0;
+}
+
+#endif
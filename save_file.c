@@ -0,0 +1,249 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "save_file.h"
+
+#pragma region FUNCIONES_AUXILIARES
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+// Los hilos del modo anfitrion calculan checksums a la vez (partidas guardadas y tabla de
+// puntuaciones): pthread_once garantiza que ninguno ve la tabla a medio armar
+static void build_crc_table()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+uint32_t save_crc32(const void *data, size_t len, uint32_t crc)
+{
+    const unsigned char *p = data;
+
+    pthread_once(&crc_table_once, build_crc_table);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Los registros ocupan un multiplo de 8 bytes para que la cabecera de cada uno quede alineada
+static size_t record_stride(uint32_t record_size)
+{
+    return (sizeof(SaveRecordHeader) + record_size + 7) & ~(size_t)7;
+}
+
+static off_t record_offset(uint32_t record_size, uint32_t slot)
+{
+    return sizeof(SaveHeader) + (off_t)slot * record_stride(record_size);
+}
+
+static uint32_t header_checksum(const SaveHeader *h)
+{
+    return save_crc32(h, offsetof(SaveHeader, checksum), 0);
+}
+
+static uint32_t record_checksum(uint32_t used, const void *data, uint32_t record_size)
+{
+    return save_crc32(data, record_size, save_crc32(&used, sizeof(used), 0));
+}
+
+// Escribe len bytes completos, reintentando si write escribe menos
+int save_write_all(int fd, const void *data, size_t len, off_t offset)
+{
+    const char *p = data;
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0)
+        {
+            return -1;
+        }
+        p += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Sincroniza el directorio para que el rename sobreviva a un corte de energia
+void save_sync_parent_dir(const char *path)
+{
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL)
+    {
+        strcpy(dir, ".");
+    }
+    else
+    {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd != -1)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_ARCHIVO
+// El archivo se arma completo en path.tmp, se sincroniza y recien entonces reemplaza al
+// anterior con rename, que es atomico: un corte deja el archivo viejo o el nuevo, nunca
+// uno a medias. records tiene slots registros contiguos de record_size bytes
+int save_file_create(const char *path, uint32_t slots, uint32_t record_size, const void *records, const unsigned char *used)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    size_t stride = record_stride(record_size);
+    size_t size = sizeof(SaveHeader) + slots * stride;
+    unsigned char *buffer = calloc(1, size);
+    if (buffer == NULL)
+    {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    SaveHeader *h = (SaveHeader *)buffer;
+    h->magic = SAVE_MAGIC;
+    h->version = SAVE_VERSION;
+    h->record_size = record_size;
+    h->slots = slots;
+    h->checksum = header_checksum(h);
+
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        SaveRecordHeader *r = (SaveRecordHeader *)(buffer + record_offset(record_size, i));
+        const unsigned char *data = (const unsigned char *)records + (size_t)i * record_size;
+        r->used = used[i] != 0;
+        memcpy(r + 1, data, record_size);
+        r->checksum = record_checksum(r->used, r + 1, record_size);
+    }
+
+    int failed = save_write_all(fd, buffer, size, 0) != 0 || fsync(fd) != 0;
+    free(buffer);
+    failed |= close(fd) != 0;
+    if (failed || rename(tmp, path) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    save_sync_parent_dir(path);
+    return 0;
+}
+
+int save_file_open(SaveFile *f, const char *path, uint32_t record_size)
+{
+    struct stat st;
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDWR);
+    if (f->fd == -1)
+    {
+        return -1;
+    }
+    if (fstat(f->fd, &st) != 0 || (size_t)st.st_size < sizeof(SaveHeader))
+    {
+        save_file_close(f);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        save_file_close(f);
+        return -1;
+    }
+    f->map = map;
+    f->size = st.st_size;
+
+    // Se rechaza un archivo de otra version, con la cabecera dañada o truncado
+    const SaveHeader *h = map;
+    if (h->magic != SAVE_MAGIC || h->version != SAVE_VERSION || h->checksum != header_checksum(h) ||
+        h->record_size != record_size || f->size < (size_t)record_offset(record_size, h->slots))
+    {
+        save_file_close(f);
+        return -1;
+    }
+    f->record_size = h->record_size;
+    f->slots = h->slots;
+    return 0;
+}
+
+const void *save_file_record(const SaveFile *f, uint32_t slot)
+{
+    if (slot >= f->slots)
+    {
+        return NULL;
+    }
+
+    const SaveRecordHeader *r = (const SaveRecordHeader *)(f->map + record_offset(f->record_size, slot));
+    if (!r->used || r->checksum != record_checksum(r->used, r + 1, f->record_size))
+    {
+        return NULL;
+    }
+    return r + 1;
+}
+
+// Solo se reescribe el registro pedido. Si la escritura se corta, el checksum de ese
+// registro deja de coincidir y se lee como vacio; los demas registros no se tocan
+int save_file_write(SaveFile *f, uint32_t slot, const void *data)
+{
+    if (slot >= f->slots)
+    {
+        return -1;
+    }
+
+    size_t stride = record_stride(f->record_size);
+    unsigned char *buffer = calloc(1, stride);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+
+    SaveRecordHeader *r = (SaveRecordHeader *)buffer;
+    r->used = 1;
+    memcpy(r + 1, data, f->record_size);
+    r->checksum = record_checksum(r->used, r + 1, f->record_size);
+
+    int failed = save_write_all(f->fd, buffer, stride, record_offset(f->record_size, slot)) != 0 ||
+                 fdatasync(f->fd) != 0;
+    free(buffer);
+    return failed ? -1 : 0;
+}
+
+void save_file_close(SaveFile *f)
+{
+    if (f->map != NULL)
+    {
+        munmap((void *)f->map, f->size);
+    }
+    if (f->fd > 0)
+    {
+        close(f->fd);
+    }
+    memset(f, 0, sizeof(*f));
+}
+#pragma endregion
@@ -0,0 +1,51 @@
+#ifndef SAVE_FILE_H
+#define SAVE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SAVE_MAGIC 0x56534941u // "AISV" en little endian
+#define SAVE_VERSION 1         // Se incrementa cuando cambia el formato de los registros
+
+// Cabecera al inicio del archivo. checksum cubre los campos anteriores
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size; // Bytes de datos de cada registro
+    uint32_t slots;       // Cantidad de registros
+    uint32_t checksum;
+    uint32_t reserved;
+} SaveHeader;
+
+// Cada registro empieza con su propio checksum, asi una escritura interrumpida solo
+// invalida ese registro y no el archivo completo
+typedef struct
+{
+    uint32_t checksum; // CRC-32 de used y de los datos
+    uint32_t used;     // 0 si el registro esta vacio
+} SaveRecordHeader;
+
+// Archivo de partidas abierto con mmap de solo lectura. Las lecturas devuelven punteros
+// al mapeo sin copiar; las escrituras de un registro van con pwrite sobre el mismo archivo
+typedef struct
+{
+    int fd;
+    const unsigned char *map; // Contenido completo del archivo
+    size_t size;              // Bytes mapeados
+    uint32_t record_size;
+    uint32_t slots;
+} SaveFile;
+
+uint32_t save_crc32(const void *data, size_t len, uint32_t crc); // CRC-32 incremental (crc = 0 al empezar)
+int save_write_all(int fd, const void *data, size_t len, off_t offset); // pwrite de len bytes completos desde offset, -1 si falla
+void save_sync_parent_dir(const char *path); // Sincroniza el directorio de path para que un rename sobreviva a un corte de energia
+
+int save_file_create(const char *path, uint32_t slots, uint32_t record_size, const void *records, const unsigned char *used); // Escribe un archivo nuevo en un temporal y lo renombra, -1 si falla
+int save_file_open(SaveFile *f, const char *path, uint32_t record_size); // Mapea y valida la cabecera, -1 si falta, esta dañado o es de otra version
+const void *save_file_record(const SaveFile *f, uint32_t slot);         // Datos del registro o NULL si esta vacio o su checksum no coincide
+int save_file_write(SaveFile *f, uint32_t slot, const void *data);      // Reescribe un registro en su lugar y lo sincroniza, -1 si falla
+void save_file_close(SaveFile *f);                                       // Desmapea y cierra el archivo
+
+#endif
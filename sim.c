@@ -0,0 +1,1164 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "profiler.h"
+#include "sprite_atlas.h"
+#include "boss_patterns.h"
+
+#pragma region MEMORIA_DE_ENTIDADES
+// Reserva bytes dentro de la arena alineados a 64 para que cada columna empiece en su
+// propia linea de cache. Con base NULL solo calcula el tamaño total
+static void *carve(char *base, size_t *offset, size_t bytes)
+{
+    void *p = base ? base + *offset : NULL;
+    *offset += (bytes + 63) & ~(size_t)63;
+    return p;
+}
+
+// Ubica las columnas de un pool. Primero van las columnas densas que recorren los bucles
+// de cada tick y al final las de ids, que solo se tocan al dar de alta o de baja
+static void layout_pool(EntityColumns *c, char *base, size_t *off, int capacity, int typed, int moving)
+{
+    c->x = carve(base, off, capacity * sizeof(int));
+    c->y = carve(base, off, capacity * sizeof(int));
+    c->fx = moving ? carve(base, off, capacity * sizeof(int)) : NULL;
+    c->fy = moving ? carve(base, off, capacity * sizeof(int)) : NULL;
+    c->vx = moving ? carve(base, off, capacity * sizeof(int)) : NULL;
+    c->vy = moving ? carve(base, off, capacity * sizeof(int)) : NULL;
+    c->type = typed ? carve(base, off, capacity) : NULL;
+    c->active = carve(base, off, capacity);
+    c->id = carve(base, off, capacity * sizeof(int));
+    c->index = carve(base, off, capacity * sizeof(int));
+    c->free_next = carve(base, off, capacity * sizeof(int));
+    c->free_prev = carve(base, off, capacity * sizeof(int));
+}
+
+// Ubica las columnas de estado dentro de la arena y devuelve su tamaño
+static size_t layout_columns(World *w, char *base, int max_enemies, int max_projectiles, int max_boss_projectiles)
+{
+    size_t off = 0;
+
+    layout_pool(&w->enemies, base, &off, max_enemies, 1, 0);
+
+    // La FIFO de muertos usa una capacidad potencia de 2 para indexar con una mascara
+    unsigned int ring = 1;
+    while (ring < (unsigned int)max_enemies)
+    {
+        ring <<= 1;
+    }
+    w->spawner.dead_mask = ring - 1;
+    w->spawner.dead = carve(base, &off, ring * sizeof(int));
+    w->spawner.events = carve(base, &off, (max_enemies + MAX_SPAWN_WAVES) * sizeof(SpawnEvent));
+    w->spawner.pending = carve(base, &off, max_enemies * sizeof(int));
+    layout_pool(&w->projectiles, base, &off, max_projectiles, 0, 0);
+    layout_pool(&w->boss_projectiles, base, &off, max_boss_projectiles, 0, 1);
+
+    return off;
+}
+
+int sim_create(World *w, int max_enemies, int max_projectiles)
+{
+    return sim_create_pools(w, max_enemies, max_projectiles, BMAX_PROJECTILES);
+}
+
+int sim_create_pools(World *w, int max_enemies, int max_projectiles, int max_boss_projectiles)
+{
+    memset(w, 0, sizeof(*w));
+
+    w->arena_size = layout_columns(w, NULL, max_enemies, max_projectiles, max_boss_projectiles);
+    w->arena = aligned_alloc(64, w->arena_size);
+    if (w->arena == NULL)
+    {
+        return -1;
+    }
+    memset(w->arena, 0, w->arena_size);
+    layout_columns(w, w->arena, max_enemies, max_projectiles, max_boss_projectiles);
+    sim_seed(w, 1);
+    w->enemy_period = SPEED_LOW_ENEMIES;
+    w->boss_ticks = BOSS_TICKS;
+    w->spawn_chance = SPAWN_CHANCE;
+    w->boss_script = BOSS_SCRIPT_GAME;
+    w->enemies.capacity = max_enemies;
+    w->projectiles.capacity = max_projectiles;
+    w->boss_projectiles.capacity = max_boss_projectiles;
+
+    // La tabla espacial tiene al menos el doble de buckets que celdas de enemigos
+    CollisionGrid *g = &w->grid;
+    int enemy_parts = 0;
+    for (int t = 0; t < ENEMY_TYPES; t++)
+    {
+        int n = sprite_hitbox(SPRITE_ENEMY + t)->count;
+        enemy_parts = n > enemy_parts ? n : enemy_parts;
+    }
+    int parts = max_enemies * enemy_parts;
+    g->bits = MIN_GRID_BITS;
+    while ((1 << g->bits) < 2 * parts)
+    {
+        g->bits++;
+    }
+    g->bucket_stamp = calloc(1 << g->bits, sizeof(unsigned int));
+    g->bucket_head = malloc((1 << g->bits) * sizeof(int));
+    g->part_pos = malloc(parts * sizeof(Position));
+    g->part_enemy = malloc(parts * sizeof(int));
+    g->part_next = malloc(parts * sizeof(int));
+    g->scratch = malloc(max_enemies * sizeof(int));
+    g->bullet_hits = malloc(max_boss_projectiles * sizeof(int));
+    if (!g->bucket_stamp || !g->bucket_head || !g->part_pos || !g->part_enemy || !g->part_next || !g->scratch ||
+        !g->bullet_hits)
+    {
+        sim_destroy(w);
+        return -1;
+    }
+
+    // Mascara de la nave para probar los proyectiles del jefe: una fila de bits por fila de
+    // su caja, con el bit dx encendido si la celda (ship_dx + dx, ship_dy + dy) choca
+    const Hitbox *ship = sprite_hitbox(SPRITE_SHIP);
+    g->ship_dx = g->ship_dy = 0;
+    for (int k = 0; k < ship->count; k++)
+    {
+        g->ship_dx = ship->cell[k].x < g->ship_dx ? ship->cell[k].x : g->ship_dx;
+        g->ship_dy = ship->cell[k].y < g->ship_dy ? ship->cell[k].y : g->ship_dy;
+    }
+    for (int k = 0; k < ship->count; k++)
+    {
+        int dx = ship->cell[k].x - g->ship_dx, dy = ship->cell[k].y - g->ship_dy;
+        if (dy < SHIP_MASK_ROWS && dx < 32)
+        {
+            g->ship_rows[dy] |= 1u << dx;
+        }
+    }
+    return 0;
+}
+
+void sim_destroy(World *w)
+{
+    free(w->arena);
+    free(w->grid.bucket_stamp);
+    free(w->grid.bucket_head);
+    free(w->grid.part_pos);
+    free(w->grid.part_enemy);
+    free(w->grid.part_next);
+    free(w->grid.scratch);
+    free(w->grid.bullet_hits);
+    memset(w, 0, sizeof(*w));
+}
+
+// Vacia el pool y encadena todos los ids en la lista libre en orden ascendente
+static void clear_columns(EntityColumns *c)
+{
+    c->count = 0;
+    c->free_head = c->capacity > 0 ? 0 : -1;
+    for (int id = 0; id < c->capacity; id++)
+    {
+        c->index[id] = -1;
+        c->free_prev[id] = id - 1;
+        c->free_next[id] = id + 1 < c->capacity ? id + 1 : -1;
+    }
+}
+
+static void free_list_unlink(EntityColumns *c, int id)
+{
+    int prev = c->free_prev[id], next = c->free_next[id];
+    if (prev != -1)
+    {
+        c->free_next[prev] = next;
+    }
+    else
+    {
+        c->free_head = next;
+    }
+    if (next != -1)
+    {
+        c->free_prev[next] = prev;
+    }
+}
+
+// Los ids liberados van al frente de la lista: el proximo alta reutiliza el mas reciente
+static void free_list_push(EntityColumns *c, int id)
+{
+    c->free_prev[id] = -1;
+    c->free_next[id] = c->free_head;
+    if (c->free_head != -1)
+    {
+        c->free_prev[c->free_head] = id;
+    }
+    c->free_head = id;
+}
+
+int pool_spawn_id(EntityColumns *c, int id)
+{
+    if (c->index[id] != -1)
+    {
+        return -1; // El id ya esta vivo
+    }
+    free_list_unlink(c, id);
+
+    int i = c->count++;
+    c->id[i] = id;
+    c->index[id] = i;
+    c->active[i] = 1;
+    return i;
+}
+
+int pool_spawn(EntityColumns *c)
+{
+    if (c->free_head == -1)
+    {
+        c->exhausted++;
+        return -1;
+    }
+    return pool_spawn_id(c, c->free_head);
+}
+
+// La ultima entidad viva ocupa el hueco, asi las columnas densas no tienen agujeros
+void pool_remove(EntityColumns *c, int i)
+{
+    int id = c->id[i], last = --c->count;
+
+    if (i != last)
+    {
+        c->x[i] = c->x[last];
+        c->y[i] = c->y[last];
+        if (c->fx)
+        {
+            c->fx[i] = c->fx[last];
+            c->fy[i] = c->fy[last];
+            c->vx[i] = c->vx[last];
+            c->vy[i] = c->vy[last];
+        }
+        if (c->type)
+        {
+            c->type[i] = c->type[last];
+        }
+        c->active[i] = c->active[last];
+        c->id[i] = c->id[last];
+        c->index[c->id[i]] = i;
+    }
+    c->index[id] = -1;
+    free_list_push(c, id);
+}
+
+// Se recorre de atras hacia adelante: lo que pool_remove trae desde el final ya se reviso
+void pool_compact(EntityColumns *c)
+{
+    for (int i = c->count - 1; i >= 0; i--)
+    {
+        if (!c->active[i])
+        {
+            pool_remove(c, i);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region PLANIFICADOR_DE_APARICIONES
+static int event_alloc(SpawnScheduler *s)
+{
+    int ev = s->event_free;
+    if (ev != -1)
+    {
+        s->event_free = s->events[ev].next;
+    }
+    return ev;
+}
+
+static void event_release(SpawnScheduler *s, int ev)
+{
+    s->events[ev].next = s->event_free;
+    s->event_free = ev;
+}
+
+static void wheel_link(SpawnScheduler *s, int ev, unsigned long due)
+{
+    SpawnEvent *e = &s->events[ev];
+    int *head = &s->wheel[due & ((1 << SPAWN_WHEEL_BITS) - 1)];
+
+    e->due = due;
+    e->prev = -1;
+    e->next = *head;
+    if (*head != -1)
+    {
+        s->events[*head].prev = ev;
+    }
+    *head = ev;
+}
+
+static void wheel_unlink(SpawnScheduler *s, int ev)
+{
+    SpawnEvent *e = &s->events[ev];
+    if (e->prev != -1)
+    {
+        s->events[e->prev].next = e->next;
+    }
+    else
+    {
+        s->wheel[e->due & ((1 << SPAWN_WHEEL_BITS) - 1)] = e->next;
+    }
+    if (e->next != -1)
+    {
+        s->events[e->next].prev = e->prev;
+    }
+}
+
+// Saca una reaparicion aleatoria de la lista densa de pendientes
+static void pending_remove(SpawnScheduler *s, int ev)
+{
+    int pos = s->events[ev].pending_pos;
+    int last = s->pending[--s->pending_count];
+    s->pending[pos] = last;
+    s->events[last].pending_pos = pos;
+}
+
+// Cantidad de movimientos de enemigos que falla una prueba de spawn_chance% antes de
+// acertar. Sigue la misma distribucion geometrica que tirar una prueba de spawn_chance%
+// en cada movimiento, pero con un solo numero aleatorio
+static long respawn_delay(World *w)
+{
+    double u = rng_unit(&w->rng[RNG_SPAWN]);
+    if (w->spawn_chance >= 100)
+    {
+        return 0;
+    }
+    return (long)(log(u) / log(1.0 - w->spawn_chance / 100.0));
+}
+
+// Encola un enemigo muerto y le programa una reaparicion. first_tick es el primer
+// movimiento de enemigos en que puede volver
+static void enqueue_dead(World *w, int id, unsigned long first_tick)
+{
+    SpawnScheduler *s = &w->spawner;
+    int ev = event_alloc(s); // Nunca falla: hay un evento reservado por enemigo
+
+    s->dead[s->dead_tail++ & s->dead_mask] = id;
+    s->events[ev].count = 0;
+    s->events[ev].pending_pos = s->pending_count;
+    s->pending[s->pending_count++] = ev;
+    wheel_link(s, ev, first_tick + respawn_delay(w) * w->enemy_period);
+}
+
+// Primer movimiento de enemigos posterior al tick actual
+static unsigned long next_enemy_tick(const World *w)
+{
+    return (w->tick / w->enemy_period + 1) * w->enemy_period;
+}
+
+static void spawner_reset(World *w)
+{
+    SpawnScheduler *s = &w->spawner;
+    int events = w->enemies.capacity + MAX_SPAWN_WAVES;
+
+    s->dead_head = s->dead_tail = 0;
+    s->pending_count = 0;
+    s->waves = 0;
+    for (int i = 0; i < (1 << SPAWN_WHEEL_BITS); i++)
+    {
+        s->wheel[i] = -1;
+    }
+    for (int i = 0; i < events; i++)
+    {
+        s->events[i].next = i + 1 < events ? i + 1 : -1;
+    }
+    s->event_free = events > 0 ? 0 : -1;
+
+    // Al empezar todos los enemigos estan muertos y pueden aparecer desde el tick 0
+    for (int id = 0; id < w->enemies.capacity; id++)
+    {
+        enqueue_dead(w, id, 0);
+    }
+}
+
+// Saca el primer id de la FIFO y lo pone en juego arriba de la pantalla
+static void spawn_next_enemy(World *w)
+{
+    SpawnScheduler *s = &w->spawner;
+    EntityColumns *e = &w->enemies;
+    int i = pool_spawn_id(e, s->dead[s->dead_head++ & s->dead_mask]);
+
+    e->x[i] = 2 + rng_below(&w->rng[RNG_ENEMY], w->cols - 4);
+    e->y[i] = 3;
+    e->type[i] = rng_below(&w->rng[RNG_ENEMY], ENEMY_TYPES);
+}
+
+int schedule_wave(World *w, unsigned long tick, int count)
+{
+    SpawnScheduler *s = &w->spawner;
+    if (s->waves == MAX_SPAWN_WAVES)
+    {
+        return -1;
+    }
+
+    int ev = event_alloc(s);
+    s->waves++;
+    s->events[ev].count = count;
+    wheel_link(s, ev, tick > w->tick ? tick : w->tick);
+    return 0;
+}
+
+// Dispara los eventos de la casilla del tick actual. Cada reaparicion aleatoria saca un id
+// de la FIFO. Las oleadas se procesan despues y cada enemigo que traen cancela una
+// reaparicion aleatoria pendiente, asi siempre hay tantas pendientes como ids en la FIFO
+void run_spawns(World *w)
+{
+    SpawnScheduler *s = &w->spawner;
+    int waves = -1;
+    int ev = s->wheel[w->tick & ((1 << SPAWN_WHEEL_BITS) - 1)];
+
+    while (ev != -1)
+    {
+        int next = s->events[ev].next;
+        if (s->events[ev].due == w->tick)
+        {
+            wheel_unlink(s, ev);
+            if (s->events[ev].count == 0)
+            {
+                pending_remove(s, ev);
+                event_release(s, ev);
+                spawn_next_enemy(w);
+            }
+            else
+            {
+                s->events[ev].next = waves;
+                waves = ev;
+            }
+        }
+        ev = next;
+    }
+
+    while (waves != -1)
+    {
+        int next = s->events[waves].next;
+        for (int k = 0; k < s->events[waves].count && s->pending_count > 0; k++)
+        {
+            int victim = s->pending[s->pending_count - 1];
+            wheel_unlink(s, victim);
+            pending_remove(s, victim);
+            event_release(s, victim);
+            spawn_next_enemy(w);
+        }
+        event_release(s, waves);
+        s->waves--;
+        waves = next;
+    }
+}
+#pragma endregion
+
+#pragma region INICIALIZACION
+// Inicializa el juego, reseteando variables y posicionando al jugador y elementos en sus estados iniciales
+void sim_init(World *w, int rows, int cols)
+{
+    w->rows = rows;
+    w->cols = cols;
+    w->player.x = cols / 2; // Coloca al jugador en el centro horizontalmente
+    w->player.y = rows - 9; // Coloca al jugador cerca del borde inferior
+    w->score = 0;           // Resetea la puntuación
+    w->hp = 3;              // Resetea la vida del jugador
+    w->boss_kills = 0;
+    w->tick = 0;
+    w->boss_tick = 0;
+
+    // Desactiva todos los proyectiles y enemigos al inicio de una nueva partida
+    clear_columns(&w->projectiles);
+    clear_columns(&w->enemies);
+    clear_columns(&w->boss_projectiles);
+
+    // Todos los enemigos esperan su primera aparicion en el planificador
+    spawner_reset(w);
+    w->boss.is_active = 0;
+
+    // Reinicia la tabla espacial para que ningun bucket parezca vigente
+    w->grid.stamp = 0;
+    memset(w->grid.bucket_stamp, 0, (1 << w->grid.bits) * sizeof(unsigned int));
+}
+
+// Cada subsistema usa su propio flujo: sacar un numero mas en uno de ellos (por ejemplo
+// porque aparece el jefe) no cambia la secuencia de los demas
+void sim_seed(World *w, unsigned long seed)
+{
+    for (int i = 0; i < RNG_STREAMS; i++)
+    {
+        rng_seed(&w->rng[i], seed, i);
+    }
+}
+
+unsigned int sim_rng_digest(const World *w)
+{
+    uint64_t digest = 0;
+    for (int i = 0; i < RNG_STREAMS; i++)
+    {
+        digest = digest * 31 + w->rng[i].state;
+    }
+    return (unsigned int)(digest ^ digest >> 32);
+}
+
+// Avanza la simulacion un tick. No dibuja ni espera: el llamador decide cuando renderizar
+void sim_tick(World *w)
+{
+    long t = prof_begin(); // Cada fase se mide por separado si el perfilador esta activo
+    update_projectiles(w); // Actualiza proyectiles
+    prof_end(PROF_PROJECTILES, t);
+
+    t = prof_begin();
+    update_boss_projectiles(w); // Actualiza los proyectiles del jefe
+    prof_end(PROF_BOSS_PROJECTILES, t);
+
+    // Los enemigos solo se mueven uno de cada enemy_period ticks
+    if (w->tick % w->enemy_period == 0)
+    {
+        t = prof_begin();
+        update_enemies(w);
+        prof_end(PROF_ENEMIES, t);
+    }
+    t = prof_begin();
+    run_spawns(w); // Enemigos que reaparecen en este tick
+    prof_end(PROF_SPAWNS, t);
+
+    t = prof_begin();
+    check_collisions(w); // verifica las colisiones
+    prof_end(PROF_COLLISIONS, t);
+
+    if (w->boss.is_active)
+    {
+        t = prof_begin();
+        update_boss(w);
+        prof_end(PROF_BOSS, t);
+    }
+
+    // El reloj del jefe se mide en ticks simulados, no en tiempo de CPU
+    if (w->tick - w->boss_tick >= (unsigned long)w->boss_ticks && !w->boss.is_active)
+    {
+        spawn_boss(w);
+    }
+
+    w->tick++;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_ACTUALIZACION
+// Mueve al jugador según la dirección ingresada por el usuario
+void move_player(World *w, int direction)
+{
+    if (direction == DIR_LEFT && w->player.x > 2)
+    {
+        w->player.x--;
+    }
+    else if (direction == DIR_RIGHT && w->player.x < w->cols - 3)
+    {
+        w->player.x++;
+    }
+}
+
+// Dispara un proyectil desde la posicion del jugador
+void shoot(World *w)
+{
+    spawn_projectile(w, w->player.x, w->player.y - 1);
+}
+
+// Toma un proyectil del pool en O(1). Si el pool esta lleno el disparo se pierde y queda
+// contado en projectiles.exhausted
+int spawn_projectile(World *w, int x, int y)
+{
+    EntityColumns *p = &w->projectiles;
+    int i = pool_spawn(p);
+    if (i != -1)
+    {
+        p->x[i] = x;
+        p->y[i] = y;
+    }
+    return i;
+}
+
+// Actualiza las posiciones de los proyectiles vivos. El bucle no tiene ramas y solo
+// recorre las posiciones densas; los que salen de pantalla se dan de baja al final
+void update_projectiles(World *w)
+{
+    int *restrict y = w->projectiles.y;
+    unsigned char *restrict active = w->projectiles.active;
+    int n = w->projectiles.count;
+
+    for (int i = 0; i < n; i++)
+    { // Mueve el proyectil hacia arriba y lo marca si sale de pantalla
+        y[i]--;
+        active[i] = y[i] >= 3;
+    }
+    pool_compact(&w->projectiles);
+}
+
+// Actualiza las posiciones y estados de los enemigos
+void update_enemies(World *w)
+{
+    EntityColumns *e = &w->enemies;
+    int *restrict y = e->y;
+    unsigned char *restrict active = e->active;
+    int *restrict dead = w->grid.scratch;
+    int n = e->count, limit = w->rows - 3, died = 0;
+
+    // Movimiento vectorizable sobre las posiciones densas
+    for (int i = 0; i < n; i++)
+    {
+        y[i]++;
+    }
+
+    // Los que llegaron al fondo se marcan y se anotan en orden sin ramas
+    for (int i = 0; i < n; i++)
+    {
+        int d = y[i] >= limit;
+        dead[died] = i;
+        died += d;
+        active[i] = !d;
+    }
+    // Pueden reaparecer en el mismo tick: run_spawns corre despues de este movimiento
+    for (int k = 0; k < died; k++)
+    {
+        enqueue_dead(w, e->id[dead[k]], w->tick);
+    }
+    pool_compact(e);
+}
+
+/* Boss Section*/
+void spawn_boss(World *w)
+{
+    w->boss.is_active = 1;
+    w->boss.is_arriving = 1;
+    w->boss.direction = rng_below(&w->rng[RNG_BOSS], 2);
+    w->boss.hp = 5;
+    w->boss.pos.x = w->cols / 2;
+    w->boss.pos.y = 6;
+    w->boss.pattern = 0;
+    w->boss.pattern_tick = 0;
+    w->boss.angle = 0;
+    w->boss_tick = w->tick;
+}
+
+void update_boss(World *w)
+{
+    if (w->boss.is_active)
+    {
+        if (w->boss.is_arriving)
+        {
+            if (w->boss.pos.y == w->rows / 2 - 4)
+            {
+                w->boss.is_arriving = 0;
+            }
+            w->boss.pos.y++;
+        }
+        else
+        {
+            if (w->boss.pos.x == 6 || w->boss.pos.x == w->cols - 10)
+            {
+                w->boss.direction = (w->boss.direction + 1) % 2;
+            }
+            w->boss.pos.x = w->boss.direction == 0 ? w->boss.pos.x - 1 : w->boss.pos.x + 1;
+        }
+    }
+}
+
+// Integra los proyectiles del jefe en punto fijo y despues dispara el patron del tick. El
+// bucle recorre solo las columnas densas, sin ramas ni llamadas, asi el compilador lo
+// vectoriza; los que salen del tablero se dan de baja al final
+void update_boss_projectiles(World *w)
+{
+    EntityColumns *b = &w->boss_projectiles;
+    int *restrict x = b->x, *restrict y = b->y;
+    int *restrict fx = b->fx, *restrict fy = b->fy;
+    const int *restrict vx = b->vx, *restrict vy = b->vy;
+    unsigned char *restrict active = b->active;
+    int n = b->count, right = w->cols - 2, bottom = w->rows - 2;
+
+    for (int i = 0; i < n; i++)
+    {
+        fx[i] += vx[i];
+        fy[i] += vy[i];
+        x[i] = fx[i] >> BULLET_SHIFT;
+        y[i] = fy[i] >> BULLET_SHIFT;
+        active[i] = (x[i] >= 1) & (x[i] <= right) & (y[i] >= 3) & (y[i] <= bottom);
+    }
+    pool_compact(b);
+
+    if (w->boss.is_active && !w->boss.is_arriving)
+    {
+        fire_pattern(w);
+    }
+}
+
+// Toma un proyectil del pool en O(1) y lo lanza desde el centro de la celda (x, y). Si el
+// pool esta lleno el disparo se pierde y queda contado en boss_projectiles.exhausted
+int spawn_bullet(World *w, int x, int y, int angle, int speed)
+{
+    EntityColumns *b = &w->boss_projectiles;
+    int i = pool_spawn(b);
+    if (i != -1)
+    {
+        b->x[i] = x;
+        b->y[i] = y;
+        b->fx[i] = x * BULLET_ONE + BULLET_ONE / 2;
+        b->fy[i] = y * BULLET_ONE + BULLET_ONE / 2;
+        b->vx[i] = angle_cos(angle) * speed * BULLET_ASPECT / BULLET_ONE;
+        b->vy[i] = angle_sin(angle) * speed / BULLET_ONE;
+    }
+    return i;
+}
+
+// Angulo de la tabla que mejor apunta en la direccion (dx, dy). Solo se usa al disparar, asi
+// que basta con probar todos; las columnas valen BULLET_ASPECT veces menos que las filas
+static int aim_angle(int dx, int dy)
+{
+    int best = ANGLE_DOWN;
+    long best_dot = 0;
+    for (int a = 0; a < ANGLE_TURN; a++)
+    {
+        long dot = (long)dx * angle_cos(a) + (long)dy * BULLET_ASPECT * angle_sin(a);
+        if (dot > best_dot)
+        {
+            best_dot = dot;
+            best = a;
+        }
+    }
+    return best;
+}
+
+// Dispara count proyectiles repartidos en arc alrededor de center
+static void fire_fan(World *w, int x, int y, int center, const BossPattern *p)
+{
+    int step = p->count > 1 ? p->arc / (p->count - 1) : 0;
+    int first = center - step * (p->count - 1) / 2;
+    for (int k = 0; k < p->count; k++)
+    {
+        spawn_bullet(w, x, y, first + k * step, p->speed);
+    }
+}
+
+// Cada patron del guion dispara cada period ticks durante ticks ticks y despues le deja el
+// lugar al siguiente. Los proyectiles salen de debajo del jefe, igual que el disparo original
+void fire_pattern(World *w)
+{
+    Boss *boss = &w->boss;
+    const BossScript *s = &boss_scripts[w->boss_script];
+    const BossPattern *p = &s->pattern[boss->pattern];
+    int x = boss->pos.x + 2, y = boss->pos.y + 1;
+
+    if (boss->pattern_tick % p->period == 0)
+    {
+        switch (p->kind)
+        {
+        case PATTERN_SPREAD:
+            fire_fan(w, x, y, ANGLE_DOWN, p);
+            break;
+        case PATTERN_SPIRAL:
+            for (int k = 0; k < p->count; k++)
+            {
+                spawn_bullet(w, x, y, boss->angle + k * ANGLE_TURN / p->count, p->speed);
+            }
+            boss->angle = (boss->angle + p->turn) & (ANGLE_TURN - 1);
+            break;
+        case PATTERN_AIMED:
+            fire_fan(w, x, y, aim_angle(w->player.x - x, w->player.y - y), p);
+            break;
+        }
+    }
+    if (++boss->pattern_tick >= p->ticks)
+    {
+        boss->pattern_tick = 0;
+        boss->pattern = (boss->pattern + 1) % s->count;
+    }
+}
+
+#pragma endregion
+
+#pragma region INSTANTANEAS
+// Una instantanea es la cabecera (con una copia de World) seguida de la arena completa.
+// Toda la memoria de estado vive en la arena, asi que se guarda y se restaura con dos
+// memcpy; los punteros de la copia de World no se usan y se recalculan al restaurar
+size_t sim_snapshot_size(const World *w)
+{
+    return sizeof(SnapshotHeader) + w->arena_size;
+}
+
+void sim_snapshot(const World *w, void *buffer)
+{
+    SnapshotHeader *h = buffer;
+    h->magic = SNAPSHOT_MAGIC;
+    h->version = SNAPSHOT_VERSION;
+    h->max_enemies = w->enemies.capacity;
+    h->max_projectiles = w->projectiles.capacity;
+    h->arena_size = w->arena_size;
+    h->world = *w;
+    memcpy(h + 1, w->arena, w->arena_size);
+}
+
+// Un pool es valido si cada posicion densa apunta a un id vivo que la apunta a ella y los
+// ids libres forman una sola lista, sin ciclos, con exactamente capacity - count ids
+static int pool_valid(const EntityColumns *c, int capacity)
+{
+    if (c->capacity != capacity || c->count < 0 || c->count > capacity || c->free_head < -1 ||
+        c->free_head >= capacity)
+    {
+        return 0;
+    }
+    for (int i = 0; i < c->count; i++)
+    {
+        if (c->id[i] < 0 || c->id[i] >= capacity || c->index[c->id[i]] != i ||
+            (c->type != NULL && c->type[i] >= ENEMY_TYPES))
+        {
+            return 0;
+        }
+    }
+    int free_ids = 0, prev = -1;
+    for (int id = c->free_head; id != -1; id = c->free_next[id])
+    {
+        if (id < 0 || id >= capacity || c->index[id] != -1 || c->free_prev[id] != prev ||
+            ++free_ids > capacity - c->count)
+        {
+            return 0;
+        }
+        prev = id;
+    }
+    return free_ids == capacity - c->count;
+}
+
+// Cada evento del planificador esta en una sola lista (la de libres o la casilla de la rueda
+// de su tick) y cada id de la FIFO es un enemigo muerto distinto. mark tiene un byte por evento
+static int spawner_valid(const World *w, unsigned char *mark)
+{
+    const SpawnScheduler *s = &w->spawner;
+    int max_enemies = w->enemies.capacity, events = max_enemies + MAX_SPAWN_WAVES;
+    unsigned long queued = s->dead_tail - s->dead_head;
+
+    if (queued != (unsigned long)(max_enemies - w->enemies.count) || s->pending_count != (int)queued ||
+        s->waves < 0 || s->waves > MAX_SPAWN_WAVES)
+    {
+        return 0;
+    }
+    memset(mark, 0, events);
+    for (unsigned long k = s->dead_head; k != s->dead_tail; k++)
+    {
+        int id = s->dead[k & s->dead_mask];
+        if (id < 0 || id >= max_enemies || w->enemies.index[id] != -1 || mark[id])
+        {
+            return 0;
+        }
+        mark[id] = 1;
+    }
+
+    int seen = 0, random = 0, waves = 0;
+    memset(mark, 0, events);
+    for (int ev = s->event_free; ev != -1; ev = s->events[ev].next)
+    {
+        if (ev < 0 || ev >= events || mark[ev] || ++seen > events)
+        {
+            return 0;
+        }
+        mark[ev] = 1;
+    }
+    for (int slot = 0; slot < (1 << SPAWN_WHEEL_BITS); slot++)
+    {
+        int prev = -1;
+        for (int ev = s->wheel[slot]; ev != -1; ev = s->events[ev].next)
+        {
+            if (ev < 0 || ev >= events || mark[ev] || ++seen > events || s->events[ev].prev != prev ||
+                (int)(s->events[ev].due & ((1 << SPAWN_WHEEL_BITS) - 1)) != slot || s->events[ev].count < 0)
+            {
+                return 0;
+            }
+            if (s->events[ev].count == 0)
+            {
+                int pos = s->events[ev].pending_pos;
+                if (pos < 0 || pos >= s->pending_count || s->pending[pos] != ev)
+                {
+                    return 0;
+                }
+                random++;
+            }
+            else
+            {
+                waves++;
+            }
+            mark[ev] = 1;
+            prev = ev;
+        }
+    }
+    return seen == events && random == s->pending_count && waves == s->waves;
+}
+
+// Revisa todo lo que la simulacion usa como indice o divisor sin comprobarlo. El checksum
+// del archivo solo detecta daños; una instantanea armada a mano puede pasarlo
+static int world_valid(const World *w, int max_enemies, int max_projectiles, int max_boss_projectiles)
+{
+    if (w->rows <= 0 || w->cols <= 4 || w->enemy_period <= 0 || w->spawn_chance <= 0 || w->spawn_chance > 100 ||
+        w->boss_ticks < 0 || w->boss_script < 0 || w->boss_script >= BOSS_SCRIPT_COUNT ||
+        w->boss.pattern < 0 || w->boss.pattern >= boss_scripts[w->boss_script].count || w->boss.pattern_tick < 0 ||
+        !pool_valid(&w->enemies, max_enemies) || !pool_valid(&w->projectiles, max_projectiles) ||
+        !pool_valid(&w->boss_projectiles, max_boss_projectiles))
+    {
+        return 0;
+    }
+    unsigned char *mark = malloc(max_enemies + MAX_SPAWN_WAVES);
+    int valid = mark != NULL && spawner_valid(w, mark);
+    free(mark);
+    return valid;
+}
+
+// Solo se aceptan instantaneas tomadas con las mismas capacidades y cuyo contenido es
+// coherente: se revisan sobre el buffer antes de tocar el mundo. La tabla de colisiones no
+// forma parte del estado: se reconstruye en cada tick y se conserva la del destino
+int sim_restore(World *w, const void *buffer, size_t size)
+{
+    const SnapshotHeader *h = buffer;
+    if (size < sizeof(SnapshotHeader) || h->magic != SNAPSHOT_MAGIC || h->version != SNAPSHOT_VERSION ||
+        h->max_enemies != w->enemies.capacity || h->max_projectiles != w->projectiles.capacity ||
+        h->world.boss_projectiles.capacity != w->boss_projectiles.capacity || h->arena_size != w->arena_size || size < sim_snapshot_size(w))
+    {
+        return -1;
+    }
+
+    void *arena = w->arena;
+    CollisionGrid grid = w->grid;
+    int max_enemies = w->enemies.capacity, max_projectiles = w->projectiles.capacity;
+    int max_boss_projectiles = w->boss_projectiles.capacity;
+
+    World saved = h->world;
+    layout_columns(&saved, (char *)(h + 1), max_enemies, max_projectiles, max_boss_projectiles);
+    if (!world_valid(&saved, max_enemies, max_projectiles, max_boss_projectiles))
+    {
+        return -1;
+    }
+
+    *w = h->world;
+    w->arena = arena;
+    w->grid = grid;
+    memcpy(w->arena, h + 1, w->arena_size);
+    layout_columns(w, w->arena, max_enemies, max_projectiles, max_boss_projectiles);
+    return 0;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_CHECK_COLISIONES
+// Bucket de la tabla espacial que corresponde a una celda
+static unsigned int grid_bucket(const World *w, Position p)
+{
+    unsigned int key = (unsigned int)p.y * (unsigned int)w->cols + (unsigned int)p.x;
+    return (key * 2654435761u) >> (32 - w->grid.bits);
+}
+
+// Inserta las celdas de todos los enemigos vivos, segun la mascara del sprite de su tipo.
+// Se recorren de mayor a menor posicion para que cada cadena quede ordenada de menor a mayor
+static void grid_build(World *w)
+{
+    CollisionGrid *g = &w->grid;
+    EntityColumns *e = &w->enemies;
+    const Hitbox *masks[ENEMY_TYPES];
+    int parts = 0;
+
+    for (int t = 0; t < ENEMY_TYPES; t++)
+    {
+        masks[t] = sprite_hitbox(SPRITE_ENEMY + t);
+    }
+    g->stamp++;
+    for (int j = e->count - 1; j >= 0; j--)
+    {
+        const Hitbox *m = masks[e->type[j]];
+        for (int k = 0; k < m->count; k++)
+        {
+            Position p = {e->x[j] + m->cell[k].x, e->y[j] + m->cell[k].y};
+            unsigned int b = grid_bucket(w, p);
+
+            if (g->bucket_stamp[b] != g->stamp)
+            {
+                g->bucket_stamp[b] = g->stamp;
+                g->bucket_head[b] = -1;
+            }
+            g->part_pos[parts] = p;
+            g->part_enemy[parts] = j;
+            g->part_next[parts] = g->bucket_head[b];
+            g->bucket_head[b] = parts;
+            parts++;
+        }
+    }
+}
+
+// Devuelve el enemigo no marcado de menor posicion que ocupa la celda, o -1 si no hay ninguno
+static int grid_query(const World *w, Position p)
+{
+    const CollisionGrid *g = &w->grid;
+    unsigned int b = grid_bucket(w, p);
+    int best = -1;
+
+    if (g->bucket_stamp[b] != g->stamp)
+    {
+        return -1;
+    }
+    for (int i = g->bucket_head[b]; i != -1; i = g->part_next[i])
+    {
+        int j = g->part_enemy[i];
+        if (g->part_pos[i].x == p.x && g->part_pos[i].y == p.y && w->enemies.active[j] &&
+            (best == -1 || j < best))
+        {
+            best = j;
+        }
+    }
+    return best;
+}
+
+// Verifica colisiones entre proyectiles y enemigos, y entre el jugador y enemigos.
+// Los enemigos se insertan una vez en la tabla espacial, asi que el costo es lineal en la
+// cantidad de entidades en lugar de proyectiles x enemigos x partes. Las bajas se marcan
+// durante la pasada y se compactan al final para no mover posiciones que la tabla usa
+void check_collisions(World *w)
+{
+    EntityColumns *p = &w->projectiles;
+    EntityColumns *e = &w->enemies;
+    EntityColumns *bp = &w->boss_projectiles;
+    const Hitbox *ship = sprite_hitbox(SPRITE_SHIP);
+    const Hitbox *boss = sprite_hitbox(SPRITE_BOSS);
+    Position ship_parts[SPRITE_MAX_CELLS]; // Define las partes del jugador para colisiones
+    Position boss_parts[SPRITE_MAX_CELLS];
+    for (int k = 0; k < ship->count; k++)
+    {
+        ship_parts[k].x = w->player.x + ship->cell[k].x;
+        ship_parts[k].y = w->player.y + ship->cell[k].y;
+    }
+    for (int k = 0; k < boss->count; k++)
+    {
+        boss_parts[k].x = w->boss.pos.x + boss->cell[k].x;
+        boss_parts[k].y = w->boss.pos.y + boss->cell[k].y;
+    }
+
+    grid_build(w);
+
+    for (int i = 0; i < p->count; i++)
+    {
+        // Comprueba cada proyectil del jugador contra los enemigos de su celda y contra el jefe
+        Position pos = {p->x[i], p->y[i]};
+        int j = grid_query(w, pos);
+        if (j != -1)
+        {
+            p->active[i] = 0;
+            update_score(w, e->type[j]); // Suma puntos por tipo de enemigo derrotado
+            e->active[j] = 0;            // Desactiva el enemigo golpeado
+
+            // El enemigo derribado espera su turno para reaparecer
+            enqueue_dead(w, e->id[j], next_enemy_tick(w));
+        }
+
+        if (w->boss.is_active)
+        {
+            if (check_collision(pos, boss_parts, boss->count))
+            {
+                w->boss.hp--;
+                p->active[i] = 0;
+                if (w->boss.hp == 0)
+                {
+                    update_score(w, 3);
+                    w->boss_kills++;
+                    w->boss.is_active = 0;
+                    w->boss_tick = w->tick;
+                }
+            }
+        }
+    }
+    pool_compact(p);
+
+    // Los proyectiles del jefe se prueban todos juntos contra la mascara de la nave: una
+    // pasada sin ramas anota los que caen en una celda ocupada y solo esos se procesan
+    int *restrict hits = w->grid.bullet_hits;
+    const int *restrict bx = bp->x, *restrict by = bp->y;
+    const unsigned int *ship_rows = w->grid.ship_rows;
+    int ox = w->player.x + w->grid.ship_dx, oy = w->player.y + w->grid.ship_dy, hit_count = 0;
+    for (int i = 0; i < bp->count; i++)
+    {
+        unsigned int dx = bx[i] - ox, dy = by[i] - oy;
+        unsigned int inside = (dx < 32) & (dy < SHIP_MASK_ROWS);
+        hits[hit_count] = i;
+        hit_count += inside & (ship_rows[inside ? dy : 0] >> (dx & 31));
+    }
+    for (int k = 0; k < hit_count; k++)
+    {
+        bp->active[hits[k]] = 0;
+        w->hp--;
+    }
+    pool_compact(bp);
+
+    // Choque de la nave: el enemigo de menor posicion que toque cualquiera de sus partes
+    int hit = -1;
+    for (int k = 0; k < ship->count; k++)
+    {
+        int j = grid_query(w, ship_parts[k]);
+        if (j != -1 && (hit == -1 || j < hit))
+        {
+            hit = j;
+        }
+    }
+    if (hit != -1)
+    {
+        e->active[hit] = 0;
+        enqueue_dead(w, e->id[hit], next_enemy_tick(w));
+
+        w->hp--; // Resta la vida por colision
+    }
+    pool_compact(e);
+}
+
+// Verifica si dos posiciones coinciden
+int check_collision(Position pos, Position *parts, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (pos.x == parts[i].x && pos.y == parts[i].y)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int check_collision_enemies(Position *ship_parts, Position *parts, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            if (ship_parts[j].x == parts[i].x && ship_parts[j].y == parts[i].y)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int check_collision_boss(Position boss_projectile, Position *ship_parts, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (boss_projectile.x == ship_parts[i].x && boss_projectile.y == ship_parts[i].y)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region FUNCIONES_PUNTUACION
+// Actualiza la puntuación basada en el tipo de enemigo derrotado
+void update_score(World *w, int type)
+{
+    switch (type)
+    {
+    case 0:
+        w->score += 30;
+        break;
+    case 1:
+        w->score += 20;
+        break;
+    case 2:
+        w->score += 10;
+        break;
+    case 3:
+        w->score += 50;
+        break;
+    }
+}
+#pragma endregion
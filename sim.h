@@ -0,0 +1,215 @@
+#ifndef SIM_H
+#define SIM_H
+
+#pragma region _DEFINICIONES_Y_MACROS
+#include <stddef.h>
+#include "rng.h"
+
+#define DELAY 30000          // Duracion de un tick en microsegundos
+#define MAX_PROJECTILES 5    // Máximo número de proyectiles que puede tener el jugador
+#define BMAX_PROJECTILES 256 // Máximo número de proyectiles que puede tener el jefe
+#define MAX_ENEMIES 10       // Máximo número de enemigos en el juego
+#define SPEED_LOW_ENEMIES 10 // Cada cuantos ticks se mueven los enemigos
+#define BOSS_TIME 5          // Segundos entre la muerte del jefe y su reaparicion
+#define BOSS_TICKS (BOSS_TIME * 1000000L / DELAY) // BOSS_TIME expresado en ticks
+
+#define SWARM_ENEMIES 20000     // Enemigos en la configuracion "swarm"
+#define SWARM_PROJECTILES 20000 // Proyectiles en la configuracion "swarm"
+#define BULLET_HELL_PROJECTILES 16384 // Proyectiles del jefe en el benchmark de patrones
+
+#define SPAWN_CHANCE 5     // Probabilidad (%) de que un enemigo muerto reaparezca en cada movimiento
+#define SPAWN_WHEEL_BITS 8 // La rueda de apariciones tiene 2^SPAWN_WHEEL_BITS casillas
+#define MAX_SPAWN_WAVES 16 // Oleadas programadas pendientes como maximo
+
+#define SNAPSHOT_MAGIC 0x50414E53u // "SNAP" en little endian
+#define SNAPSHOT_VERSION 4         // Se incrementa cuando cambia World o la arena
+
+#define RNG_SPAWN 0   // Flujo aleatorio de las demoras de reaparicion
+#define RNG_ENEMY 1   // Flujo aleatorio de la columna y el tipo de los enemigos
+#define RNG_BOSS 2    // Flujo aleatorio de la direccion del jefe
+#define RNG_STREAMS 3 // Flujos aleatorios de cada simulacion
+
+#define ENEMY_TYPES 3   // Tipos de enemigos
+#define MIN_GRID_BITS 8 // La tabla espacial tiene al menos 2^MIN_GRID_BITS buckets
+#define SHIP_MASK_ROWS 8 // Filas de la mascara de colision de la nave (al menos SPRITE_MAX_ROWS)
+
+#define DIR_LEFT -1 // Direccion de movimiento hacia la izquierda
+#define DIR_RIGHT 1 // Direccion de movimiento hacia la derecha
+
+typedef struct
+{
+    int x, y;
+} Position;
+
+// Pool de una clase de entidad guardado como estructura de arreglos. Las entidades vivas
+// ocupan las posiciones densas [0, count) de las columnas x/y/type/active/id, asi que los
+// bucles solo tocan entidades vivas. Cada entidad tiene ademas un identificador estable
+// (id) que no cambia mientras vive; index[id] da su posicion densa. Los ids libres forman
+// una lista enlazada intrusiva guardada en las columnas free_next/free_prev, por lo que
+// dar de alta y de baja son O(1). active[i] vale 1 salvo para las entidades marcadas para
+// salir en el proximo pool_compact
+typedef struct
+{
+    int *x;                // Columna
+    int *y;                // Fila
+    int *fx, *fy;          // Posicion en punto fijo (NULL salvo en los proyectiles del jefe)
+    int *vx, *vy;          // Velocidad por tick en punto fijo (NULL salvo en los proyectiles del jefe)
+    unsigned char *type;   // Tipo de enemigo (NULL en los proyectiles)
+    unsigned char *active; // 0 si la entidad esta marcada para darse de baja
+    int *id;               // Identificador estable de la entidad en cada posicion densa
+    int *index;            // Posicion densa de cada id (-1 si el id esta libre)
+    int *free_next;        // Siguiente id libre (solo valido en ids libres)
+    int *free_prev;        // Id libre anterior (solo valido en ids libres)
+    int free_head;         // Primer id libre (-1 si el pool esta lleno)
+    int capacity;          // Entidades reservadas
+    int count;             // Entidades vivas
+    long exhausted;        // Altas rechazadas por pool lleno
+} EntityColumns;
+
+// La posicion del jefe y de sus proyectiles usa x como columna e y como fila,
+// igual que el resto de entidades. pos.y es la fila inferior del sprite.
+typedef struct
+{
+    Position pos;
+    int hp;
+    int direction;
+    int is_active;
+    int is_arriving;
+    int pattern;      // Patron del guion que esta disparando
+    int pattern_tick; // Ticks desde que empezo el patron
+    int angle;        // Giro acumulado de las espirales
+} Boss;
+
+// Tabla hash espacial indexada por celda de pantalla. Cada tick se insertan una vez las
+// celdas de colision de los enemigos activos, y cada proyectil solo revisa el bucket de la
+// celda que ocupa. Los buckets se invalidan cambiando stamp, sin limpiar la tabla
+typedef struct
+{
+    int bits;                   // La tabla tiene 2^bits buckets
+    unsigned int stamp;         // Generacion actual de la tabla
+    unsigned int *bucket_stamp; // Generacion en que se escribio cada bucket
+    int *bucket_head;           // Primera celda encadenada en cada bucket
+    Position *part_pos;         // Celda ocupada
+    int *part_enemy;            // Enemigo al que pertenece la celda
+    int *part_next;             // Siguiente celda del mismo bucket (-1 fin)
+    int *scratch;               // Arreglo auxiliar de enemies.capacity enteros
+    int *bullet_hits;           // Proyectiles del jefe que tocan la nave (boss_projectiles.capacity)
+    unsigned int ship_rows[SHIP_MASK_ROWS]; // Celdas de la nave: bit dx de la fila dy de su caja
+    int ship_dx, ship_dy;       // Esquina de la caja de la nave respecto a su posicion
+} CollisionGrid;
+
+// Aparicion pendiente dentro de la rueda de tiempo
+typedef struct
+{
+    unsigned long due; // Tick en que se dispara
+    int count;         // Enemigos de la oleada (0 en una reaparicion aleatoria)
+    int next, prev;    // Enlaces de la casilla de la rueda (next tambien enlaza los libres)
+    int pending_pos;   // Posicion en pending de una reaparicion aleatoria
+} SpawnEvent;
+
+// Planificador de apariciones de enemigos. Los ids muertos esperan en una FIFO circular y
+// las apariciones pendientes viven en una rueda de tiempo con una casilla por tick modulo
+// 2^SPAWN_WHEEL_BITS; cada evento guarda su tick exacto, asi que puede estar varias vueltas
+// adelante. Cada muerte programa una reaparicion aleatoria y las oleadas programan una
+// cantidad fija de apariciones en un tick dado. Cada evento cuesta O(1)
+typedef struct
+{
+    int *dead;                    // FIFO circular de ids de enemigos muertos
+    unsigned int dead_mask;       // Capacidad de dead menos 1 (potencia de 2)
+    unsigned long dead_head;      // Proximo id en reaparecer
+    unsigned long dead_tail;      // Proxima posicion libre de la FIFO
+    SpawnEvent *events;           // enemies.capacity reapariciones + MAX_SPAWN_WAVES oleadas
+    int event_free;               // Primer evento libre (-1 si no hay)
+    int *pending;                 // Reapariciones aleatorias pendientes, densas
+    int pending_count;            // Siempre igual a la cantidad de ids en la FIFO
+    int waves;                    // Oleadas pendientes
+    int wheel[1 << SPAWN_WHEEL_BITS]; // Primer evento de cada casilla (-1 vacia)
+} SpawnScheduler;
+
+// Estado completo de una simulacion. No depende de ncurses: las dimensiones del
+// tablero se guardan en rows/cols en lugar de leer LINES/COLS. Las columnas de las
+// entidades viven en un unico bloque (arena) reservado por sim_create
+typedef struct
+{
+    int rows, cols; // Dimensiones del tablero
+
+    Position player;                // Posición del jugador
+    EntityColumns projectiles;      // Proyectiles del jugador
+    EntityColumns boss_projectiles; // Proyectiles del jefe
+    EntityColumns enemies;          // Enemigos
+    Boss boss;
+    CollisionGrid grid; // Broadphase de colisiones contra enemigos
+
+    SpawnScheduler spawner; // Reaparicion de los enemigos muertos
+
+    int score;      // Puntuación del jugador
+    int hp;         // Vida del jugador
+    int boss_kills; // Jefes derrotados en la partida
+
+    // Parametros de dificultad. sim_create los deja en los valores de las macros y sim_init
+    // no los toca, asi el modo batch puede probar otros valores sin recompilar
+    int enemy_period; // Cada cuantos ticks se mueven los enemigos (SPEED_LOW_ENEMIES)
+    long boss_ticks;  // Ticks entre la muerte del jefe y su reaparicion (BOSS_TICKS)
+    int spawn_chance; // Probabilidad (%) de reaparecer en cada movimiento (SPAWN_CHANCE)
+    int boss_script;  // Guion de disparos del jefe (BOSS_SCRIPT_GAME)
+
+    unsigned long tick;      // Ticks simulados desde el inicio de la partida
+    unsigned long boss_tick; // Tick en que se reinicio el reloj del jefe
+    Rng rng[RNG_STREAMS];    // Generadores de esta simulacion, uno por subsistema
+
+    void *arena;       // Bloque con todas las columnas de estado
+    size_t arena_size; // Tamaño del bloque en bytes
+} World;
+
+// Cabecera de una instantanea del mundo. La sigue la arena completa
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    int max_enemies;     // Capacidades con que se creo el mundo
+    int max_projectiles;
+    size_t arena_size;
+    World world;         // Campos escalares del mundo (los punteros se ignoran)
+} SnapshotHeader;
+
+#pragma endregion
+
+#pragma region DECLARACIONES_DE_FUNCIONES_DE_SIMULACION
+int pool_spawn(EntityColumns *c);            // Da de alta una entidad con el primer id libre, devuelve su posicion densa o -1
+int pool_spawn_id(EntityColumns *c, int id); // Da de alta la entidad con un id libre concreto
+void pool_remove(EntityColumns *c, int i);   // Da de baja la entidad en la posicion densa i
+void pool_compact(EntityColumns *c);         // Da de baja todas las entidades con active == 0
+
+int sim_create(World *w, int max_enemies, int max_projectiles); // Reserva las columnas de entidades, devuelve -1 si no hay memoria
+int sim_create_pools(World *w, int max_enemies, int max_projectiles, int max_boss_projectiles); // Igual, con otra capacidad de proyectiles del jefe
+void sim_destroy(World *w);                                     // Libera la memoria reservada por sim_create
+void sim_init(World *w, int rows, int cols);                    // Inicializa una partida nueva en un tablero de rows x cols
+void sim_tick(World *w);                                        // Avanza la simulacion un tick (actualizaciones y colisiones)
+void sim_seed(World *w, unsigned long seed);                    // Siembra todos los flujos aleatorios a partir de una semilla
+unsigned int sim_rng_digest(const World *w);                    // Resumen del estado de los generadores para comparar simulaciones
+
+size_t sim_snapshot_size(const World *w);                  // Bytes que ocupa una instantanea de este mundo
+void sim_snapshot(const World *w, void *buffer);           // Copia el estado completo del mundo en buffer
+int sim_restore(World *w, const void *buffer, size_t size); // Restaura una instantanea, -1 si no es valida para este mundo
+
+void move_player(World *w, int direction);    // Mueve al jugador según la dirección indicada
+void shoot(World *w);                         // Dispara un proyectil desde la posición del jugador
+int spawn_projectile(World *w, int x, int y); // Activa un proyectil del jugador en (x, y), devuelve su posicion o -1
+void update_projectiles(World *w);            // Actualiza la posición de los proyectiles
+void update_boss_projectiles(World *w);       // Actualiza la posición de los proyectiles del jefe
+void update_enemies(World *w);                // Actualiza la posición de los enemigos
+void run_spawns(World *w);                    // Hace aparecer los enemigos programados para el tick actual
+int schedule_wave(World *w, unsigned long tick, int count); // Programa una oleada de count enemigos, devuelve -1 si no hay lugar
+void spawn_boss(World *w);                    // Hace aparecer al jefe
+void update_boss(World *w);                   // Actualiza la posición del jefe
+void fire_pattern(World *w);                  // Dispara el patron del guion del jefe que toca en este tick
+int spawn_bullet(World *w, int x, int y, int angle, int speed); // Activa un proyectil del jefe en (x, y), devuelve su posicion o -1
+void check_collisions(World *w);              // Verifica colisiones entre proyectiles y enemigos
+void update_score(World *w, int type);        // Actualiza la puntuación basada en el tipo de enemigo derrotado
+
+int check_collision(Position pos, Position *parts, int size);                  // Comprueba si hay colisión entre dos objetos
+int check_collision_enemies(Position *ship_parts, Position *parts, int size);  // Comprueba si hay colisión entre el barco y los enemigos
+int check_collision_boss(Position boss_projectile, Position *parts, int size); // Comprueba si hay colisión entre el proyectil del jefe y la nave
+#pragma endregion
+
+#endif
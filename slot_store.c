@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include "slot_store.h"
+
+#pragma region FUNCIONES_AUXILIARES
+static void unlink_used(SlotStore *s, int slot)
+{
+    if (s->prev[slot] != -1)
+    {
+        s->next[s->prev[slot]] = s->next[slot];
+    }
+    else
+    {
+        s->head = s->next[slot];
+    }
+    if (s->next[slot] != -1)
+    {
+        s->prev[s->next[slot]] = s->prev[slot];
+    }
+    else
+    {
+        s->tail = s->prev[slot];
+    }
+}
+
+static void push_front(SlotStore *s, int slot)
+{
+    s->prev[slot] = -1;
+    s->next[slot] = s->head;
+    if (s->head != -1)
+    {
+        s->prev[s->head] = slot;
+    }
+    else
+    {
+        s->tail = slot;
+    }
+    s->head = slot;
+}
+
+// Registro usado con su marca: se ordenan los pares para no depender de estado global
+typedef struct
+{
+    int lru;
+    int slot;
+} SlotStamp;
+
+static int compare_lru(const void *a, const void *b)
+{
+    int x = ((const SlotStamp *)a)->lru, y = ((const SlotStamp *)b)->lru;
+    return (x > y) - (x < y);
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_INDICE
+int slot_store_init(SlotStore *s, int capacity)
+{
+    memset(s, 0, sizeof(*s));
+    s->prev = malloc(capacity * sizeof(int));
+    s->next = malloc(capacity * sizeof(int));
+    s->in_use = calloc(capacity, 1);
+    if (s->prev == NULL || s->next == NULL || s->in_use == NULL)
+    {
+        slot_store_free(s);
+        return -1;
+    }
+
+    s->capacity = capacity;
+    s->head = s->tail = -1;
+    s->free_head = capacity > 0 ? 0 : -1;
+    for (int i = 0; i < capacity; i++)
+    {
+        s->next[i] = i + 1 < capacity ? i + 1 : -1;
+    }
+    return 0;
+}
+
+void slot_store_free(SlotStore *s)
+{
+    free(s->prev);
+    free(s->next);
+    free(s->in_use);
+    memset(s, 0, sizeof(*s));
+}
+
+// Se ordenan una sola vez los registros usados por marca; los libres quedan encadenados
+// en orden ascendente para que las partidas nuevas ocupen primero los registros bajos
+void slot_store_load(SlotStore *s, const int *lru)
+{
+    SlotStamp *order = malloc(s->capacity * sizeof(SlotStamp));
+    int used = 0, last_free = -1;
+
+    s->head = s->tail = s->free_head = -1;
+    s->stamp = 0;
+    for (int i = 0; i < s->capacity; i++)
+    {
+        s->in_use[i] = lru[i] > 0;
+        if (s->in_use[i])
+        {
+            if (order != NULL)
+            {
+                order[used] = (SlotStamp){lru[i], i};
+            }
+            used++;
+            s->stamp = lru[i] > s->stamp ? lru[i] : s->stamp;
+            continue;
+        }
+        s->next[i] = -1;
+        if (last_free == -1)
+        {
+            s->free_head = i;
+        }
+        else
+        {
+            s->next[last_free] = i;
+        }
+        last_free = i;
+    }
+    s->used = used;
+
+    if (order == NULL)
+    {
+        // Sin memoria para ordenar se conserva el orden de los registros
+        for (int i = 0; i < s->capacity; i++)
+        {
+            if (s->in_use[i])
+            {
+                push_front(s, i);
+            }
+        }
+        return;
+    }
+    qsort(order, used, sizeof(SlotStamp), compare_lru);
+    for (int k = 0; k < used; k++)
+    {
+        push_front(s, order[k].slot); // De menos a mas reciente: el ultimo queda en head
+    }
+    free(order);
+}
+
+// Devuelve un registro libre o, si el archivo esta lleno, el usado hace mas tiempo. En
+// evicted queda el registro desalojado (-1 si habia uno libre). El registro queda al
+// frente de la lista; el llamador le pide su marca con slot_store_touch
+int slot_store_acquire(SlotStore *s, int *evicted)
+{
+    int slot;
+    *evicted = -1;
+
+    if (s->free_head != -1)
+    {
+        slot = s->free_head;
+        s->free_head = s->next[slot];
+        s->in_use[slot] = 1;
+        s->used++;
+    }
+    else if (s->tail != -1)
+    {
+        slot = s->tail;
+        unlink_used(s, slot);
+        *evicted = slot;
+    }
+    else
+    {
+        return -1; // Capacidad 0
+    }
+    push_front(s, slot);
+    return slot;
+}
+
+int slot_store_touch(SlotStore *s, int slot)
+{
+    if (s->head != slot)
+    {
+        unlink_used(s, slot);
+        push_front(s, slot);
+    }
+    return ++s->stamp;
+}
+#pragma endregion
@@ -0,0 +1,28 @@
+#ifndef SLOT_STORE_H
+#define SLOT_STORE_H
+
+// Indice en memoria de los registros de partidas guardadas. Los registros usados forman
+// una lista doblemente enlazada ordenada por uso (head el mas reciente, tail el menos
+// reciente) y los libres una lista simple, asi que usar, reservar y desalojar son O(1).
+// Cada uso entrega una marca creciente que se guarda en el campo lru de la partida: es
+// lo unico que hay que escribir en el archivo, sin tocar los demas registros
+typedef struct
+{
+    int capacity;          // Registros del archivo
+    int used;              // Registros ocupados
+    int head;              // Registro usado mas recientemente (-1 si no hay)
+    int tail;              // Registro usado menos recientemente (-1 si no hay)
+    int free_head;         // Primer registro libre (-1 si no hay)
+    int *prev;             // Anterior (mas reciente) en la lista de uso
+    int *next;             // Siguiente (menos reciente) en la lista de uso o de libres
+    unsigned char *in_use; // 1 si el registro tiene una partida
+    int stamp;             // Ultima marca de uso entregada
+} SlotStore;
+
+int slot_store_init(SlotStore *s, int capacity);     // Todos los registros libres, -1 si no hay memoria
+void slot_store_free(SlotStore *s);                  // Libera la memoria del indice
+void slot_store_load(SlotStore *s, const int *lru);  // Arma el indice con las marcas leidas del archivo (0 = libre)
+int slot_store_acquire(SlotStore *s, int *evicted);  // Registro para una partida nueva: uno libre o el menos usado
+int slot_store_touch(SlotStore *s, int slot);        // Pasa el registro al frente y devuelve su nueva marca
+
+#endif
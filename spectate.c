@@ -0,0 +1,720 @@
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "spectate.h"
+#include "varint.h"
+
+#define SPECTATE_BACKLOG 8          // Conexiones pendientes de aceptar en el socket
+#define SPECTATE_FALLBACK_POLL_MS 1 // Sin eventfd se revisa cada tanto si hay un cuadro
+#define SPECTATE_HEADER_MAX 128     // Cota de los bytes de un mensaje fuera de los registros de entidades
+#define SPECTATE_RECORD_MAX 25      // Cota de los bytes de un registro: cinco varints de 32 bits
+#define SPECTATE_MAX_CAPACITY (1 << 20) // Mayor capacidad de una clase que acepta el cliente
+
+#pragma region FUNCIONES_AUXILIARES
+// Los buffers se reservan una vez con la cota del peor mensaje, asi que escribir no falla
+static void put_varint(SpectateBytes *b, unsigned long v)
+{
+    b->used += varint_put(b->data + b->used, v);
+}
+
+static int bytes_alloc(SpectateBytes *b, size_t capacity)
+{
+    b->data = malloc(capacity);
+    b->used = 0;
+    b->capacity = capacity;
+    return b->data == NULL ? -1 : 0;
+}
+
+static void bytes_free(SpectateBytes *b)
+{
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+// Mensaje completo: largo del cuerpo y el cuerpo
+static void put_message(SpectateBytes *out, const SpectateBytes *body)
+{
+    out->used = 0;
+    put_varint(out, body->used);
+    memcpy(out->data + out->used, body->data, body->used);
+    out->used += body->used;
+}
+
+static size_t message_bound(const int *capacity)
+{
+    size_t bound = SPECTATE_HEADER_MAX;
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        bound += (size_t)(capacity[c] + 1) * SPECTATE_RECORD_MAX;
+    }
+    return bound;
+}
+#pragma endregion
+
+#pragma region ENTIDADES_POR_ID
+static int track_alloc(SpectateTrack *t, int capacity, int with_seen)
+{
+    memset(t, 0, sizeof(*t));
+    t->capacity = capacity;
+    t->id = malloc(capacity * sizeof(int));
+    t->x = malloc(capacity * sizeof(int));
+    t->y = malloc(capacity * sizeof(int));
+    t->type = malloc(capacity);
+    t->index = malloc(capacity * sizeof(int));
+    t->seen = with_seen ? calloc(capacity, sizeof(unsigned int)) : NULL;
+    if (t->id == NULL || t->x == NULL || t->y == NULL || t->type == NULL || t->index == NULL ||
+        (with_seen && t->seen == NULL))
+    {
+        return -1;
+    }
+    memset(t->index, -1, capacity * sizeof(int));
+    return 0;
+}
+
+static void track_free(SpectateTrack *t)
+{
+    free(t->id);
+    free(t->x);
+    free(t->y);
+    free(t->type);
+    free(t->index);
+    free(t->seen);
+    memset(t, 0, sizeof(*t));
+}
+
+static void track_clear(SpectateTrack *t)
+{
+    for (int i = 0; i < t->count; i++)
+    {
+        t->index[t->id[i]] = -1;
+    }
+    t->count = 0;
+}
+
+// Alta si el id no esta, si no actualiza su posicion y tipo
+static void track_set(SpectateTrack *t, int id, int x, int y, int type)
+{
+    int i = t->index[id];
+    if (i == -1)
+    {
+        i = t->count++;
+        t->index[id] = i;
+        t->id[i] = id;
+    }
+    t->x[i] = x;
+    t->y[i] = y;
+    t->type[i] = (unsigned char)type;
+}
+
+// Baja: la ultima entidad densa ocupa el hueco
+static void track_remove(SpectateTrack *t, int id)
+{
+    int i = t->index[id], last = --t->count;
+    t->id[i] = t->id[last];
+    t->x[i] = t->x[last];
+    t->y[i] = t->y[last];
+    t->type[i] = t->type[last];
+    t->index[t->id[i]] = i;
+    t->index[id] = -1;
+}
+#pragma endregion
+
+#pragma region CODIFICACION
+static int changed_fields(const SpectateFrame *a, const SpectateFrame *b)
+{
+    int mask = 0;
+    mask |= a->state != b->state ? SPECTATE_F_STATE : 0;
+    mask |= a->rows != b->rows || a->cols != b->cols ? SPECTATE_F_SIZE : 0;
+    mask |= a->hp != b->hp || a->score != b->score || a->high_score != b->high_score ? SPECTATE_F_HUD : 0;
+    mask |= a->player_x != b->player_x || a->player_y != b->player_y ? SPECTATE_F_PLAYER : 0;
+    mask |= a->boss_active != b->boss_active || a->boss_x != b->boss_x || a->boss_y != b->boss_y ||
+                    a->boss_hp != b->boss_hp
+                ? SPECTATE_F_BOSS
+                : 0;
+    return mask;
+}
+
+static void put_fields(SpectateBytes *b, const SpectateFrame *f, int mask)
+{
+    put_varint(b, mask);
+    if (mask & SPECTATE_F_STATE)
+    {
+        put_varint(b, f->state);
+    }
+    if (mask & SPECTATE_F_SIZE)
+    {
+        put_varint(b, f->rows);
+        put_varint(b, f->cols);
+    }
+    if (mask & SPECTATE_F_HUD)
+    {
+        put_varint(b, zigzag(f->hp));
+        put_varint(b, zigzag(f->score));
+        put_varint(b, zigzag(f->high_score));
+    }
+    if (mask & SPECTATE_F_PLAYER)
+    {
+        put_varint(b, zigzag(f->player_x));
+        put_varint(b, zigzag(f->player_y));
+    }
+    if (mask & SPECTATE_F_BOSS)
+    {
+        put_varint(b, f->boss_active);
+        put_varint(b, zigzag(f->boss_x));
+        put_varint(b, zigzag(f->boss_y));
+        put_varint(b, zigzag(f->boss_hp));
+    }
+}
+
+static void put_add(SpectateBytes *b, int id, int x, int y, int type)
+{
+    put_varint(b, (unsigned long)id << 2 | SPECTATE_ADD);
+    put_varint(b, zigzag(x));
+    put_varint(b, zigzag(y));
+    put_varint(b, type);
+}
+
+// Compara las entidades del cuadro con las del mensaje anterior y escribe solo las bajas,
+// las altas y los movimientos, dejando el registro igual al cuadro. Cuesta O(entidades vivas)
+static void put_entity_delta(SpectateBytes *b, SpectateTrack *t, const SpectateEntities *e, unsigned int stamp)
+{
+    for (int i = 0; i < e->count; i++)
+    {
+        t->seen[e->id[i]] = stamp;
+    }
+
+    // Bajas: se recorre de atras para adelante porque track_remove mueve la ultima al hueco
+    for (int i = t->count - 1; i >= 0; i--)
+    {
+        int id = t->id[i];
+        if (t->seen[id] != stamp)
+        {
+            put_varint(b, (unsigned long)id << 2 | SPECTATE_REMOVE);
+            track_remove(t, id);
+        }
+    }
+
+    // Un id que reaparece con otro tipo (murio y reaparecio entre dos mensajes) va como alta
+    for (int i = 0; i < e->count; i++)
+    {
+        int id = e->id[i], type = e->type != NULL ? e->type[i] : 0, k = t->index[id];
+        if (k == -1 || t->type[k] != type)
+        {
+            put_add(b, id, e->x[i], e->y[i], type);
+        }
+        else if (t->x[k] != e->x[i] || t->y[k] != e->y[i])
+        {
+            put_varint(b, (unsigned long)id << 2 | SPECTATE_MOVE);
+            put_varint(b, zigzag(e->x[i] - t->x[k]));
+            put_varint(b, zigzag(e->y[i] - t->y[k]));
+        }
+        track_set(t, id, e->x[i], e->y[i], type);
+    }
+    put_varint(b, SPECTATE_END);
+}
+
+static void encode_delta(SpectateServer *s, const SpectateFrame *f)
+{
+    SpectateBytes *b = &s->body;
+    b->used = 0;
+    put_varint(b, SPECTATE_DELTA);
+    put_varint(b, f->tick);
+    put_fields(b, f, s->frames == 0 ? SPECTATE_F_ALL : changed_fields(&s->last, f));
+    s->stamp++;
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        put_entity_delta(b, &s->tracks[c], &f->entities[c], s->stamp);
+    }
+    put_message(&s->delta, b);
+}
+
+// El cuadro clave se arma desde lo que ya se codifico, asi que vale lo mismo que aplicar
+// todos los deltas anteriores
+static void encode_key(SpectateServer *s)
+{
+    SpectateBytes *b = &s->body;
+    b->used = 0;
+    put_varint(b, SPECTATE_KEY);
+    put_varint(b, s->last.tick);
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        put_varint(b, s->tracks[c].capacity);
+    }
+    put_fields(b, &s->last, SPECTATE_F_ALL);
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        SpectateTrack *t = &s->tracks[c];
+        for (int i = 0; i < t->count; i++)
+        {
+            put_add(b, t->id[i], t->x[i], t->y[i], t->type[i]);
+        }
+        put_varint(b, SPECTATE_END);
+    }
+    put_message(&s->key, b);
+}
+#pragma endregion
+
+#pragma region SERVIDOR
+int spectate_server_open(SpectateServer *s, const char *path, const int *capacity)
+{
+    struct sockaddr_un addr;
+    memset(s, 0, sizeof(*s));
+    s->listen_fd = -1;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    // El buffer de cada espectador tiene lugar para al menos dos mensajes completos
+    size_t bound = message_bound(capacity);
+    s->client_buffer = 2 * (bound + 10) > SPECTATE_CLIENT_BUFFER ? 2 * (bound + 10) : SPECTATE_CLIENT_BUFFER;
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        if (track_alloc(&s->tracks[c], capacity[c], 1) != 0)
+        {
+            spectate_server_close(s);
+            return -1;
+        }
+    }
+    if (bytes_alloc(&s->body, bound) != 0 || bytes_alloc(&s->delta, bound + 10) != 0 ||
+        bytes_alloc(&s->key, bound + 10) != 0)
+    {
+        spectate_server_close(s);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path); // Un socket que quedo de una ejecucion anterior
+    s->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->listen_fd == -1 || bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s->listen_fd, SPECTATE_BACKLOG) != 0)
+    {
+        spectate_server_close(s);
+        return -1;
+    }
+    s->path = path;
+    return 0;
+}
+
+static void drop_client(SpectateServer *s, int i)
+{
+    close(s->clients[i].fd);
+    free(s->clients[i].pending);
+    s->clients[i] = s->clients[--s->client_count];
+}
+
+void spectate_server_close(SpectateServer *s)
+{
+    while (s->client_count > 0)
+    {
+        drop_client(s, s->client_count - 1);
+    }
+    if (s->listen_fd != -1)
+    {
+        close(s->listen_fd);
+        s->listen_fd = -1;
+    }
+    if (s->path != NULL)
+    {
+        unlink(s->path);
+        s->path = NULL;
+    }
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        track_free(&s->tracks[c]);
+    }
+    bytes_free(&s->body);
+    bytes_free(&s->delta);
+    bytes_free(&s->key);
+}
+
+// Escribe lo pendiente sin bloquear. Devuelve -1 si el espectador se desconecto
+static int flush_client(SpectateServer *s, SpectateClient *c)
+{
+    while (c->used > 0)
+    {
+        ssize_t n = send(c->fd, c->pending, c->used, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        memmove(c->pending, c->pending + n, c->used - n);
+        c->used -= n;
+        s->sent_bytes += n;
+    }
+    return 0;
+}
+
+static int append_message(SpectateServer *s, SpectateClient *c, const SpectateBytes *m)
+{
+    if (c->used + m->used > s->client_buffer)
+    {
+        return 0;
+    }
+    memcpy(c->pending + c->used, m->data, m->used);
+    c->used += m->used;
+    return 1;
+}
+
+static void accept_clients(SpectateServer *s)
+{
+    int fd;
+    while ((fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+    {
+        SpectateClient *c = &s->clients[s->client_count];
+        if (s->client_count == SPECTATE_MAX_CLIENTS || (c->pending = malloc(s->client_buffer)) == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->used = 0;
+        c->need_key = 1; // Un espectador nuevo arranca con el estado completo
+        s->client_count++;
+        s->accepted++;
+    }
+}
+
+// Duerme en poll sobre el socket de escucha, el eventfd de los cuadros y los espectadores
+// que tienen bytes pendientes. Los espectadores no envian nada: leer 0 bytes es que cerraron
+int spectate_server_wait(SpectateServer *s, FrameBuffer *frames)
+{
+    struct pollfd fds[SPECTATE_MAX_CLIENTS + 2];
+    int count = s->client_count;
+    fds[0] = (struct pollfd){s->listen_fd, POLLIN, 0};
+    fds[1] = (struct pollfd){frames->wake_fd, POLLIN, 0};
+    for (int i = 0; i < count; i++)
+    {
+        fds[i + 2] = (struct pollfd){s->clients[i].fd, POLLIN | (s->clients[i].used > 0 ? POLLOUT : 0), 0};
+    }
+    if (poll(fds, count + 2, frames->wake_fd != -1 ? -1 : SPECTATE_FALLBACK_POLL_MS) < 0)
+    {
+        return -1;
+    }
+
+    // De atras para adelante porque drop_client mueve el ultimo espectador al hueco
+    for (int i = count - 1; i >= 0; i--)
+    {
+        short ev = fds[i + 2].revents;
+        char discard[256];
+        if ((ev & (POLLHUP | POLLERR)) || ((ev & POLLIN) && recv(s->clients[i].fd, discard, sizeof(discard), 0) <= 0) ||
+            ((ev & POLLOUT) && flush_client(s, &s->clients[i]) != 0))
+        {
+            drop_client(s, i);
+        }
+    }
+    if (fds[0].revents & POLLIN)
+    {
+        accept_clients(s);
+    }
+    if (frames->wake_fd == -1 || (fds[1].revents & POLLIN))
+    {
+        return frame_buffer_wait(frames);
+    }
+    return -1;
+}
+
+// El delta se codifica una sola vez y se copia en cada espectador; el cuadro clave solo se
+// arma si algun espectador lo necesita. Un espectador cuyo buffer no tiene lugar pierde
+// este delta y los siguientes hasta vaciar lo pendiente, y ahi recibe un cuadro clave
+void spectate_server_send(SpectateServer *s, const SpectateFrame *f)
+{
+    encode_delta(s, f);
+    s->last = *f;
+    s->frames++;
+    s->delta_bytes += s->delta.used;
+
+    int key_ready = 0;
+    for (int i = s->client_count - 1; i >= 0; i--)
+    {
+        SpectateClient *c = &s->clients[i];
+        if (c->need_key)
+        {
+            if (c->used > 0)
+            {
+                continue;
+            }
+            if (!key_ready)
+            {
+                encode_key(s);
+                key_ready = 1;
+            }
+            append_message(s, c, &s->key); // Con el buffer vacio siempre entra
+            c->need_key = 0;
+            s->keyframes++;
+        }
+        else if (!append_message(s, c, &s->delta))
+        {
+            c->need_key = 1;
+            s->resyncs++;
+        }
+        if (flush_client(s, c) != 0)
+        {
+            drop_client(s, i);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region CLIENTE
+int spectate_connect(SpectateReader *r, const char *path)
+{
+    struct sockaddr_un addr;
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    r->in = malloc(SPECTATE_READ_BUFFER);
+    r->capacity = SPECTATE_READ_BUFFER;
+    r->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (r->in == NULL || r->fd == -1 || connect(r->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        spectate_disconnect(r);
+        return -1;
+    }
+    return 0;
+}
+
+void spectate_disconnect(SpectateReader *r)
+{
+    if (r->fd != -1)
+    {
+        close(r->fd);
+    }
+    free(r->in);
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        track_free(&r->tracks[c]);
+    }
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static int get_fields(SpectateFrame *f, const unsigned char **p, const unsigned char *end)
+{
+    unsigned long mask, v[4];
+    if (varint_get(p, end, &mask) != 0)
+    {
+        return -1;
+    }
+    if (mask & SPECTATE_F_STATE)
+    {
+        if (varint_get(p, end, &v[0]) != 0)
+        {
+            return -1;
+        }
+        f->state = (int)v[0];
+    }
+    if (mask & SPECTATE_F_SIZE)
+    {
+        if (varint_get(p, end, &v[0]) != 0 || varint_get(p, end, &v[1]) != 0)
+        {
+            return -1;
+        }
+        f->rows = (int)v[0];
+        f->cols = (int)v[1];
+    }
+    if (mask & SPECTATE_F_HUD)
+    {
+        if (varint_get(p, end, &v[0]) != 0 || varint_get(p, end, &v[1]) != 0 || varint_get(p, end, &v[2]) != 0)
+        {
+            return -1;
+        }
+        f->hp = unzigzag(v[0]);
+        f->score = unzigzag(v[1]);
+        f->high_score = unzigzag(v[2]);
+    }
+    if (mask & SPECTATE_F_PLAYER)
+    {
+        if (varint_get(p, end, &v[0]) != 0 || varint_get(p, end, &v[1]) != 0)
+        {
+            return -1;
+        }
+        f->player_x = unzigzag(v[0]);
+        f->player_y = unzigzag(v[1]);
+    }
+    if (mask & SPECTATE_F_BOSS)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            if (varint_get(p, end, &v[k]) != 0)
+            {
+                return -1;
+            }
+        }
+        f->boss_active = (int)v[0];
+        f->boss_x = unzigzag(v[1]);
+        f->boss_y = unzigzag(v[2]);
+        f->boss_hp = unzigzag(v[3]);
+    }
+    return 0;
+}
+
+static int get_entities(SpectateTrack *t, const unsigned char **p, const unsigned char *end)
+{
+    unsigned long rec, a, b, c;
+    while (varint_get(p, end, &rec) == 0)
+    {
+        int op = rec & 3;
+        unsigned long id = rec >> 2;
+        if (op == SPECTATE_END)
+        {
+            return 0;
+        }
+        if (id >= (unsigned long)t->capacity)
+        {
+            return -1;
+        }
+        if (op == SPECTATE_REMOVE)
+        {
+            if (t->index[id] == -1)
+            {
+                return -1;
+            }
+            track_remove(t, (int)id);
+        }
+        else if (op == SPECTATE_ADD)
+        {
+            if (varint_get(p, end, &a) != 0 || varint_get(p, end, &b) != 0 || varint_get(p, end, &c) != 0)
+            {
+                return -1;
+            }
+            track_set(t, (int)id, unzigzag(a), unzigzag(b), (int)c);
+        }
+        else
+        {
+            int k = t->index[id];
+            if (k == -1 || varint_get(p, end, &a) != 0 || varint_get(p, end, &b) != 0)
+            {
+                return -1;
+            }
+            track_set(t, (int)id, t->x[k] + unzigzag(a), t->y[k] + unzigzag(b), t->type[k]);
+        }
+    }
+    return -1;
+}
+
+// Aplica un cuerpo de mensaje. Los deltas que llegan antes del primer cuadro clave se ignoran
+static int apply_message(SpectateReader *r, const unsigned char *p, const unsigned char *end)
+{
+    unsigned long kind, tick, capacity;
+    if (varint_get(&p, end, &kind) != 0 || varint_get(&p, end, &tick) != 0)
+    {
+        return -1;
+    }
+    if (kind == SPECTATE_KEY)
+    {
+        for (int c = 0; c < SPECTATE_CLASSES; c++)
+        {
+            SpectateTrack *t = &r->tracks[c];
+            if (varint_get(&p, end, &capacity) != 0 || capacity > SPECTATE_MAX_CAPACITY)
+            {
+                return -1;
+            }
+            if (t->capacity != (int)capacity)
+            {
+                track_free(t);
+                if (track_alloc(t, (int)capacity, 0) != 0)
+                {
+                    return -1;
+                }
+            }
+            track_clear(t);
+        }
+        r->synced = 1;
+        r->keyframes++;
+    }
+    else if (kind != SPECTATE_DELTA)
+    {
+        return -1;
+    }
+    if (!r->synced)
+    {
+        return 0;
+    }
+
+    r->frame.tick = tick;
+    if (get_fields(&r->frame, &p, end) != 0)
+    {
+        return -1;
+    }
+    for (int c = 0; c < SPECTATE_CLASSES; c++)
+    {
+        SpectateTrack *t = &r->tracks[c];
+        if (get_entities(t, &p, end) != 0)
+        {
+            return -1;
+        }
+        r->frame.entities[c] = (SpectateEntities){t->count, t->id, t->x, t->y, t->type};
+    }
+    r->messages++;
+    return 0;
+}
+
+// Lee una vez del socket y aplica todos los mensajes completos. Lo que queda de un mensaje
+// cortado se mueve al principio del buffer para la proxima lectura
+int spectate_read(SpectateReader *r)
+{
+    ssize_t n = read(r->fd, r->in + r->used, r->capacity - r->used);
+    if (n <= 0)
+    {
+        return n < 0 && errno == EINTR ? 0 : -1;
+    }
+    r->used += n;
+    r->bytes += n;
+
+    int applied = 0;
+    const unsigned char *p = r->in, *end = r->in + r->used;
+    while (p < end)
+    {
+        unsigned long len;
+        const unsigned char *body = p;
+        int header = varint_get(&body, end, &len);
+        if ((header != 0 && end - p >= 10) || (header == 0 && len > SPECTATE_MAX_MESSAGE))
+        {
+            return -1; // Un largo imposible: el flujo esta dañado
+        }
+        if (header != 0 || len > (unsigned long)(end - body))
+        {
+            // El resto del mensaje llega en las proximas lecturas; si no entra se agranda el buffer
+            size_t need = (body - p) + (header == 0 ? len : 0);
+            if (need > r->capacity && p == r->in)
+            {
+                unsigned char *grown = realloc(r->in, need);
+                if (grown == NULL)
+                {
+                    return -1;
+                }
+                r->in = grown;
+                r->capacity = need;
+                return applied;
+            }
+            break;
+        }
+        if (apply_message(r, body, body + len) != 0)
+        {
+            return -1;
+        }
+        p = body + len;
+        applied++;
+    }
+    r->used = end - p;
+    memmove(r->in, p, r->used);
+    return applied;
+}
+#pragma endregion
@@ -0,0 +1,129 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <stddef.h>
+#include "frame_buffer.h"
+
+#define SPECTATE_DEFAULT_PATH "alien_invasion.sock" // Socket que usa --spectate si no se indica otro
+#define SPECTATE_CLASSES 3             // Proyectiles del jugador, enemigos y proyectiles del jefe
+#define SPECTATE_MAX_CLIENTS 32        // Espectadores conectados a la vez como maximo
+#define SPECTATE_CLIENT_BUFFER 65536   // Bytes pendientes por espectador (al menos dos mensajes); si se llena se resincroniza con un cuadro clave
+#define SPECTATE_READ_BUFFER 65536     // Buffer inicial del cliente; crece si llega un mensaje mas grande
+#define SPECTATE_MAX_MESSAGE (64 << 20) // Mensaje mas grande que acepta el cliente
+
+// Mensajes. Cada mensaje es un varint con el largo del cuerpo seguido del cuerpo: varint
+// tipo, varint tick, (solo el cuadro clave: capacidad de cada clase), varint mascara de
+// campos con los campos que cambiaron y, por cada clase, registros de entidades terminados
+// en SPECTATE_END. Un cuadro clave trae todos los campos y todas las entidades como altas
+#define SPECTATE_DELTA 0 // Cambios respecto del mensaje anterior
+#define SPECTATE_KEY 1   // Estado completo: el cliente descarta lo que tenia
+
+// Campos de la mascara
+#define SPECTATE_F_STATE 1  // Estado del juego
+#define SPECTATE_F_SIZE 2   // Filas y columnas del tablero
+#define SPECTATE_F_HUD 4    // Vida, puntos y mejor puntuacion (zigzag)
+#define SPECTATE_F_PLAYER 8 // Posicion de la nave
+#define SPECTATE_F_BOSS 16  // Jefe activo, posicion y vida (zigzag)
+#define SPECTATE_F_ALL 31
+
+// Registros de entidades: varint (id << 2 | operacion) y sus datos
+#define SPECTATE_REMOVE 0 // Baja
+#define SPECTATE_ADD 1    // Alta (o cambio de tipo): varint x, y, tipo
+#define SPECTATE_MOVE 2   // Movimiento: zigzag dx, dy
+#define SPECTATE_END 3    // Fin de la clase
+
+// Entidades de una clase en columnas densas, vistas desde afuera sin copiarlas
+typedef struct
+{
+    int count;
+    const int *id, *x, *y;
+    const unsigned char *type; // NULL si la clase no tiene tipo
+} SpectateEntities;
+
+// Lo que ve un espectador en un tick
+typedef struct
+{
+    unsigned long tick;
+    int state, rows, cols;
+    int hp, score, high_score;
+    int player_x, player_y;
+    int boss_active, boss_x, boss_y, boss_hp;
+    SpectateEntities entities[SPECTATE_CLASSES];
+} SpectateFrame;
+
+// Entidades de una clase indexadas por id. Las vivas son densas en [0, count) y index[id]
+// da su posicion, asi que altas, bajas y movimientos son O(1). La usa el servidor para
+// recordar lo que ya mando y el cliente para reconstruir lo que recibe
+typedef struct
+{
+    int capacity;        // Ids posibles [0, capacity)
+    int count;           // Entidades vivas
+    int *id, *x, *y;     // Columnas densas
+    unsigned char *type; // Columna densa de tipos (0 en las clases sin tipo)
+    int *index;          // Posicion densa de cada id (-1 si no esta)
+    unsigned int *seen;  // Servidor: ultimo mensaje en que aparecio cada id
+} SpectateTrack;
+
+// Buffer de bytes reservado una vez con la cota del peor mensaje
+typedef struct
+{
+    unsigned char *data;
+    size_t used, capacity;
+} SpectateBytes;
+
+// Espectador conectado. Su buffer solo guarda mensajes completos: si uno no entra, el
+// espectador deja de recibir cambios hasta vaciar lo pendiente y recibe un cuadro clave
+typedef struct
+{
+    int fd;
+    unsigned char *pending; // client_buffer bytes
+    size_t used;            // Bytes pendientes de enviar
+    int need_key;           // 1 si el proximo mensaje tiene que ser un cuadro clave
+} SpectateClient;
+
+// Servidor de espectadores. Lo maneja un solo hilo: acepta conexiones, codifica cada cuadro
+// una vez (un delta para todos y un cuadro clave solo si alguien lo necesita) y lo copia
+// en el buffer de cada espectador, escribiendo sin bloquear
+typedef struct
+{
+    int listen_fd;
+    const char *path;
+    SpectateTrack tracks[SPECTATE_CLASSES]; // Entidades del ultimo mensaje codificado
+    SpectateFrame last;                     // Campos del ultimo mensaje codificado
+    unsigned int stamp;                     // Mensajes codificados
+    SpectateBytes delta, key, body;         // Mensajes del cuadro actual y cuerpo en construccion
+    SpectateClient clients[SPECTATE_MAX_CLIENTS];
+    int client_count;
+    size_t client_buffer; // Bytes del buffer de cada espectador
+    long accepted;   // Conexiones aceptadas en total
+    long keyframes;  // Cuadros clave enviados
+    long resyncs;    // Veces que un espectador lento perdio deltas y hubo que resincronizarlo
+    long frames;     // Cuadros codificados
+    long delta_bytes; // Bytes de los deltas codificados
+    long sent_bytes;  // Bytes escritos en los sockets
+} SpectateServer;
+
+// Lado del espectador: decodifica el flujo y mantiene el ultimo estado recibido
+typedef struct
+{
+    int fd;
+    unsigned char *in; // Bytes recibidos sin decodificar
+    size_t used, capacity;
+    SpectateTrack tracks[SPECTATE_CLASSES];
+    SpectateFrame frame; // Ultimo estado; sus entidades apuntan a tracks
+    int synced;          // 1 despues del primer cuadro clave
+    long messages;       // Mensajes decodificados
+    long keyframes;      // Cuadros clave recibidos
+    long bytes;          // Bytes recibidos
+} SpectateReader;
+
+int spectate_server_open(SpectateServer *s, const char *path, const int *capacity); // Crea el socket en path, -1 si falla
+void spectate_server_close(SpectateServer *s);                     // Desconecta a todos y borra el socket
+int spectate_server_wait(SpectateServer *s, FrameBuffer *frames);   // Atiende conexiones y envios hasta que hay un cuadro: su slot, o -1
+void spectate_server_send(SpectateServer *s, const SpectateFrame *f); // Codifica el cuadro y lo encola para cada espectador
+
+int spectate_connect(SpectateReader *r, const char *path); // Se conecta al socket de un juego, -1 si falla
+void spectate_disconnect(SpectateReader *r);               // Cierra la conexion y libera el estado
+int spectate_read(SpectateReader *r);                      // Lee lo disponible y aplica los mensajes completos: cuantos, -1 al cerrar o si el flujo esta dañado
+
+#endif
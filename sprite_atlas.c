@@ -0,0 +1,72 @@
+#include <pthread.h>
+#include "sprite_atlas.h"
+
+#pragma region DIBUJOS
+const SpriteArt sprite_art[SPRITE_COUNT] = {
+    [SPRITE_SHIP] = {5, {
+        {0, 0, "A", 1}, // Azul
+        {-1, 1, "MTM", 2}, // Magenta
+        {-2, 2, "WTTTW", 2},
+        {-4, 3, "TTTTHTTTT", 1}, // Azul
+        {-2, 4, "UUUUU", 1},
+    }},
+    // Disenno del boss
+    /*
+     /\^/\
+    ( o o )
+     \ v /
+     /-"-\
+    */
+    [SPRITE_BOSS] = {4, {
+        {0, -3, "/\\^/\\", 1}, // Azul
+        {-1, -2, "( o o )", 2}, // Magenta
+        {0, -1, "\\ v /", 2},
+        {0, 0, "/-\"-\\ ", 1}, // Azul
+    }},
+    [SPRITE_ENEMY + 0] = {2, {
+        {-2, 0, " (@@) ", 3},
+        {-2, 1, " /\"\"\\ ", 3},
+    }},
+    [SPRITE_ENEMY + 1] = {2, {
+        {-2, 0, " dOOb ", 5},
+        {-2, 1, " ^/\\^ ", 5},
+    }},
+    [SPRITE_ENEMY + 2] = {2, {
+        {-2, 0, " /MM\\ ", 4},
+        {-2, 1, " |~~| ", 4},
+    }},
+};
+#pragma endregion
+
+#pragma region CELDAS_DE_COLISION
+static Hitbox hitboxes[SPRITE_COUNT];
+static pthread_once_t hitboxes_once = PTHREAD_ONCE_INIT;
+
+// Las celdas de colision son los caracteres visibles de cada fila, asi que coinciden con lo
+// que se ve en pantalla. Los mundos del modo batch se crean en paralelo: pthread_once
+// garantiza que la tabla se arma una sola vez
+static void build_hitboxes()
+{
+    for (int s = 0; s < SPRITE_COUNT; s++)
+    {
+        Hitbox *h = &hitboxes[s];
+        for (int r = 0; r < sprite_art[s].rows; r++)
+        {
+            const SpriteRow *row = &sprite_art[s].row[r];
+            for (int c = 0; row->text[c] != '\0'; c++)
+            {
+                if (row->text[c] != ' ' && h->count < SPRITE_MAX_CELLS)
+                {
+                    h->cell[h->count++] = (Position){row->dx + c, row->dy};
+                }
+            }
+        }
+    }
+}
+
+const Hitbox *sprite_hitbox(int sprite)
+{
+    pthread_once(&hitboxes_once, build_hitboxes);
+    return &hitboxes[sprite];
+}
+#pragma endregion
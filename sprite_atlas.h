@@ -0,0 +1,41 @@
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+#include "sim.h"
+
+#define SPRITE_SHIP 0        // Nave del jugador
+#define SPRITE_BOSS 1        // Jefe
+#define SPRITE_ENEMY 2       // Primer enemigo: el de tipo t es SPRITE_ENEMY + t
+#define SPRITE_COUNT (SPRITE_ENEMY + ENEMY_TYPES)
+#define SPRITE_MAX_ROWS 5    // Filas de un sprite como maximo
+#define SPRITE_MAX_WIDTH 16  // Columnas de una fila como maximo
+#define SPRITE_MAX_CELLS 32  // Celdas de colision de un sprite como maximo
+
+// Fila de un sprite: texto y par de colores, desplazados respecto a la posicion de la entidad
+typedef struct
+{
+    int dx, dy;
+    const char *text;
+    int color; // Par de colores de ncurses
+} SpriteRow;
+
+// Dibujo de una entidad. Es la unica definicion de cada sprite: sprites.c la convierte en
+// celdas con el color incluido y la simulacion toma de aca las celdas de colision
+typedef struct
+{
+    int rows;
+    SpriteRow row[SPRITE_MAX_ROWS];
+} SpriteArt;
+
+// Celdas de colision de un sprite: las que no son espacios, relativas a la posicion de la entidad
+typedef struct
+{
+    int count;
+    Position cell[SPRITE_MAX_CELLS];
+} Hitbox;
+
+extern const SpriteArt sprite_art[SPRITE_COUNT]; // Dibujos indexados por SPRITE_*
+
+const Hitbox *sprite_hitbox(int sprite); // Celdas de colision del sprite (se calculan una vez para todos los hilos)
+
+#endif
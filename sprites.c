@@ -0,0 +1,75 @@
+#include <pthread.h>
+#include "sprites.h"
+#include "sprite_atlas.h"
+
+#pragma region SPRITES_PRECOMPILADOS
+// Fila de un sprite lista para copiar al buffer: cada celda ya lleva su par de colores
+typedef struct
+{
+    int dx, dy, len;
+    chtype cells[SPRITE_MAX_WIDTH];
+} BakedRow;
+
+typedef struct
+{
+    int rows;
+    BakedRow row[SPRITE_MAX_ROWS];
+} BakedSprite;
+
+static BakedSprite baked[SPRITE_COUNT];
+static pthread_once_t baked_once = PTHREAD_ONCE_INIT; // Las sesiones del anfitrion dibujan desde varios hilos
+
+// Convierte una sola vez los dibujos de sprite_atlas.c en celdas. Dibujar un sprite queda
+// en copiar sus filas al buffer, sin recorrer textos ni combinar atributos en cada cuadro
+static void bake_sprites()
+{
+    for (int s = 0; s < SPRITE_COUNT; s++)
+    {
+        baked[s].rows = sprite_art[s].rows;
+        for (int r = 0; r < sprite_art[s].rows; r++)
+        {
+            const SpriteRow *src = &sprite_art[s].row[r];
+            BakedRow *dst = &baked[s].row[r];
+            dst->dx = src->dx;
+            dst->dy = src->dy;
+            dst->len = 0;
+            while (src->text[dst->len] != '\0' && dst->len < SPRITE_MAX_WIDTH)
+            {
+                dst->cells[dst->len] = (unsigned char)src->text[dst->len] | COLOR_PAIR(src->color);
+                dst->len++;
+            }
+        }
+    }
+}
+
+static void blit_sprite(int sprite, int x, int y)
+{
+    pthread_once(&baked_once, bake_sprites);
+    const BakedSprite *s = &baked[sprite];
+    for (int r = 0; r < s->rows; r++)
+    {
+        render_cells(y + s->row[r].dy, x + s->row[r].dx, s->row[r].cells, s->row[r].len);
+    }
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_DIBUJO
+void draw_ship(int x, int y)
+{
+    blit_sprite(SPRITE_SHIP, x, y);
+}
+
+void draw_boss(int x, int y)
+{
+    blit_sprite(SPRITE_BOSS, x, y);
+}
+
+// Dibuja un enemigo según su tipo
+void draw_enemy(int x, int y, int type)
+{
+    if (type >= 0 && type < ENEMY_TYPES)
+    {
+        blit_sprite(SPRITE_ENEMY + type, x, y);
+    }
+}
+#pragma endregion
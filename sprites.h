@@ -0,0 +1,11 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include "render.h"
+
+// Sprites de las entidades (definidos en sprite_atlas.c). Se copian al buffer del renderizador con render_cells
+void draw_ship(int x, int y);            // Dibuja el barco del jugador
+void draw_enemy(int x, int y, int type); // Dibuja un enemigo en la pantalla
+void draw_boss(int x, int y);            // Dibuja el Jefe
+
+#endif
@@ -0,0 +1,635 @@
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include "term.h"
+
+#pragma region ESTADO_DE_LA_TERMINAL
+// Pantalla de la terminal. La del proceso usa stdin/stdout; el modo anfitrion crea una por
+// sesion sobre su pty con term_screen_create y cada hilo elige con term_select en cual
+// dibuja, asi el resto del codigo sigue llamando a term_* sin saber cual es.
+// Backend ANSI: term_put compone en next (caracter y par de colores por celda) y term_flush
+// compara next con shown, lo que la terminal tiene en pantalla, fila por fila. Solo se
+// recorren las columnas [dirty_lo, dirty_hi) de cada fila tocada. Las secuencias se
+// acumulan en out y salen con un solo write(). cur_* es el estado de la terminal despues
+// de lo ya acumulado, asi solo se emiten los movimientos y colores que cambian
+struct TermScreen
+{
+    int backend;
+    int out_fd, in_fd;
+    int pair_fg[TERM_PAIRS], pair_bg[TERM_PAIRS]; // Colores de cada par (-1 el de la terminal)
+    int rows, cols;
+    int fixed_size; // 1 si el tamaño no se consulta al recibir SIGWINCH (pantallas de sesion)
+    chtype *next, *shown;
+    int *dirty_lo, *dirty_hi;
+    int buf_rows, buf_cols;
+    char *out;
+    size_t out_len, out_cap;
+    int cur_y, cur_x;   // Posicion del cursor (-1 desconocida)
+    int cur_fg, cur_bg; // Colores activos (-1 desconocidos)
+    unsigned char in_buf[64]; // Bytes leidos que todavia no forman una tecla completa
+    int in_len;
+    int stalled;  // La ultima escritura no entro entera: se espera a que el descriptor acepte mas
+    long dropped; // Cuadros descartados porque el descriptor estaba lleno
+};
+
+static TermScreen process_screen = {.backend = TERM_NCURSES, .out_fd = STDOUT_FILENO, .in_fd = STDIN_FILENO,
+                                    .rows = 24, .cols = 80, .cur_y = -1, .cur_x = -1, .cur_fg = -1, .cur_bg = -1};
+static _Thread_local TermScreen *screen = &process_screen; // Pantalla del hilo que llama
+static struct termios saved_termios;
+static int termios_saved;
+static volatile sig_atomic_t resized; // Lo marca SIGWINCH, se lee el tamaño nuevo en term_rows/term_cols
+#pragma endregion
+
+#pragma region FUNCIONES_AUXILIARES
+static void out_append(TermScreen *s, const char *text, size_t n)
+{
+    if (s->out_len + n > s->out_cap)
+    {
+        size_t cap = s->out_cap ? s->out_cap : 4096;
+        while (cap < s->out_len + n)
+        {
+            cap *= 2;
+        }
+        char *grown = realloc(s->out, cap);
+        if (grown == NULL)
+        {
+            return; // Sin memoria se pierde el texto; el proximo term_clear redibuja todo
+        }
+        s->out = grown;
+        s->out_cap = cap;
+    }
+    memcpy(s->out + s->out_len, text, n);
+    s->out_len += n;
+}
+
+static void out_printf(TermScreen *s, const char *fmt, ...)
+{
+    char text[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    out_append(s, text, n < (int)sizeof(text) ? n : (int)sizeof(text) - 1);
+}
+
+// Devuelve -1 si no se pudo escribir todo. En un descriptor no bloqueante pasa cuando se
+// llena (una pty a la que nadie esta leyendo): lo que no entro se pierde
+static int write_all(int fd, const char *s, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = write(fd, s, n);
+        if (w <= 0)
+        {
+            return -1;
+        }
+        s += w;
+        n -= w;
+    }
+    return 0;
+}
+
+static int digits(int v)
+{
+    return v >= 100 ? 3 : v >= 10 ? 2 : 1;
+}
+
+// Mueve el cursor con la secuencia mas corta entre posicion absoluta (CUP), columna (CHA),
+// fila (VPA) y avance relativo (CUF)
+static void move_to(TermScreen *s, int y, int x)
+{
+    if (y == s->cur_y && x == s->cur_x)
+    {
+        return;
+    }
+    if (y == s->cur_y && s->cur_x >= 0 && x > s->cur_x && digits(x - s->cur_x) <= digits(x + 1))
+    {
+        if (x - s->cur_x == 1)
+        {
+            out_append(s, "\033[C", 3);
+        }
+        else
+        {
+            out_printf(s, "\033[%dC", x - s->cur_x);
+        }
+    }
+    else if (y == s->cur_y)
+    {
+        out_printf(s, "\033[%dG", x + 1);
+    }
+    else if (x == s->cur_x)
+    {
+        out_printf(s, "\033[%dd", y + 1);
+    }
+    else
+    {
+        out_printf(s, "\033[%d;%dH", y + 1, x + 1);
+    }
+    s->cur_y = y;
+    s->cur_x = x;
+}
+
+// Emite un SGR solo con los colores que cambian respecto a los activos
+static void set_colors(TermScreen *s, int fg, int bg)
+{
+    if (fg != s->cur_fg && bg != s->cur_bg)
+    {
+        out_printf(s, "\033[3%d;4%dm", fg, bg);
+    }
+    else if (fg != s->cur_fg)
+    {
+        out_printf(s, "\033[3%dm", fg);
+    }
+    else if (bg != s->cur_bg)
+    {
+        out_printf(s, "\033[4%dm", bg);
+    }
+    s->cur_fg = fg;
+    s->cur_bg = bg;
+}
+
+// Indica si la celda se ve igual escribiendola con los colores activos: un espacio solo
+// necesita el fondo. Permite reescribir huecos cortos en lugar de mover el cursor
+static int matches_colors(const TermScreen *s, chtype cell)
+{
+    int pair = PAIR_NUMBER(cell & A_COLOR) % TERM_PAIRS;
+    return cell != 0 && s->pair_bg[pair] == s->cur_bg && ((cell & A_CHARTEXT) == ' ' || s->pair_fg[pair] == s->cur_fg);
+}
+
+static void emit_cell(TermScreen *s, chtype cell)
+{
+    int pair = PAIR_NUMBER(cell & A_COLOR) % TERM_PAIRS;
+    char c = cell & A_CHARTEXT;
+    if (!matches_colors(s, cell))
+    {
+        set_colors(s, c == ' ' && s->pair_bg[pair] == s->cur_bg ? s->cur_fg : s->pair_fg[pair], s->pair_bg[pair]);
+    }
+    out_append(s, &c, 1);
+}
+
+static void free_buffers(TermScreen *s)
+{
+    free(s->next);
+    free(s->shown);
+    free(s->dirty_lo);
+    free(s->dirty_hi);
+    s->next = s->shown = NULL;
+    s->dirty_lo = s->dirty_hi = NULL;
+    s->buf_rows = s->buf_cols = 0;
+}
+
+// Ajusta los buffers de celdas al tamaño de la terminal. Con un tamaño nuevo no se sabe
+// que hay en pantalla: shown queda en 0, que no coincide con ninguna celda
+static void ensure_buffers(TermScreen *s)
+{
+    int rows = term_rows(), cols = term_cols();
+    if (s->next != NULL && rows == s->buf_rows && cols == s->buf_cols)
+    {
+        return;
+    }
+    free_buffers(s);
+    s->next = malloc(rows * cols * sizeof(chtype));
+    s->shown = calloc(rows * cols, sizeof(chtype));
+    s->dirty_lo = malloc(rows * sizeof(int));
+    s->dirty_hi = malloc(rows * sizeof(int));
+    if (s->next == NULL || s->shown == NULL || s->dirty_lo == NULL || s->dirty_hi == NULL)
+    {
+        free_buffers(s);
+        return;
+    }
+    s->buf_rows = rows;
+    s->buf_cols = cols;
+    for (int i = 0; i < rows * cols; i++)
+    {
+        s->next[i] = ' ';
+    }
+    for (int y = 0; y < rows; y++)
+    {
+        s->dirty_lo[y] = 0;
+        s->dirty_hi[y] = cols;
+    }
+}
+
+// Despues de una escritura cortada no se sabe que quedo en pantalla ni donde quedo el
+// cursor: se marca todo como desconocido para que el proximo cuadro redibuje cada celda
+static void forget_shown(TermScreen *s)
+{
+    if (s->shown != NULL)
+    {
+        memset(s->shown, 0, s->buf_rows * s->buf_cols * sizeof(chtype));
+    }
+    for (int y = 0; y < s->buf_rows; y++)
+    {
+        s->dirty_lo[y] = 0;
+        s->dirty_hi[y] = s->buf_cols;
+    }
+    s->cur_y = s->cur_x = -1;
+    s->cur_fg = s->cur_bg = -1;
+}
+
+static void query_size(TermScreen *s)
+{
+    struct winsize ws;
+    if (ioctl(s->out_fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0)
+    {
+        s->rows = ws.ws_row;
+        s->cols = ws.ws_col;
+    }
+}
+
+static void on_resize(int sig)
+{
+    (void)sig;
+    resized = 1;
+}
+
+// Si el proceso muere por una señal se deja la terminal como estaba (solo llamadas seguras en un handler)
+static void on_fatal(int sig)
+{
+    static const char restore[] = "\033[0m\033[?25h\033[?1049l";
+    if (write(STDOUT_FILENO, restore, sizeof(restore) - 1) < 0)
+    {
+        // Nada mas que hacer
+    }
+    if (termios_saved)
+    {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Sin use_default_colors ncurses pinta el par 0 blanco sobre negro; se hace lo mismo
+static void default_pairs(TermScreen *s)
+{
+    for (int p = 0; p < TERM_PAIRS; p++)
+    {
+        s->pair_fg[p] = COLOR_WHITE;
+        s->pair_bg[p] = COLOR_BLACK;
+    }
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DE_LA_TERMINAL
+int term_open(int b)
+{
+    TermScreen *s = &process_screen;
+    s->backend = b;
+    if (s->backend == TERM_NCURSES)
+    {
+        initscr();            // Inicia el modo ncurses
+        noecho();             // Desactiva el eco de teclado
+        keypad(stdscr, TRUE); // Traduce las flechas a KEY_LEFT/KEY_RIGHT
+        curs_set(FALSE);      // Oculta el cursor
+        timeout(0);           // Configura getch para ser no bloqueante
+        start_color();        // iniciar color
+        return 0;
+    }
+
+    // Entrada cruda sin eco y read() no bloqueante; ISIG queda activo para que Ctrl-C funcione
+    if (!isatty(STDOUT_FILENO))
+    {
+        return -1;
+    }
+    if (tcgetattr(STDIN_FILENO, &saved_termios) == 0)
+    {
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_iflag &= ~(IXON | ICRNL);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        termios_saved = 1;
+    }
+    signal(SIGWINCH, on_resize);
+    signal(SIGINT, on_fatal);
+    signal(SIGTERM, on_fatal);
+    query_size(s);
+    default_pairs(s);
+
+    static const char enter[] = "\033[?1049h\033[?25l"; // Pantalla alternativa, sin cursor
+    write_all(s->out_fd, enter, sizeof(enter) - 1);
+    s->cur_y = s->cur_x = -1;
+    s->cur_fg = s->cur_bg = -1;
+    term_clear();
+    return 0;
+}
+
+void term_close()
+{
+    TermScreen *s = &process_screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        endwin(); // Finaliza el modo ncurses
+        return;
+    }
+    static const char leave[] = "\033[0m\033[?25h\033[?1049l";
+    term_flush();
+    write_all(s->out_fd, leave, sizeof(leave) - 1);
+    if (termios_saved)
+    {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+        termios_saved = 0;
+    }
+    signal(SIGWINCH, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    free(s->out);
+    s->out = NULL;
+    s->out_len = s->out_cap = 0;
+    free_buffers(s);
+}
+
+// La pantalla arranca como la del backend ANSI recien abierto: pantalla alternativa sin
+// cursor y borrada. Esas secuencias salen con el primer term_flush
+TermScreen *term_screen_create(int out_fd, int in_fd, int rows, int cols)
+{
+    TermScreen *s = calloc(1, sizeof(TermScreen));
+    if (s == NULL)
+    {
+        return NULL;
+    }
+    static const char enter[] = "\033[?1049h\033[?25l";
+    s->backend = TERM_ANSI;
+    s->out_fd = out_fd;
+    s->in_fd = in_fd;
+    s->rows = rows;
+    s->cols = cols;
+    s->fixed_size = 1;
+    s->cur_y = s->cur_x = -1;
+    s->cur_fg = s->cur_bg = -1;
+    default_pairs(s);
+    out_append(s, enter, sizeof(enter) - 1);
+
+    TermScreen *previous = term_select(s);
+    term_clear();
+    term_select(previous);
+    return s;
+}
+
+void term_screen_destroy(TermScreen *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    if (screen == s)
+    {
+        screen = &process_screen;
+    }
+    free(s->out);
+    free_buffers(s);
+    free(s);
+}
+
+TermScreen *term_select(TermScreen *s)
+{
+    TermScreen *previous = screen;
+    screen = s != NULL ? s : &process_screen;
+    return previous;
+}
+
+long term_dropped_frames(const TermScreen *s)
+{
+    return s->dropped;
+}
+
+void term_init_pair(int pair, int fg, int bg)
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        init_pair(pair, fg, bg);
+    }
+    else if (pair > 0 && pair < TERM_PAIRS)
+    {
+        s->pair_fg[pair] = fg;
+        s->pair_bg[pair] = bg;
+    }
+}
+
+int term_rows()
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        return LINES;
+    }
+    if (resized && !s->fixed_size)
+    {
+        resized = 0;
+        query_size(s);
+    }
+    return s->rows;
+}
+
+int term_cols()
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        return COLS;
+    }
+    if (resized && !s->fixed_size)
+    {
+        resized = 0;
+        query_size(s);
+    }
+    return s->cols;
+}
+
+// Los dos backends leen de stdin (las sesiones del anfitrion, de su pty): ncurses lo hace de a un byte, asi que despues de vaciar
+// term_getch hasta ERR no queda nada guardado fuera del descriptor
+int term_input_fd()
+{
+    return screen->in_fd;
+}
+
+// Decodifica las secuencias de las flechas (ESC [ x y ESC O x); cualquier otro byte es una tecla
+int term_getch()
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        return getch();
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        ssize_t n = read(s->in_fd, s->in_buf + s->in_len, sizeof(s->in_buf) - s->in_len);
+        if (n > 0)
+        {
+            s->in_len += n;
+        }
+        // Una secuencia cortada entre dos lecturas se completa con una lectura mas
+        if (s->in_len == 0 || s->in_buf[0] != 27 || s->in_len >= 3)
+        {
+            break;
+        }
+    }
+    if (s->in_len == 0)
+    {
+        return ERR;
+    }
+
+    int key = s->in_buf[0], used = 1;
+    if (key == 27 && s->in_len >= 3 && (s->in_buf[1] == '[' || s->in_buf[1] == 'O'))
+    {
+        switch (s->in_buf[2])
+        {
+        case 'A':
+            key = KEY_UP;
+            break;
+        case 'B':
+            key = KEY_DOWN;
+            break;
+        case 'C':
+            key = KEY_RIGHT;
+            break;
+        case 'D':
+            key = KEY_LEFT;
+            break;
+        }
+        used = key == 27 ? 1 : 3;
+    }
+    s->in_len -= used;
+    memmove(s->in_buf, s->in_buf + used, s->in_len);
+    return key;
+}
+
+void term_clear()
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        clear();
+        return;
+    }
+    ensure_buffers(s);
+    set_colors(s, s->pair_fg[0], s->pair_bg[0]);
+    out_append(s, "\033[2J", 4); // Borra con el fondo activo, igual que las celdas en blanco del buffer
+    for (int i = 0; i < s->buf_rows * s->buf_cols; i++)
+    {
+        s->next[i] = s->shown[i] = ' ';
+    }
+    for (int y = 0; y < s->buf_rows; y++)
+    {
+        s->dirty_lo[y] = s->buf_cols;
+        s->dirty_hi[y] = 0;
+    }
+}
+
+void term_put(int y, int x, const chtype *cells, int n)
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        mvaddchnstr(y, x, cells, n);
+        return;
+    }
+
+    ensure_buffers(s);
+    if (y < 0 || y >= s->buf_rows || x < 0 || x >= s->buf_cols)
+    {
+        return;
+    }
+    n = x + n > s->buf_cols ? s->buf_cols - x : n;
+    memcpy(s->next + y * s->buf_cols + x, cells, n * sizeof(chtype));
+    s->dirty_lo[y] = x < s->dirty_lo[y] ? x : s->dirty_lo[y];
+    s->dirty_hi[y] = x + n > s->dirty_hi[y] ? x + n : s->dirty_hi[y];
+}
+
+void term_print(int y, int x, chtype attr, const char *fmt, ...)
+{
+    char text[256];
+    chtype cells[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+
+    int n = 0;
+    for (; text[n] != '\0'; n++)
+    {
+        cells[n] = (unsigned char)text[n] | attr;
+    }
+    term_put(y, x, cells, n);
+}
+
+// Recorre las filas tocadas de arriba hacia abajo y emite solo las celdas distintas de lo
+// que hay en pantalla. Un hueco de hasta 3 celdas iguales que se ven igual con los colores
+// activos se reescribe, porque cuesta menos que la secuencia para saltarlo.
+// Si la escritura anterior no entro entera no se compone nada hasta que el descriptor
+// acepte datos otra vez; las filas tocadas mientras tanto siguen marcadas y el cuadro que
+// se envia despues redibuja la pantalla completa
+long term_flush()
+{
+    TermScreen *s = screen;
+    if (s->backend == TERM_NCURSES)
+    {
+        refresh();
+        return 0;
+    }
+    if (s->stalled)
+    {
+        struct pollfd p = {s->out_fd, POLLOUT, 0};
+        if (poll(&p, 1, 0) != 1 || !(p.revents & POLLOUT))
+        {
+            s->dropped++;
+            return 0;
+        }
+        s->stalled = 0;
+        forget_shown(s);
+    }
+
+    for (int y = 0; y < s->buf_rows; y++)
+    {
+        chtype *nrow = s->next + y * s->buf_cols, *srow = s->shown + y * s->buf_cols;
+        for (int x = s->dirty_lo[y]; x < s->dirty_hi[y]; x++)
+        {
+            if (nrow[x] == srow[x])
+            {
+                continue;
+            }
+            int gap = s->cur_y == y && s->cur_x >= 0 && s->cur_x < x && x - s->cur_x <= 3;
+            for (int g = s->cur_x; gap && g < x; g++)
+            {
+                gap = matches_colors(s, srow[g]);
+            }
+            if (gap)
+            {
+                for (int g = s->cur_x; g < x; g++)
+                {
+                    emit_cell(s, srow[g]);
+                }
+            }
+            else
+            {
+                move_to(s, y, x);
+            }
+            emit_cell(s, nrow[x]);
+            srow[x] = nrow[x];
+            // En la ultima columna el cursor queda pendiente de salto de linea: su posicion es incierta
+            s->cur_x = x + 1 < s->buf_cols ? x + 1 : -1;
+        }
+        s->dirty_lo[y] = s->buf_cols;
+        s->dirty_hi[y] = 0;
+    }
+
+    long sent = s->out_len;
+    // Un solo write() por cuadro salvo que la terminal acepte menos
+    if (write_all(s->out_fd, s->out, s->out_len) != 0)
+    {
+        s->stalled = 1;
+        s->dropped++;
+    }
+    s->out_len = 0;
+    return sent;
+}
+#pragma endregion
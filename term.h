@@ -0,0 +1,35 @@
+#ifndef TERM_H
+#define TERM_H
+
+#include <ncurses.h>
+
+#define TERM_NCURSES 0 // Salida y teclado a traves de ncurses
+#define TERM_ANSI 1    // Secuencias ANSI propias: un write() por cuadro y lectura cruda de stdin
+#define TERM_PAIRS 8   // Pares de colores que se pueden definir
+
+typedef struct TermScreen TermScreen; // Pantalla donde se dibuja: la terminal del proceso o la pty de una sesion
+
+// Terminal del juego. Todo lo que se dibuja o se lee del teclado pasa por aca, asi el
+// backend se elige al iniciar sin tocar el resto del codigo. Las celdas son chtype de
+// ncurses (caracter y par de colores) en los dos backends
+int term_open(int backend);                        // Pasa la terminal a modo juego, -1 si el backend no se puede usar
+void term_close();                                 // Restaura la terminal
+void term_init_pair(int pair, int fg, int bg);     // Define un par de colores (COLOR_* de ncurses)
+int term_rows();                                   // Filas de la terminal
+int term_cols();                                   // Columnas de la terminal
+int term_input_fd();                               // Descriptor del teclado, para esperar teclas con poll
+int term_getch();                                  // Proxima tecla (KEY_LEFT, KEY_RIGHT... como ncurses) o ERR si no hay
+void term_clear();                                 // Borra la pantalla
+void term_put(int y, int x, const chtype *cells, int n);        // Escribe n celdas a partir de (y, x)
+void term_print(int y, int x, chtype attr, const char *fmt, ...); // Escribe un texto con formato y atributos
+long term_flush();                                 // Envia lo escrito a la pantalla, devuelve los bytes enviados (0 en ncurses)
+
+// Pantallas adicionales con el backend ANSI y tamaño fijo, p. ej. una por sesion del modo
+// anfitrion. Cada hilo dibuja en la pantalla que eligio con term_select; por defecto es la
+// terminal del proceso. Si out_fd es no bloqueante y se llena, los cuadros se descartan
+TermScreen *term_screen_create(int out_fd, int in_fd, int rows, int cols); // Crea una pantalla sobre los descriptores, NULL si falla
+void term_screen_destroy(TermScreen *s);           // Libera la pantalla (no cierra los descriptores)
+TermScreen *term_select(TermScreen *s);            // El hilo que llama usa s (NULL la del proceso), devuelve la anterior
+long term_dropped_frames(const TermScreen *s);     // Cuadros descartados porque el descriptor no aceptaba mas datos
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stddef.h>
+
+#define VARINT_MAX 10 // Bytes de un varint de 64 bits como maximo
+
+// Codificacion compartida por las grabaciones y la transmision a espectadores. Enteros sin
+// signo en base 128: 7 bits por byte, el bit alto indica que sigue otro byte. Van en el
+// encabezado para que se inlineen en los bucles del codificador de espectadores
+
+// Escribe v en out (al menos VARINT_MAX bytes libres) y devuelve los bytes usados
+static inline size_t varint_put(unsigned char *out, unsigned long v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (unsigned char)(v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+// Lee un varint de [*p, end) y avanza *p. -1 si se corta o tiene mas de 64 bits
+static inline int varint_get(const unsigned char **p, const unsigned char *end, unsigned long *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7)
+    {
+        int c = *(*p)++;
+        *v |= (unsigned long)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Los enteros con signo se intercalan (0, -1, 1, -2...) para que los negativos chicos ocupen un byte
+static inline unsigned long zigzag(int v)
+{
+    return ((unsigned int)v << 1) ^ (unsigned int)(v < 0 ? -1 : 0);
+}
+
+static inline int unzigzag(unsigned long v)
+{
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+#endif
@@ -0,0 +1,282 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rng.h"
+#include "workpool.h"
+
+#define STEAL_OK 0    // Se robo un trabajo
+#define STEAL_EMPTY 1 // La cola estaba vacia
+#define STEAL_ABORT 2 // Otro hilo gano la carrera por el mismo trabajo
+
+// Argumento de cada hilo
+typedef struct
+{
+    WorkPool *pool;
+    int id;
+} Worker;
+
+// Los hilos viven lo mismo que el pool y duermen entre lotes. Cada lote incrementa
+// generation; un hilo que ve una generacion nueva procesa trabajos hasta que no queda
+// ninguno y el ultimo en terminar despierta a quien lanzo el lote
+struct WorkPool
+{
+    int workers;
+    WorkDeque *deques; // Una cola por hilo
+    WorkFn fn;
+    void *ctx;
+    WorkerStats *stats;
+    pthread_t *threads;
+    Worker *args;
+    pthread_mutex_t lock;
+    pthread_cond_t start; // Hay un lote nuevo o hay que terminar
+    pthread_cond_t done;  // Todos los hilos terminaron el lote
+    long generation;      // Lotes lanzados
+    int busy;             // Hilos que siguen trabajando en el lote actual
+    int stopping;         // 1 cuando los hilos tienen que terminar
+};
+
+#pragma region FUNCIONES_AUXILIARES
+// Saca el ultimo trabajo de la cola propia. Solo compite con los ladrones por el ultimo
+// trabajo que queda, y esa carrera se decide con un CAS sobre top
+static int deque_take(WorkDeque *d, long *job)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b)
+    {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    *job = b;
+    if (t == b)
+    {
+        int won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                          memory_order_relaxed);
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
+}
+
+static int deque_steal(WorkDeque *d, long *job)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b)
+    {
+        return STEAL_EMPTY;
+    }
+    *job = t;
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return STEAL_ABORT;
+    }
+    return STEAL_OK;
+}
+
+// Recorre las demas colas desde una victima al azar. Si alguna carrera se perdio puede
+// quedar trabajo, asi que se vuelve a intentar; si todas estaban vacias no queda nada,
+// porque los trabajos se reparten todos antes de arrancar
+static int steal_any(WorkPool *p, int me, Rng *rng, long *job)
+{
+    int contended;
+    do
+    {
+        contended = 0;
+        int start = rng_below(rng, p->workers);
+        for (int k = 0; k < p->workers; k++)
+        {
+            int victim = (start + k) % p->workers;
+            if (victim == me)
+            {
+                continue;
+            }
+            int r = deque_steal(&p->deques[victim], job);
+            if (r == STEAL_OK)
+            {
+                return 1;
+            }
+            contended |= r == STEAL_ABORT;
+        }
+    } while (contended);
+    return 0;
+}
+
+// Procesa trabajos de la cola propia y despues roba de las ajenas hasta que no queda ninguno
+static void run_jobs(WorkPool *p, int me, Rng *rng)
+{
+    WorkerStats *stats = &p->stats[me];
+    long job;
+    for (;;)
+    {
+        if (deque_take(&p->deques[me], &job))
+        {
+            p->fn(p->ctx, me, job);
+            stats->executed++;
+        }
+        else if (steal_any(p, me, rng, &job))
+        {
+            p->fn(p->ctx, me, job);
+            stats->executed++;
+            stats->stolen++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    WorkPool *p = w->pool;
+    long seen = 0;
+    Rng rng;
+
+    rng_seed(&rng, w->id, 0);
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        while (p->generation == seen && !p->stopping)
+        {
+            pthread_cond_wait(&p->start, &p->lock);
+        }
+        if (p->generation == seen)
+        {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        run_jobs(p, w->id, &rng);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0)
+        {
+            pthread_cond_signal(&p->done);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+#pragma endregion
+
+#pragma region FUNCIONES_DEL_POOL
+int work_pool_default_workers()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+WorkPool *work_pool_create(int workers, WorkerStats *stats)
+{
+    WorkPool *p = calloc(1, sizeof(WorkPool));
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    p->stats = stats;
+    p->threads = malloc(workers * sizeof(pthread_t));
+    p->args = malloc(workers * sizeof(Worker));
+    p->deques = aligned_alloc(64, workers * sizeof(WorkDeque));
+    if (p->threads == NULL || p->args == NULL || p->deques == NULL)
+    {
+        free(p->threads);
+        free(p->args);
+        free(p->deques);
+        free(p);
+        return NULL;
+    }
+
+    memset(stats, 0, workers * sizeof(WorkerStats));
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for (int i = 0; i < workers; i++)
+    {
+        p->args[i].pool = p;
+        p->args[i].id = i;
+    }
+    // Si falta algun hilo el pool sigue con los que arrancaron
+    for (; p->workers < workers; p->workers++)
+    {
+        if (pthread_create(&p->threads[p->workers], NULL, worker_main, &p->args[p->workers]) != 0)
+        {
+            break;
+        }
+    }
+    if (p->workers == 0)
+    {
+        work_pool_destroy(p);
+        return NULL;
+    }
+    return p;
+}
+
+// Cada hilo empieza con un bloque contiguo de trabajos y, cuando termina el suyo, roba
+// del principio de los bloques ajenos. Vuelve cuando se procesaron todos
+void work_pool_batch(WorkPool *p, long jobs, WorkFn fn, void *ctx)
+{
+    pthread_mutex_lock(&p->lock);
+    for (int i = 0; i < p->workers; i++)
+    {
+        atomic_store_explicit(&p->deques[i].top, jobs * i / p->workers, memory_order_relaxed);
+        atomic_store_explicit(&p->deques[i].bottom, jobs * (i + 1) / p->workers, memory_order_relaxed);
+    }
+    p->fn = fn;
+    p->ctx = ctx;
+    p->busy = p->workers;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    while (p->busy > 0)
+    {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+int work_pool_workers(const WorkPool *p)
+{
+    return p->workers;
+}
+
+void work_pool_destroy(WorkPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stopping = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->workers; i++)
+    {
+        pthread_join(p->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free(p->threads);
+    free(p->args);
+    free(p->deques);
+    free(p);
+}
+
+// Un pool para un solo lote
+int work_pool_run(int workers, long jobs, WorkFn fn, void *ctx, WorkerStats *stats)
+{
+    WorkPool *p = work_pool_create(workers, stats);
+    if (p == NULL)
+    {
+        return -1;
+    }
+    work_pool_batch(p, jobs, fn, ctx);
+    work_pool_destroy(p);
+    return 0;
+}
+#pragma endregion
@@ -0,0 +1,36 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdatomic.h>
+
+typedef void (*WorkFn)(void *ctx, int worker, long job); // Procesa el trabajo job en el hilo worker
+
+// Cola de trabajos de un hilo (deque de Chase-Lev). Los trabajos son enteros consecutivos,
+// asi que la cola solo guarda posiciones: el dueño saca del final (bottom) y los demas
+// hilos roban del principio (top). Cada extremo vive en su propia linea de cache
+typedef struct
+{
+    _Alignas(64) atomic_long top;    // Proximo trabajo que se puede robar
+    _Alignas(64) atomic_long bottom; // Uno mas que el proximo trabajo del dueño
+} WorkDeque;
+
+// Trabajo hecho por un hilo
+typedef struct
+{
+    _Alignas(64) long executed; // Trabajos procesados
+    long stolen;                // De esos, cuantos se robaron a otro hilo
+} WorkerStats;
+
+typedef struct WorkPool WorkPool; // Hilos que procesan lotes de trabajos
+
+int work_pool_default_workers();                                                  // Hilos del pool: uno por CPU en linea
+int work_pool_run(int workers, long jobs, WorkFn fn, void *ctx, WorkerStats *stats); // Procesa los trabajos [0, jobs) con robo de trabajo, -1 si falla
+
+// Pool que se reutiliza: los hilos se crean una vez y duermen entre lotes, para quien
+// lanza un lote por tick (el modo anfitrion). stats acumula todos los lotes
+WorkPool *work_pool_create(int workers, WorkerStats *stats);     // Arranca los hilos, NULL si no arranco ninguno
+void work_pool_batch(WorkPool *p, long jobs, WorkFn fn, void *ctx); // Procesa los trabajos [0, jobs) y vuelve cuando terminaron todos
+int work_pool_workers(const WorkPool *p);                        // Hilos que arrancaron
+void work_pool_destroy(WorkPool *p);                             // Detiene y libera los hilos
+
+#endif